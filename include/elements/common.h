@@ -48,6 +48,10 @@ typedef struct
 
 static filter_option_overrides filter_options[] = {
   GPAC_TF_FILTER_OPTIONS("mp4mx", GPAC_PROP_SEGDUR),
+  GPAC_TF_FILTER_OPTIONS("dasher",
+                         GPAC_PROP_SEGMENT_STORE,
+                         GPAC_PROP_DVR_WINDOW,
+                         GPAC_PROP_STORE_MAX_SIZE),
 };
 
 /**
@@ -31,6 +31,7 @@
 #include "lib/caps.h"
 #include "lib/properties.h"
 #include "lib/signals.h"
+#include "lib/store.h"
 
 #include <gst/gst.h>
 
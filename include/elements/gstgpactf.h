@@ -38,6 +38,7 @@
 #include "lib/signals.h"
 
 #include <gst/base/gstaggregator.h>
+#include <gst/base/gstflowcombiner.h>
 #include <gst/gst.h>
 #include <gst/video/video-event.h>
 
@@ -60,17 +61,47 @@ struct _GstGpacTransform
   guint64 global_idr_period;
   guint64 gpac_idr_period;
 
+  /* Segment store, attached as object data so lookups can reach it */
+  gboolean segment_store;
+  guint64 dvr_window;
+  guint64 store_max_size;
+
+  /* Key of the pooled sessions prepared for the next start, if any */
+  gchar* pool_key;
+
   /* General Pad Information */
   guint32 video_pad_count;
   guint32 audio_pad_count;
   guint32 subtitle_pad_count;
   guint32 caption_pad_count;
 
-  /* Input Queue */
-  GQueue* queue;
+  /* Snapshot of the sink pads, rebuilt when pads are added or removed */
+  GPtrArray* pads;
+  gint pads_changed;
+  // Set when a pad was added or its caps, tags or segment changed
+  gint pids_changed;
+
+  /* Latency reported to the aggregator, recomputed when the graph changes */
+  GstClockTime latency;
+  guint latency_filters;
+  gint latency_changed;
+
+  /* Set while the queue limits are too low for the graph to make progress */
+  gboolean queue_overrun;
+  // Pad the next aggregate starts from, so that throttling starves none
+  guint next_pad;
 
   /* Sacrificial Buffer (for syncing) */
   GstBuffer* sync_buffer;
+
+  /* Source pads of the outputs beyond the first one */
+  gboolean srcpad_claimed;
+  guint32 src_pad_count;
+  GList* src_pads;
+  GstFlowCombiner* flow_combiner;
+  gboolean no_more_pads;
+  // Serialized events of the sink pads, pushed from the streaming thread
+  GQueue src_pad_events;
 };
 
 /**
@@ -95,9 +126,6 @@ G_DECLARE_FINAL_TYPE(GstGpacTransformPad,
 struct _GstGpacTransformPad
 {
   GstAggregatorPad parent;
-
-  /* GPAC PID */
-  GF_FilterPid* pid;
 };
 
 GST_ELEMENT_REGISTER_DECLARE(gpac_tf);
@@ -27,6 +27,7 @@
 
 #include <gpac/filters.h>
 #include <gst/gst.h>
+#include <gst/video/video.h>
 
 /* static info related to various format */
 
@@ -55,6 +56,15 @@
   "alignment = (string) au, " \
   COMMON_VIDEO_CAPS
 
+// Keep in sync with the format tables in caps.c
+#define RAW_VIDEO_CAPS \
+  "video/x-raw, " \
+  "format = (string) { I420, YV12, NV12, NV21, Y42B, Y444, I420_10LE, " \
+  "I422_10LE, Y444_10LE, YUY2, UYVY, YVYU, GRAY8, RGB, BGR, RGBA, BGRA, " \
+  "ARGB, ABGR, RGBx, BGRx, xRGB, xBGR }, " \
+  "framerate = (fraction) [ 0/1, MAX ], " \
+  COMMON_VIDEO_CAPS
+
 #define COMMON_AUDIO_CAPS(c, r) \
   "channels = (int) [ 1, " G_STRINGIFY (c) " ], " \
   "rate = (int) [ 1, " G_STRINGIFY (r) " ]"
@@ -71,6 +81,12 @@
   "channels = (int) [ 1, 6 ], " \
   "rate = (int) [ 8000, 48000 ]"
 
+#define RAW_AUDIO_CAPS \
+  "audio/x-raw, " \
+  "format = (string) { U8, S16LE, S16BE, S24LE, S32LE, F32LE, F64LE }, " \
+  "layout = (string) interleaved, " \
+  COMMON_AUDIO_CAPS (8, MAX)
+
 #define TEXT_UTF8 \
   "text/x-raw, " \
   "format=(string)utf8"
@@ -124,6 +140,13 @@ gpac_install_sink_pad_templates(GstElementClass* klass);
 void
 gpac_install_src_pad_templates(GstElementClass* klass);
 
+/*! Install the template of the source pads created for the additional
+   outputs of the session
+    \param[in] klass the element class to install the pad template
+*/
+void
+gpac_install_src_sometimes_pad_template(GstElementClass* klass);
+
 /*! Convert a GstCaps to a GF_FilterCapability array
     \param[in] caps the GstCaps to convert
     \param[out] nb_caps the number of capabilities in the returned array
@@ -131,3 +154,25 @@ gpac_install_src_pad_templates(GstElementClass* klass);
 */
 GF_FilterCapability*
 gpac_gstcaps_to_gfcaps(GstCaps* caps, guint* nb_caps);
+
+/*! Get the gpac pixel format of a raw video format
+    \param[in] format the GstVideoFormat
+    \return the GF_PixelFormat, or 0 if the format is not supported
+*/
+u32
+gpac_caps_get_pixel_format(GstVideoFormat format);
+
+/*! Get the gpac audio format of a raw audio format
+    \param[in] format the raw audio format name, e.g. "S16LE"
+    \return the GF_AudioFormat, or 0 if the format is not supported
+*/
+u32
+gpac_caps_get_audio_format(const gchar* format);
+
+/*! Describe the stream of a PID as caps, for the pads created from the
+   output of the session
+    \param[in] pid the PID
+    \return the caps, never NULL
+*/
+GstCaps*
+gpac_caps_from_pid(GF_FilterPid* pid);
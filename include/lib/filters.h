@@ -0,0 +1,71 @@
+/*
+ *			GPAC - Multimedia Framework C SDK
+ *
+ *			Authors: Deniz Ugur, Romain Bouqueau, Sohaib Larbi
+ *			Copyright (c) Motion Spell
+ *				All rights reserved
+ *
+ *  This file is part of the GPAC/GStreamer wrapper
+ *
+ *  This GPAC/GStreamer wrapper is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Affero General Public License
+ *  as published by the Free Software Foundation; either version 3, or (at
+ *  your option) any later version.
+ *
+ *  This GPAC/GStreamer wrapper is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public
+ *  License along with this library; see the file LICENSE.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+#pragma once
+
+#include <gpac/filters.h>
+#include <gst/gst.h>
+
+// Set to 0 to disable the on-disk cache, or to a directory to move it
+#define GPAC_FILTERS_CACHE_ENV "GST_GPAC_FILTERS_CACHE"
+
+/*
+ * Description of the gpac filter registers, collected once per process.
+ *
+ * Listing the filters requires a filter session, which is costly to create.
+ * The first lookup indexes every filter register and its arguments, later
+ * lookups are table lookups. The index is also saved to the user cache
+ * directory, keyed by the gpac and plugin versions, so that the next process
+ * can skip the session entirely.
+ */
+typedef struct
+{
+  const gchar* name;
+  const gchar* desc;
+  const gchar* default_val;
+  const gchar* min_max_enum;
+  guint32 type; // GF_PropType
+  guint32 flags;
+} GPAC_FilterArg;
+
+typedef struct
+{
+  const gchar* name;
+  GPAC_FilterArg* args;
+  guint n_args;
+} GPAC_FilterInfo;
+
+/*! looks up a filter register
+    \param[in] filter_name the name of the filter
+    \return the description of the filter, or NULL if there is no such filter.
+   Valid for the lifetime of the process
+*/
+const GPAC_FilterInfo*
+gpac_filters_lookup(const gchar* filter_name);
+
+/*! gets the list separator used when parsing argument values
+    \return the list separator
+*/
+gchar
+gpac_filters_get_list_sep(void);
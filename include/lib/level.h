@@ -0,0 +1,141 @@
+/*
+ *			GPAC - Multimedia Framework C SDK
+ *
+ *			Authors: Deniz Ugur, Romain Bouqueau, Sohaib Larbi
+ *			Copyright (c) Motion Spell
+ *				All rights reserved
+ *
+ *  This file is part of the GPAC/GStreamer wrapper
+ *
+ *  This GPAC/GStreamer wrapper is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Affero General Public License
+ *  as published by the Free Software Foundation; either version 3, or (at
+ *  your option) any later version.
+ *
+ *  This GPAC/GStreamer wrapper is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public
+ *  License along with this library; see the file LICENSE.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#pragma once
+
+#include <gst/gst.h>
+
+/*
+ * How much input the filter session holds on to.
+ *
+ * Bytes and buffers count the input buffers that gpac references instead of
+ * copying. They are released from the packet destructors, which may run on
+ * the gpac worker threads. The time level is the running time between the
+ * newest input handed to the session and the newest output that came out of
+ * it. Both are only touched under the lock, the level is read from any thread
+ * through the queue-level property.
+ */
+typedef struct
+{
+  guint64 bytes;
+  guint buffers;
+  GstClockTime in_time;
+  GstClockTime out_time;
+
+  // 0 for unlimited
+  guint64 max_bytes;
+  GstClockTime max_time;
+
+  /*< private >*/
+  GMutex lock;
+  GCond cond;
+} GPAC_QueueLevel;
+
+/*! initializes a queue level
+    \param[in] level the queue level to initialize
+*/
+void
+gpac_queue_level_init(GPAC_QueueLevel* level);
+
+/*! releases the resources of a queue level
+    \param[in] level the queue level to clear
+*/
+void
+gpac_queue_level_clear(GPAC_QueueLevel* level);
+
+/*! forgets the held input and the input and output times, for a new
+   session
+    \param[in] level the queue level
+*/
+void
+gpac_queue_level_reset(GPAC_QueueLevel* level);
+
+/*! accounts for an input buffer that the session now references
+    \param[in] level the queue level
+    \param[in] size the size of the buffer in bytes
+*/
+void
+gpac_queue_level_hold(GPAC_QueueLevel* level, gsize size);
+
+/*! accounts for an input buffer that the session let go of. Can be called
+   from any thread
+    \param[in] level the queue level
+    \param[in] size the size of the buffer in bytes
+*/
+void
+gpac_queue_level_release(GPAC_QueueLevel* level, gsize size);
+
+/*! records the running time of an input handed to the session
+    \param[in] level the queue level
+    \param[in] running_time the running time of the input
+*/
+void
+gpac_queue_level_update_input(GPAC_QueueLevel* level,
+                              GstClockTime running_time);
+
+/*! records the running time of an output of the session
+    \param[in] level the queue level
+    \param[in] running_time the running time of the output
+*/
+void
+gpac_queue_level_update_output(GPAC_QueueLevel* level,
+                               GstClockTime running_time);
+
+/*! gets the number of bytes of input buffers the session references
+    \param[in] level the queue level
+    \return the byte level
+*/
+guint64
+gpac_queue_level_get_bytes(GPAC_QueueLevel* level);
+
+/*! gets the running time of the input that has not come out yet
+    \param[in] level the queue level
+    \return the time level
+*/
+GstClockTime
+gpac_queue_level_get_time(GPAC_QueueLevel* level);
+
+/*! checks whether any of the limits is reached
+    \param[in] level the queue level
+    \return TRUE if no more input should be handed to the session
+*/
+gboolean
+gpac_queue_level_is_full(GPAC_QueueLevel* level);
+
+/*! waits for the session to release input, until the level is below its
+   limits or the timeout expires
+    \param[in] level the queue level
+    \param[in] timeout the maximum time to wait, in microseconds
+    \return TRUE if the level is below its limits
+*/
+gboolean
+gpac_queue_level_wait(GPAC_QueueLevel* level, gint64 timeout);
+
+/*! describes the current level
+    \param[in] level the queue level
+    \return a new "queue-level" structure with the bytes, buffers and time
+*/
+GstStructure*
+gpac_queue_level_to_structure(GPAC_QueueLevel* level);
@@ -42,6 +42,14 @@ typedef struct
 gboolean
 gpac_init(GPAC_Context* ctx, GstElement* element);
 
+/*! synchronizes the gpac log tool levels with the gstreamer thresholds of the
+    "gpac" and "gpac:<tool>" debug categories. Messages below the threshold are
+    then dropped by gpac itself and never reach the log callback.
+    \param[in] force apply the levels even if the thresholds did not change
+*/
+void
+gpac_log_sync_levels(gboolean force);
+
 /*! destroys a gpac context
     \param[in] ctx the gpac context to destroy
 */
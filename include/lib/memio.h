@@ -27,7 +27,14 @@
 
 #include <gpac/filters.h>
 
+#include "lib/packet.h"
+#include "lib/pckmem.h"
+#include "lib/ring.h"
 #include "lib/session.h"
+#include "lib/writer.h"
+
+// Number of packets the memory input can hold before it must be drained
+#define GPAC_MEMIO_RING_CAPACITY 1024
 
 typedef enum
 {
@@ -37,15 +44,24 @@ typedef enum
 
 typedef struct
 {
-  // queue should be freed by the caller
-  GQueue* queue;
+  /*< memin-specific >*/
+  // filled by the element, drained by the memin process callback
+  GPAC_Ring* ring;
   gboolean eos;
+  // buffers behind the shared packets, found again by their destructor
+  GPAC_PckRefs* refs;
   GPAC_MemIoDirection dir;
   GPAC_SessionContext* sess;
 
   /*< memout-specific >*/
   guint64 global_offset;
   gboolean is_continuous;
+  // shared by the post-processors that write files, created on first use
+  GPAC_WriterPool* writers;
+  // recycles the buffers of the post-processors, created on first use
+  GPAC_PckMemPool* pckmem;
+  // consumable PID to poll first, so that no output starves the others
+  guint next_pid;
 } GPAC_MemIoContext;
 
 typedef enum
@@ -106,15 +122,28 @@ gpac_memio_new(GPAC_SessionContext* sess, GPAC_MemIoDirection dir);
 void
 gpac_memio_free(GPAC_SessionContext* sess);
 
-/*! assigns a queue to the memory io filter
+/*! pushes a packet to the memory input filter
     \param[in] sess the session context
-    \param[in] dir the direction of the memory io filter
-    \param[in] queue the queue to assign
+    \param[in] packet the packet to push
+    \return TRUE if the packet was queued, FALSE if the queue is full and the
+   session must be run before retrying
 */
-void
-gpac_memio_assign_queue(GPAC_SessionContext* sess,
-                        GPAC_MemIoDirection dir,
-                        GQueue* queue);
+gboolean
+gpac_memio_push(GPAC_SessionContext* sess, GF_FilterPacket* packet);
+
+/*! gets the number of packets waiting to be sent by the memory input filter
+    \param[in] sess the session context
+    \return the number of pending packets
+*/
+guint
+gpac_memio_get_pending(GPAC_SessionContext* sess);
+
+/*! gets the number of packets the memory input filter can hold
+    \param[in] sess the session context
+    \return the capacity of the memory input queue
+*/
+guint
+gpac_memio_get_capacity(GPAC_SessionContext* sess);
 
 /*! sets the end of stream flag of the memory input filter
     \param[in] sess the session context
@@ -131,13 +160,46 @@ gpac_memio_set_eos(GPAC_SessionContext* sess, gboolean eos);
 gboolean
 gpac_memio_set_gst_caps(GPAC_SessionContext* sess, GstCaps* caps);
 
-/*! consumes the output of the memory output filter
+/*! consumes the output of the memory output filter. Every consumable PID is
+   polled in turn and the output of the first one that has some is returned
     \param[in] sess the session context
     \param[out] outptr the output pointer
+    \param[out] out_pid the PID the output comes from, may be NULL
     \return the result of the operation
 */
 GPAC_FilterPPRet
-gpac_memio_consume(GPAC_SessionContext* sess, void** outptr);
+gpac_memio_consume(GPAC_SessionContext* sess,
+                   void** outptr,
+                   GF_FilterPid** out_pid);
+
+/*! gets the source pad that the output of a memory output PID is pushed on
+    \param[in] pid the input PID of the memory output filter
+    \return the pad, NULL if none was assigned yet
+*/
+GstPad*
+gpac_memio_get_src_pad(GF_FilterPid* pid);
+
+/*! assigns a source pad to a memory output PID
+    \param[in] pid the input PID of the memory output filter
+    \param[in] pad the pad, a reference is taken
+*/
+void
+gpac_memio_set_src_pad(GF_FilterPid* pid, GstPad* pad);
+
+/*! gets the pool that the post-processors of the memory output filter
+   allocate their buffers from, creating it on first use
+    \param[in] memout the memory output filter
+    \return the pool
+*/
+GPAC_PckMemPool*
+gpac_memio_get_pckmem(GF_Filter* memout);
+
+/*! gets the records of the buffers shared by the memory input filter
+    \param[in] memin the memory input filter
+    \return the records, NULL once the filter is freed
+*/
+GPAC_PckRefs*
+gpac_memio_get_pck_refs(GF_Filter* memin);
 
 /*! sets the global offset of the memory output filter
     \param[in] sess the session context
@@ -36,6 +36,27 @@
 #define GPAC_PCK_PROP_IMPL_ARGS                         \
   GstBuffer *buffer, GPAC_PCK_PROP_IMPL_ARGS_NO_ELEMENT
 
+/*! creates a new record store
+    \return the new store
+*/
+GPAC_PckRefs*
+gpac_pck_refs_new(void);
+
+/*! frees a record store, releasing the buffers of the packets still alive
+    \param[in] refs the store
+*/
+void
+gpac_pck_refs_free(GPAC_PckRefs* refs);
+
+/*! resolves the timing parameters and the packet builder of a pid, so that
+    packet creation doesn't have to query the pid for every buffer
+    \param[in] element the element that the pad belongs to
+    \param[in] priv the private data of the pad
+    \param[in] pid the pid to resolve the parameters from
+*/
+void
+gpac_pck_cache_pid_params(GPAC_PID_PROP_IMPL_ARGS);
+
 /*! creates a new packet from the given buffer
     \param[in] buffer the buffer to create the packet from
     \param[in] priv the private data of the pad
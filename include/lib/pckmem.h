@@ -0,0 +1,144 @@
+/*
+ *			GPAC - Multimedia Framework C SDK
+ *
+ *			Authors: Deniz Ugur, Romain Bouqueau, Sohaib Larbi
+ *			Copyright (c) Motion Spell
+ *				All rights reserved
+ *
+ *  This file is part of the GPAC/GStreamer wrapper
+ *
+ *  This GPAC/GStreamer wrapper is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Affero General Public License
+ *  as published by the Free Software Foundation; either version 3, or (at
+ *  your option) any later version.
+ *
+ *  This GPAC/GStreamer wrapper is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public
+ *  License along with this library; see the file LICENSE.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#pragma once
+
+#include <gpac/filters.h>
+#include <gst/gst.h>
+
+// Memory type of the memories that wrap gpac packets
+#define GPAC_PCKMEM_TYPE "GpacPacket"
+// Released packet memories kept for reuse, per pool
+#define GPAC_PCKMEM_FREE_MAX 256
+
+/*
+ * Recycles the buffers handed downstream by the memory output filter.
+ *
+ * Packet data is wrapped in memories of a dedicated allocator that hold a
+ * reference on the packet. Released memories and buffer shells go back to the
+ * pool instead of being freed, so the output does not allocate per packet once
+ * the pool is warm. Slices of a packet share its memory.
+ */
+typedef struct _GPAC_PckMemPool GPAC_PckMemPool;
+
+/*
+ * The output PID that a packet memory comes from. A downstream gpac element
+ * copies its properties, the generation tells when they changed. The record
+ * outlives the PID, it is detached before the PID goes away.
+ */
+typedef struct _GPAC_PckSource GPAC_PckSource;
+
+/*! creates a new source record for a PID
+    \param[in] pid the input PID of the memory output filter
+    \return the new record
+*/
+GPAC_PckSource*
+gpac_pck_source_new(GF_FilterPid* pid);
+
+/*! takes a reference on a source record
+    \param[in] source the record
+    \return the record
+*/
+GPAC_PckSource*
+gpac_pck_source_ref(GPAC_PckSource* source);
+
+/*! releases a reference on a source record
+    \param[in] source the record
+*/
+void
+gpac_pck_source_unref(GPAC_PckSource* source);
+
+/*! marks the properties of the PID as changed
+    \param[in] source the record
+*/
+void
+gpac_pck_source_update(GPAC_PckSource* source);
+
+/*! detaches the record from its PID, before the PID is destroyed
+    \param[in] source the record
+*/
+void
+gpac_pck_source_detach(GPAC_PckSource* source);
+
+/*! gets the generation of the properties of the PID
+    \param[in] source the record
+    \return the generation, incremented on every update
+*/
+guint
+gpac_pck_source_get_generation(GPAC_PckSource* source);
+
+/*! copies the properties of the PID to another PID, replacing its properties
+    \param[in] source the record
+    \param[in] dst the PID to copy the properties to
+    \return TRUE if the properties were copied, FALSE if the record is detached
+*/
+gboolean
+gpac_pck_source_copy_properties(GPAC_PckSource* source, GF_FilterPid* dst);
+
+/*! creates a new pool of packet memories and buffer shells
+    \return the new pool
+*/
+GPAC_PckMemPool*
+gpac_pckmem_pool_new(void);
+
+/*! frees a pool. Memories and buffers that are still in use are freed when
+   they are released
+    \param[in] pool the pool to free
+*/
+void
+gpac_pckmem_pool_free(GPAC_PckMemPool* pool);
+
+/*! wraps a region of the data of a packet in a memory, the memory holds a
+   reference on the packet and on its source. Memories shared from it keep it
+   as their parent, so adjacent shares of one root are spans
+    \param[in] pool the pool
+    \param[in] source the source of the packet, may be NULL
+    \param[in] pck the packet to wrap
+    \param[in] offset the offset of the region in the packet data
+    \param[in] size the size of the region
+    \return the new memory
+*/
+GstMemory*
+gpac_pckmem_pool_wrap(GPAC_PckMemPool* pool,
+                      GPAC_PckSource* source,
+                      GF_FilterPacket* pck,
+                      gsize offset,
+                      gsize size);
+
+/*! gets an empty buffer shell from the pool
+    \param[in] pool the pool
+    \return a writable buffer without memory
+*/
+GstBuffer*
+gpac_pckmem_pool_new_buffer(GPAC_PckMemPool* pool);
+
+/*! gets the packet that a memory wraps. The memory spans mem->size bytes at
+   mem->offset in the packet data
+    \param[in] mem the memory
+    \param[out] source the source of the packet, may be NULL
+    \return the packet, NULL if the memory does not wrap a gpac packet
+*/
+GF_FilterPacket*
+gpac_pckmem_get_packet(GstMemory* mem, GPAC_PckSource** source);
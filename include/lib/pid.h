@@ -28,6 +28,8 @@
 #include <gpac/filters.h>
 #include <gst/gst.h>
 
+#include "lib/caps.h"
+#include "lib/pckmem.h"
 #include "lib/session.h"
 #include "lib/time.h"
 
@@ -38,42 +40,152 @@ typedef enum
 {
   GPAC_PAD_CAPS_SET = 1 << 0,
   GPAC_PAD_TAGS_SET = 1 << 1,
-  GPAC_PAD_SEGMENT_SET = 1 << 2
+  GPAC_PAD_SEGMENT_SET = 1 << 2,
+  GPAC_PAD_SOURCE_SET = 1 << 3
 } GpacPadFlags;
 
+typedef struct _GpacPadPrivate GpacPadPrivate;
+
+/*
+ * Records of the buffers behind the shared packets of the memory input filter.
+ *
+ * Shared packets have no user data, so the destructor finds the record of a
+ * packet in the store of the filter that created it. Released records are
+ * kept on a free list, so the steady state allocates nothing per packet.
+ */
+typedef struct _GPAC_PckRefs GPAC_PckRefs;
+
 /**
- * GpacPadPrivate: Holds the latest information about the pad.
+ * GpacCapsOverride: A PID property set from a "gpac-" prefixed caps field or
+ * from a field of the nested "gpac" structure.
+ */
+typedef struct
+{
+  u32 prop_4cc;
+  const gchar* name;
+  const gchar* value;
+} GpacCapsOverride;
+
+/**
+ * GpacCapsInfo: The pad caps as read by the PID property handlers, parsed once
+ * per caps change. Strings and buffers point into the caps held by the pad.
  */
 typedef struct
+{
+  GStrv media_type; // { media, codec } split from the structure name
+  const gchar* media;
+  const gchar* codec; // NULL if the media type has no subtype
+  u32 stream_type;
+  const gchar* stream_format;
+
+  // Missing fields are left at -1
+  gint width;
+  gint height;
+  gint rate;
+  gint channels;
+  gint fps_num;
+  gint fps_den;
+  gboolean framed; // TRUE unless the caps say otherwise
+  GstBuffer* codec_data;
+
+  // Raw streams only
+  gboolean is_raw;
+  GstVideoInfo video_info; // Default plane layout of raw video
+  const gchar* audio_format;
+
+  // Overrides, and the registry entries they replace
+  GArray* overrides;
+  guint64 overridden;
+} GpacCapsInfo;
+
+/**
+ * GpacPckBuilder: Stream type specific step of the packet creation, picked
+ * once per PID reconfigure.
+ */
+typedef void (*GpacPckBuilder)(GstBuffer* buffer,
+                               GpacPadPrivate* priv,
+                               GF_FilterPacket* packet);
+
+/**
+ * GpacPadPrivate: Holds the latest information about the pad.
+ */
+struct _GpacPadPrivate
 {
   GstPad* self;
+  GstElement* element; // Parent element, not owned
   guint id; // Monotonic ID of the pad, used for ID property in gpac
+  GF_FilterPid* pid; // NULL until the pid is created in the session
+  GstGpacSinkTemplateType kind; // Template the pad was requested from
 
   // Information from the pad
   gboolean eos;
   GstCaps* caps;
+  GpacCapsInfo caps_info; // Parsed from caps
   GstTagList* tags;
   GstSegment* segment;
+  GPAC_PckSource* source; // PID of an upstream gpac element, if any
+  guint source_generation;
+
+  // Result of the duration query, kept until the caps or segment change
+  gboolean duration_queried;
+  gint64 duration;
 
   // Flags that indicate which properties are set
   GpacPadFlags flags;
 
   // State for the buffers
+  GPAC_QueueLevel* level; // Accounts the buffers gpac references, not owned
+  GPAC_PckRefs* refs;     // Records of the shared buffers of memin, not owned
   gint64 dts_offset;
   gboolean dts_offset_set;
   gboolean last_frame_was_keyframe;
 
+  // Timing parameters resolved from the PID on reconfigure
+  guint64 timescale;
+  GPAC_TimeConverter to_pid; // From GST_SECOND to the PID timescale
+  u32 stream_type;
+  GpacPckBuilder builder; // NULL if the stream type needs no extra step
+
+  // Plane layout of raw video, frames that match it are shared as is
+  gboolean raw_video;
+  u32 stride;
+  u32 stride_uv;
+
   // State for the encoder
   guint64 idr_period;
   guint64 idr_last;
   guint64 idr_next;
-} GpacPadPrivate;
+};
 
 #define GPAC_PID_PROP_IMPL_ARGS_NO_ELEMENT \
   GpacPadPrivate *priv, GF_FilterPid *pid
 #define GPAC_PID_PROP_IMPL_ARGS                           \
   GstElement *element, GPAC_PID_PROP_IMPL_ARGS_NO_ELEMENT
 
+/*! sets the caps of a pad and parses them for the PID property handlers
+    \param[in] priv the private data of the pad
+    \param[in] caps the new caps
+    \return TRUE if the caps changed, FALSE if they are equal to the current
+   ones and the PID does not need to be reconfigured
+*/
+gboolean
+gpac_pid_set_caps(GpacPadPrivate* priv, const GstCaps* caps);
+
+/*! releases the caps of a pad and their parsed form
+    \param[in] priv the private data of the pad
+*/
+void
+gpac_pid_clear_caps(GpacPadPrivate* priv);
+
+/*! picks up the source of a buffer that comes from an upstream gpac element
+    \param[in] priv the private data of the pad
+    \param[in] buffer the buffer
+    \return TRUE if the source or its properties changed and the PID needs to
+   be reconfigured, FALSE otherwise
+*/
+gboolean
+gpac_pid_set_source(GpacPadPrivate* priv, GstBuffer* buffer);
+
 /*! reconfigures a pid based on the given element and pad private data
     \param[in] element the element that the pad belongs to
     \param[in] priv the private data of the pad
@@ -28,12 +28,26 @@
 #include <gpac/filters.h>
 #include <gst/gst.h>
 
+// Default number of gf_fs_run steps per session run
+#define GPAC_DEFAULT_RUN_MAX_STEPS 100
+// Default number of output buffers pushed downstream at once
+#define GPAC_DEFAULT_PUSH_MAX_BUFFERS 1
+
 typedef struct
 {
   gchar* graph;
   gboolean print_stats;
   gboolean sync;
   gchar* destination;
+  gint threads;
+  gchar* cpu_affinity;
+  guint run_max_steps;
+  guint64 run_max_time;
+  guint run_max_packets;
+  gboolean run_until_drained;
+  gboolean warm_restart;
+  guint push_max_buffers;
+  guint64 push_max_latency;
   GList* properties;
   GList* blacklist;
 
@@ -51,10 +65,26 @@ typedef enum
   GPAC_PROP_PRINT_STATS,
   GPAC_PROP_SYNC,
   GPAC_PROP_DESTINATION,
+  GPAC_PROP_THREADS,
+  GPAC_PROP_CPU_AFFINITY,
+  GPAC_PROP_RUN_MAX_STEPS,
+  GPAC_PROP_RUN_MAX_TIME,
+  GPAC_PROP_RUN_MAX_PACKETS,
+  GPAC_PROP_RUN_UNTIL_DRAINED,
+  GPAC_PROP_WARM_RESTART,
+  GPAC_PROP_PUSH_MAX_BUFFERS,
+  GPAC_PROP_PUSH_MAX_LATENCY,
 
   // Element-specific properties
   GPAC_PROP_ELEMENT_OFFSET,
   GPAC_PROP_SEGDUR,
+  GPAC_PROP_RUN_STATS,
+  GPAC_PROP_SEGMENT_STORE,
+  GPAC_PROP_DVR_WINDOW,
+  GPAC_PROP_STORE_MAX_SIZE,
+  GPAC_PROP_MAX_QUEUE_BYTES,
+  GPAC_PROP_MAX_QUEUE_TIME,
+  GPAC_PROP_QUEUE_LEVEL,
 
   // Offset for the filter and global properties
   GPAC_PROP_FILTER_OFFSET,
@@ -0,0 +1,95 @@
+/*
+ *			GPAC - Multimedia Framework C SDK
+ *
+ *			Authors: Deniz Ugur, Romain Bouqueau, Sohaib Larbi
+ *			Copyright (c) Motion Spell
+ *				All rights reserved
+ *
+ *  This file is part of the GPAC/GStreamer wrapper
+ *
+ *  This GPAC/GStreamer wrapper is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Affero General Public License
+ *  as published by the Free Software Foundation; either version 3, or (at
+ *  your option) any later version.
+ *
+ *  This GPAC/GStreamer wrapper is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public
+ *  License along with this library; see the file LICENSE.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#pragma once
+
+#include <gst/gst.h>
+
+/*
+ * Fixed-capacity single-producer/single-consumer ring of pointers.
+ *
+ * The producer only writes the tail and the consumer only writes the head, so
+ * one thread may push while another pops without any lock. No allocation
+ * happens after the ring is created.
+ */
+typedef struct
+{
+  gpointer* slots;
+  guint capacity; // always a power of two
+  guint mask;
+
+  // Keep the indices on separate cache lines to avoid false sharing
+  guint head;
+  guint8 _pad0[64 - sizeof(guint)];
+  guint tail;
+  guint8 _pad1[64 - sizeof(guint)];
+} GPAC_Ring;
+
+/*! creates a new ring
+    \param[in] capacity the minimum number of slots, rounded up to a power of
+   two
+    \return the new ring
+*/
+GPAC_Ring*
+gpac_ring_new(guint capacity);
+
+/*! frees a ring
+    \param[in] ring the ring to free
+    \param[in] free_func called on every item still in the ring, can be NULL
+*/
+void
+gpac_ring_free(GPAC_Ring* ring, GDestroyNotify free_func);
+
+/*! pushes an item at the tail of the ring. Must only be called by the
+   producer
+    \param[in] ring the ring
+    \param[in] item the item to push, must not be NULL
+    \return TRUE if the item was pushed, FALSE if the ring is full
+*/
+gboolean
+gpac_ring_push(GPAC_Ring* ring, gpointer item);
+
+/*! pops an item from the head of the ring. Must only be called by the
+   consumer
+    \param[in] ring the ring
+    \return the item, or NULL if the ring is empty
+*/
+gpointer
+gpac_ring_pop(GPAC_Ring* ring);
+
+/*! gets the number of items in the ring. Can be called from any thread, the
+   result is only a snapshot
+    \param[in] ring the ring
+    \return the fill level of the ring
+*/
+guint
+gpac_ring_get_length(GPAC_Ring* ring);
+
+/*! gets the capacity of the ring
+    \param[in] ring the ring
+    \return the number of slots
+*/
+guint
+gpac_ring_get_capacity(GPAC_Ring* ring);
@@ -29,6 +29,29 @@
 #include <gst/gst.h>
 
 #include "elements/common.h"
+#include "lib/level.h"
+#include "lib/store.h"
+
+typedef struct
+{
+  // 0 means unlimited for all budgets
+  guint max_steps;
+  guint64 max_time; // in microseconds
+  guint max_packets;
+  // keep running until memin handed over all queued packets
+  gboolean until_drained;
+} GPAC_SessionBudget;
+
+typedef struct
+{
+  guint64 runs;
+  guint64 steps;
+  guint64 packets; // packets that reached memout
+  guint64 time;    // total time spent running, in microseconds
+  guint64 max_run_time;
+  // runs stopped early by the time or packet budget
+  guint64 budget_exceeded;
+} GPAC_SessionStats;
 
 typedef struct
 {
@@ -40,12 +63,28 @@ typedef struct
   // overrides
   const gchar* destination;
 
+  // in-memory output of the dasher, NULL when files are written to disk
+  GPAC_SegmentStore* store;
+
+  // threading, 0 threads means the session runs on the calling thread
+  gint threads;
+  const gchar* cpu_affinity;
+
+  // scheduling
+  GPAC_SessionBudget budget;
+  GPAC_SessionStats stats;
+  GPAC_QueueLevel level; // input the session holds on to
+
   /*< internal >*/
   gboolean had_data_flow;
+  gboolean threads_started;
   GstGpacParams* params;
 } GPAC_SessionContext;
 
 /*! initializes a gpac filter session
+    \note if ctx->threads is not 0, the session is created with its own worker
+   threads. The memory io filters are then kept on the calling thread so that
+   packets are only exchanged with the element from the streaming thread
     \param[in] ctx the session context to initialize
     \param[in] element the element to initialize the session with
     \param[in] params single element parameters, can be NULL if the element
@@ -57,6 +96,23 @@ gpac_session_init(GPAC_SessionContext* ctx,
                   GstElement* element,
                   GstGpacParams* params);
 
+/*! creates a gpac filter session with its memory io filters and loads a
+   graph into it
+    \param[in] ctx the session context to prepare
+    \param[in] element the element to initialize the session with
+    \param[in] params single element parameters, can be NULL
+    \param[in] graph the graph to load
+    \param[in] with_memout whether to add the memory output filter
+    \return GF_OK if the session was prepared successfully, an error code
+   otherwise
+*/
+GF_Err
+gpac_session_prepare(GPAC_SessionContext* ctx,
+                     GstElement* element,
+                     GstGpacParams* params,
+                     gchar* graph,
+                     gboolean with_memout);
+
 /*! closes a gpac filter session
     \param[in] ctx the session context to close
     \param[in] print_stats whether to print the session stats
@@ -65,7 +121,9 @@ gpac_session_init(GPAC_SessionContext* ctx,
 gboolean
 gpac_session_close(GPAC_SessionContext* ctx, gboolean print_stats);
 
-/*! runs a gpac filter session
+/*! runs a gpac filter session within the limits of ctx->budget
+    \note when flushing, the session is run to completion and the budget is
+   ignored
     \param[in] ctx the session context to run
     \param[in] flush whether to flush the session
     \return GF_OK if the session was run successfully, an error code otherwise
@@ -73,6 +131,14 @@ gpac_session_close(GPAC_SessionContext* ctx, gboolean print_stats);
 GF_Err
 gpac_session_run(GPAC_SessionContext* ctx, gboolean flush);
 
+/*! counts the tasks executed by the filters of a gpac filter session
+    \note the filters are walked on every call, only use it to report stats
+    \param[in] ctx the session context to query
+    \return the number of tasks executed since the session was created
+*/
+guint64
+gpac_session_get_tasks(GPAC_SessionContext* ctx);
+
 /*! opens a gpac filter session
     \param[in] ctx the session context to open
     \param[in] graph the graph to open
@@ -95,3 +161,51 @@ gpac_session_load_filter(GPAC_SessionContext* ctx, const gchar* filter_name);
 */
 gboolean
 gpac_session_has_output(GPAC_SessionContext* ctx);
+
+/*! computes the delay the filters of a session add between their input and
+   their output: the configured fragment and segment durations of the muxers
+   and dashers
+    \param[in] ctx the session context
+    \return the latency, 0 if the filters output as they go
+*/
+GstClockTime
+gpac_session_get_latency(GPAC_SessionContext* ctx);
+
+/*! prepares a session in the background and keeps it in the process-level
+   session pool until it is acquired with the same key
+    \note the session is prepared like gpac_session_prepare does with the
+   configuration of ctx. Nothing is done if enough sessions are already
+   prepared for this key
+    \note every call counts as a use of the key, until it is released with
+   gpac_session_pool_release
+    \param[in] ctx the session context to copy the configuration from
+    \param[in] key the key identifying the configuration
+    \param[in] graph the graph to load
+    \param[in] with_memout whether to add the memory output filter
+*/
+void
+gpac_session_pool_prepare(GPAC_SessionContext* ctx,
+                          const gchar* key,
+                          const gchar* graph,
+                          gboolean with_memout);
+
+/*! moves a prepared session from the session pool into a session context
+    \note waits for a session that is still being prepared for this key
+    \param[in] ctx the session context to move the session into
+    \param[in] element the element that will use the session
+    \param[in] params single element parameters, can be NULL
+    \param[in] key the key identifying the configuration
+    \return TRUE if a session was acquired, FALSE if it must be prepared
+*/
+gboolean
+gpac_session_pool_acquire(GPAC_SessionContext* ctx,
+                          GstElement* element,
+                          GstGpacParams* params,
+                          const gchar* key);
+
+/*! releases a use of a key taken by gpac_session_pool_prepare. The sessions
+   prepared for the key are closed once it has no use left
+    \param[in] key the key identifying the configuration
+*/
+void
+gpac_session_pool_release(const gchar* key);
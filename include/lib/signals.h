@@ -42,18 +42,24 @@ typedef enum
   GPAC_SIGNAL_DASHER_SEGMENT_INIT,
   GPAC_SIGNAL_DASHER_SEGMENT,
   GPAC_SIGNAL_DASHER_DELETE_SEGMENT,
+  GPAC_SIGNAL_DASHER_SEGMENT_CHUNK,
+  GPAC_SIGNAL_DASHER_SEGMENT_READY,
+  // Action signals, look up the segment store
+  GPAC_SIGNAL_DASHER_GET_STORED,
+  GPAC_SIGNAL_DASHER_GET_STORED_PART,
 
   // Accessors
   GPAC_SIGNAL_START = GPAC_SIGNAL_DASHER_MANIFEST,
-  GPAC_SIGNAL_END = GPAC_SIGNAL_DASHER_DELETE_SEGMENT,
+  GPAC_SIGNAL_END = GPAC_SIGNAL_DASHER_GET_STORED_PART,
   GPAC_SIGNAL_LAST = GPAC_SIGNAL_END + 1,
 } GPAC_SignalId;
 
 // Signal Names
 // Starts from GPAC_SIGNAL_START and ends at GPAC_SIGNAL_END
 static const gchar* gpac_signal_names[] = {
-  "get-manifest", "get-manifest-variant", "get-segment-init",
-  "get-segment",  "delete-segment",
+  "get-manifest",  "get-manifest-variant", "get-segment-init",
+  "get-segment",   "delete-segment",       "segment-chunk",
+  "segment-ready", "get-stored",           "get-stored-part",
 };
 
 /*! installs the signals to the GObject class
@@ -85,3 +91,25 @@ gpac_signal_try_emit(GstElement* element,
                      GPAC_SignalId id,
                      const gchar* location,
                      GOutputStream** output_stream);
+
+/*! checks if a signal has handlers connected
+    \param[in] element the GstElement the signal would be emitted on
+    \param[in] id the signal ID to check
+    \return TRUE if the signal is registered and has handlers, FALSE otherwise
+*/
+gboolean
+gpac_signal_is_connected(GstElement* element, GPAC_SignalId id);
+
+/*! tries to emit a notification signal, which does not return a value
+    \param[in] element the GstElement to emit the signal on
+    \param[in] id the signal ID to emit
+    \param[in] location the location string to pass to the signal
+    \param[in] data the boxed value to pass to the signal, the handlers take
+   their own reference
+    \return TRUE if the signal was emitted, FALSE if it is not registered
+*/
+gboolean
+gpac_signal_try_notify(GstElement* element,
+                       GPAC_SignalId id,
+                       const gchar* location,
+                       gpointer data);
@@ -0,0 +1,181 @@
+/*
+ *			GPAC - Multimedia Framework C SDK
+ *
+ *			Authors: Deniz Ugur, Romain Bouqueau, Sohaib Larbi
+ *			Copyright (c) Motion Spell
+ *				All rights reserved
+ *
+ *  This file is part of the GPAC/GStreamer wrapper
+ *
+ *  This GPAC/GStreamer wrapper is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Affero General Public License
+ *  as published by the Free Software Foundation; either version 3, or (at
+ *  your option) any later version.
+ *
+ *  This GPAC/GStreamer wrapper is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public
+ *  License along with this library; see the file LICENSE.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+#pragma once
+
+#include <gst/gst.h>
+
+// Object data key of the store attached to the elements
+#define GPAC_STORE_QDATA g_quark_from_static_string("gpac-segment-store")
+
+/*
+ * In-memory store of the files produced by the dasher.
+ *
+ * An entry is filled chunk by chunk while its file is written, then committed
+ * to the store under its name. Chunks are referenced, never copied, and
+ * lookups hand them out as the memories of a GstBuffer. Committing an entry
+ * replaces the previous entry with the same name, so manifests are always
+ * served complete. LL-HLS parts addressed by byte range are marked on their
+ * segment, and can be looked up as soon as they are complete, before the
+ * segment itself is committed. Segments and parts are evicted when they are
+ * deleted by the dasher, when they fall out of the DVR window, or when the
+ * store grows past its size limit.
+ */
+typedef struct _GPAC_SegmentStore GPAC_SegmentStore;
+typedef struct _GPAC_StoreEntry GPAC_StoreEntry;
+
+typedef enum
+{
+  GPAC_STORE_ENTRY_MANIFEST,
+  GPAC_STORE_ENTRY_INIT,
+  GPAC_STORE_ENTRY_SEGMENT,
+  GPAC_STORE_ENTRY_PART,
+} GPAC_StoreEntryType;
+
+// Manifests and init segments stay until they are deleted or replaced
+#define GPAC_STORE_ENTRY_IS_WINDOWED(type)                                   \
+  ((type) == GPAC_STORE_ENTRY_SEGMENT || (type) == GPAC_STORE_ENTRY_PART)
+
+/*! creates a new segment store
+    \return the new store
+*/
+GPAC_SegmentStore*
+gpac_store_new(void);
+
+/*! takes a reference on a segment store
+    \param[in] store the store
+    \return the store
+*/
+GPAC_SegmentStore*
+gpac_store_ref(GPAC_SegmentStore* store);
+
+/*! releases a reference on a segment store
+    \param[in] store the store
+*/
+void
+gpac_store_unref(GPAC_SegmentStore* store);
+
+/*! sets the eviction limits of a segment store
+    \param[in] store the store
+    \param[in] window how far back from the end of the newest segment, in
+   media time, segments and parts are kept. 0 keeps them until they are
+   deleted, as are entries without a time range
+    \param[in] max_size the number of bytes the store may hold, 0 for unlimited
+*/
+void
+gpac_store_set_limits(GPAC_SegmentStore* store,
+                      GstClockTime window,
+                      guint64 max_size);
+
+/*! removes every entry of a segment store
+    \param[in] store the store
+*/
+void
+gpac_store_clear(GPAC_SegmentStore* store);
+
+/*! commits an entry to the store, replacing the entry with the same name
+    \param[in] store the store
+    \param[in] entry the entry to commit, the store takes ownership
+*/
+void
+gpac_store_commit(GPAC_SegmentStore* store, GPAC_StoreEntry* entry);
+
+/*! removes an entry from the store
+    \param[in] store the store
+    \param[in] name the name of the entry
+    \return TRUE if the entry was in the store, FALSE otherwise
+*/
+gboolean
+gpac_store_remove(GPAC_SegmentStore* store, const gchar* name);
+
+/*! looks up a committed entry
+    \param[in] store the store
+    \param[in] name the name of the entry
+    \return a buffer referencing the chunks of the entry, or NULL if there is
+   no such entry
+*/
+GstBuffer*
+gpac_store_lookup(GPAC_SegmentStore* store, const gchar* name);
+
+/*! looks up a part of a segment, addressed by byte range
+    \param[in] store the store
+    \param[in] name the name of the segment
+    \param[in] index the index of the part, as marked on the segment
+    \return a buffer referencing the bytes of the part, or NULL if there is no
+   such part or it is not complete yet
+*/
+GstBuffer*
+gpac_store_lookup_part(GPAC_SegmentStore* store,
+                       const gchar* name,
+                       guint index);
+
+/*! opens a new entry, not visible until it is committed
+    \param[in] store the store
+    \param[in] name the name of the entry
+    \param[in] type the type of the entry
+    \return the new entry
+*/
+GPAC_StoreEntry*
+gpac_store_open(GPAC_SegmentStore* store,
+                const gchar* name,
+                GPAC_StoreEntryType type);
+
+/*! discards an entry that was not committed
+    \param[in] entry the entry to discard
+*/
+void
+gpac_store_entry_discard(GPAC_StoreEntry* entry);
+
+/*! appends a chunk to an entry
+    \param[in] entry the entry
+    \param[in] data the data to append, a reference is taken
+*/
+void
+gpac_store_entry_append(GPAC_StoreEntry* entry, GBytes* data);
+
+/*! marks the start of a part at the current end of an entry, the previous
+   part ends there
+    \param[in] entry the entry
+    \param[in] index the index of the part
+*/
+void
+gpac_store_entry_mark_part(GPAC_StoreEntry* entry, guint index);
+
+/*! sets the presentation time range of the media in an entry, used to apply
+   the window of the store
+    \param[in] entry the entry
+    \param[in] start the start of the range
+    \param[in] end the end of the range
+*/
+void
+gpac_store_entry_set_time(GPAC_StoreEntry* entry,
+                          GstClockTime start,
+                          GstClockTime end);
+
+/*! gets the name of an entry
+    \param[in] entry the entry
+    \return the name the entry was created with
+*/
+const gchar*
+gpac_store_entry_get_name(GPAC_StoreEntry* entry);
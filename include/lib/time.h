@@ -39,3 +39,58 @@ guint64
 gpac_time_rescale_with_fps(GstClockTime time,
                            GF_Fraction fps,
                            guint64 desired_timescale);
+
+/**
+ * GPAC_TimeConverter: Converts timestamps from one timescale to another
+ * through a single reduced rational, computed once and reused for every
+ * timestamp. Results are rounded to the nearest tick, in both directions.
+ */
+typedef struct
+{
+  guint64 num;   // Reduced destination timescale
+  guint64 den;   // Reduced source timescale
+  guint64 bias;  // Added before the division to round, den / 2
+  guint64 limit; // Largest time that fits the 64-bit fast path
+} GPAC_TimeConverter;
+
+/*! initializes a timebase converter
+    \param[out] conv the converter to initialize
+    \param[in] from_timescale the timescale of the input timestamps
+    \param[in] to_timescale the timescale of the output timestamps
+    \note a zero timescale yields a converter that always returns 0
+*/
+void
+gpac_time_converter_init(GPAC_TimeConverter* conv,
+                         guint64 from_timescale,
+                         guint64 to_timescale);
+
+/*! converts a timestamp with the given converter
+    \param[in] conv the converter to use
+    \param[in] time the timestamp to convert
+    \return the converted timestamp
+*/
+static inline guint64
+gpac_time_converter_apply(const GPAC_TimeConverter* conv, guint64 time)
+{
+  if (G_LIKELY(time <= conv->limit))
+    return (time * conv->num + conv->bias) / conv->den;
+
+#ifdef __SIZEOF_INT128__
+  // Saturates like gst_util_uint64_scale_round when the result overflows
+  unsigned __int128 wide = (unsigned __int128)time * conv->num + conv->bias;
+  wide /= conv->den;
+  return wide > G_MAXUINT64 ? G_MAXUINT64 : (guint64)wide;
+#else
+  return gst_util_uint64_scale_round(time, conv->num, conv->den);
+#endif
+}
+
+/*! converts an array of timestamps in place
+    \param[in] conv the converter to use
+    \param[in,out] times the timestamps to convert
+    \param[in] count the number of timestamps
+*/
+void
+gpac_time_converter_apply_batch(const GPAC_TimeConverter* conv,
+                                guint64* times,
+                                gsize count);
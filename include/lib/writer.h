@@ -0,0 +1,153 @@
+/*
+ *			GPAC - Multimedia Framework C SDK
+ *
+ *			Authors: Deniz Ugur, Romain Bouqueau, Sohaib Larbi
+ *			Copyright (c) Motion Spell
+ *				All rights reserved
+ *
+ *  This file is part of the GPAC/GStreamer wrapper
+ *
+ *  This GPAC/GStreamer wrapper is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Affero General Public License
+ *  as published by the Free Software Foundation; either version 3, or (at
+ *  your option) any later version.
+ *
+ *  This GPAC/GStreamer wrapper is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public
+ *  License along with this library; see the file LICENSE.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+#pragma once
+
+#include <gio/gio.h>
+#include <gst/gst.h>
+
+// Number of threads shared by all lanes of a pool
+#define GPAC_WRITER_POOL_THREADS 4
+// Bytes a lane may hold before writers are blocked
+#define GPAC_WRITER_LANE_MAX_BYTES (16 * 1024 * 1024)
+// Maximum number of queued writes merged into a single writev
+#define GPAC_WRITER_MAX_VECTORS 64
+
+/*
+ * Pool of threads that perform file I/O on behalf of the streaming thread.
+ *
+ * Every producer (e.g. a rendition of the dasher) owns a lane. Operations on
+ * a lane run in the order they were queued, while different lanes progress in
+ * parallel on the pool threads. Consecutive writes to the same file are merged
+ * into one vectored write. A lane holds a bounded number of bytes, queueing
+ * more blocks the caller until the pool catches up.
+ */
+typedef struct _GPAC_WriterPool GPAC_WriterPool;
+typedef struct _GPAC_WriterLane GPAC_WriterLane;
+typedef struct _GPAC_WriterFile GPAC_WriterFile;
+
+/*! called from the pool once a file is closed
+    \param[in] ok whether every write and the close succeeded
+    \param[in] user_data the data given with the close
+*/
+typedef void (*GPAC_WriterClosedFn)(gboolean ok, gpointer user_data);
+
+/*! creates a new writer pool
+    \param[in] n_threads the number of threads to write with
+    \return the new pool
+*/
+GPAC_WriterPool*
+gpac_writer_pool_new(guint n_threads);
+
+/*! takes a reference on a writer pool
+    \param[in] pool the pool
+    \return the pool
+*/
+GPAC_WriterPool*
+gpac_writer_pool_ref(GPAC_WriterPool* pool);
+
+/*! releases a reference on a writer pool. The last reference waits for the
+   queued operations and stops the threads
+    \param[in] pool the pool
+*/
+void
+gpac_writer_pool_unref(GPAC_WriterPool* pool);
+
+/*! creates a new lane on a pool, the lane keeps a reference on the pool
+    \param[in] pool the pool
+    \return the new lane
+*/
+GPAC_WriterLane*
+gpac_writer_lane_new(GPAC_WriterPool* pool);
+
+/*! waits for the queued operations of a lane and frees it
+    \param[in] lane the lane to free
+*/
+void
+gpac_writer_lane_free(GPAC_WriterLane* lane);
+
+/*! waits until every queued operation of a lane has run
+    \param[in] lane the lane
+*/
+void
+gpac_writer_lane_flush(GPAC_WriterLane* lane);
+
+/*! takes the errors raised by the lane since the last check
+    \param[in] lane the lane
+    \param[out] error the first failed open or write, can be NULL
+    \param[out] warning the first failed delete, can be NULL
+    \return TRUE if no error was raised, FALSE otherwise
+*/
+gboolean
+gpac_writer_lane_check(GPAC_WriterLane* lane,
+                       GError** error,
+                       GError** warning);
+
+/*! queues the opening of a file
+    \param[in] lane the lane
+    \param[in] name the name of the file
+    \param[in] stream the stream to write to, or NULL to open the file at path
+   name from the pool. Takes ownership of the stream
+    \return the handle of the file, valid until it is closed
+*/
+GPAC_WriterFile*
+gpac_writer_open(GPAC_WriterLane* lane,
+                 const gchar* name,
+                 GOutputStream* stream);
+
+/*! queues a write, blocks while the lane is full
+    \param[in] lane the lane
+    \param[in] file the file to write to
+    \param[in] data the data to write, a reference is taken
+*/
+void
+gpac_writer_write(GPAC_WriterLane* lane, GPAC_WriterFile* file, GBytes* data);
+
+/*! queues the closing of a file, the handle must not be used afterwards
+    \param[in] lane the lane
+    \param[in] file the file to close
+    \param[in] closed called once the file is closed, can be NULL
+    \param[in] user_data the data to pass to closed
+    \param[in] notify frees user_data once the file is closed, can be NULL
+*/
+void
+gpac_writer_close(GPAC_WriterLane* lane,
+                  GPAC_WriterFile* file,
+                  GPAC_WriterClosedFn closed,
+                  gpointer user_data,
+                  GDestroyNotify notify);
+
+/*! queues the deletion of a file
+    \param[in] lane the lane
+    \param[in] path the path of the file to delete
+*/
+void
+gpac_writer_delete(GPAC_WriterLane* lane, const gchar* path);
+
+/*! gets the name of a file
+    \param[in] file the file
+    \return the name the file was opened with
+*/
+const gchar*
+gpac_writer_file_get_name(GPAC_WriterFile* file);
@@ -169,6 +169,14 @@ gst_gpac_sink_instance_init(GstGpacSink* sink)
   // Create a fake sink element
   sink->sink = gst_element_factory_make("fakesink", NULL);
 
+  // Share the segment store of the transform element
+  GPAC_SegmentStore* store =
+    g_object_get_qdata(G_OBJECT(sink->tf), GPAC_STORE_QDATA);
+  g_object_set_qdata_full(G_OBJECT(sink),
+                          GPAC_STORE_QDATA,
+                          gpac_store_ref(store),
+                          (GDestroyNotify)gpac_store_unref);
+
   // Add and link the elements
   gst_bin_add_many(GST_BIN(sink), sink->tf, sink->sink, NULL);
   gst_element_link(sink->tf, sink->sink);
@@ -206,8 +214,23 @@ gst_gpac_sink_subclass_init(GstGpacSinkClass* klass)
 
   // Set the property handlers
   gpac_install_global_properties(gobject_class);
-  gpac_install_local_properties(
-    gobject_class, GPAC_PROP_PRINT_STATS, GPAC_PROP_SYNC, GPAC_PROP_0);
+  gpac_install_local_properties(gobject_class,
+                                GPAC_PROP_PRINT_STATS,
+                                GPAC_PROP_SYNC,
+                                GPAC_PROP_THREADS,
+                                GPAC_PROP_CPU_AFFINITY,
+                                GPAC_PROP_RUN_MAX_STEPS,
+                                GPAC_PROP_RUN_MAX_TIME,
+                                GPAC_PROP_RUN_MAX_PACKETS,
+                                GPAC_PROP_RUN_UNTIL_DRAINED,
+                                GPAC_PROP_WARM_RESTART,
+                                GPAC_PROP_PUSH_MAX_BUFFERS,
+                                GPAC_PROP_PUSH_MAX_LATENCY,
+                                GPAC_PROP_MAX_QUEUE_BYTES,
+                                GPAC_PROP_MAX_QUEUE_TIME,
+                                GPAC_PROP_RUN_STATS,
+                                GPAC_PROP_QUEUE_LEVEL,
+                                GPAC_PROP_0);
 
   // Add the subclass-specific properties and pad templates
   if (params->is_single) {
@@ -29,6 +29,9 @@
 GST_DEBUG_CATEGORY_STATIC(gst_gpac_tf_debug);
 #define GST_CAT_DEFAULT gst_gpac_tf_debug
 
+// How long a throttled aggregate waits for the gpac threads to release input
+#define GPAC_QUEUE_WAIT_TIMEOUT (10 * G_TIME_SPAN_MILLISECOND)
+
 // #MARK: Pad Class
 G_DEFINE_TYPE(GstGpacTransformPad, gst_gpac_tf_pad, GST_TYPE_AGGREGATOR_PAD);
 
@@ -46,11 +49,12 @@ gst_gpac_tf_pad_set_property(GObject* object,
                              GParamSpec* pspec)
 {
   GstGpacTransformPad* pad = GST_GPAC_TF_PAD(object);
+  GpacPadPrivate* priv = gst_pad_get_element_private(GST_PAD(pad));
   g_return_if_fail(GST_IS_GPAC_TF_PAD(object));
 
   switch (prop_id) {
     case GPAC_PROP_PAD_PID:
-      pad->pid = g_value_get_pointer(value);
+      priv->pid = g_value_get_pointer(value);
       break;
 
     default:
@@ -66,11 +70,12 @@ gst_gpac_tf_pad_get_property(GObject* object,
                              GParamSpec* pspec)
 {
   GstGpacTransformPad* pad = GST_GPAC_TF_PAD(object);
+  GpacPadPrivate* priv = gst_pad_get_element_private(GST_PAD(pad));
   g_return_if_fail(GST_IS_GPAC_TF_PAD(object));
 
   switch (prop_id) {
     case GPAC_PROP_PAD_PID:
-      g_value_set_pointer(value, pad->pid);
+      g_value_set_pointer(value, priv->pid);
       break;
 
     default:
@@ -89,8 +94,6 @@ gst_gpac_tf_pad_init(GstGpacTransformPad* pad)
   priv->idr_last = GST_CLOCK_TIME_NONE;
   priv->idr_next = GST_CLOCK_TIME_NONE;
   gst_pad_set_element_private(GST_PAD(pad), priv);
-
-  pad->pid = NULL;
 };
 
 static void
@@ -100,12 +103,12 @@ gst_gpac_tf_pad_finalize(GObject* object)
   GpacPadPrivate* priv = gst_pad_get_element_private(GST_PAD(pad));
 
   if (priv) {
-    if (priv->caps)
-      gst_caps_unref(priv->caps);
+    gpac_pid_clear_caps(priv);
     if (priv->segment)
       gst_segment_free(priv->segment);
     if (priv->tags)
       gst_tag_list_unref(priv->tags);
+    gpac_pck_source_unref(priv->source);
     g_free(priv);
     gst_pad_set_element_private(GST_PAD(pad), NULL);
   }
@@ -144,6 +147,9 @@ gst_gpac_tf_set_property(GObject* object,
 {
   GstGpacTransform* gpac_tf = GST_GPAC_TF(object);
   g_return_if_fail(GST_IS_GPAC_TF(object));
+
+  // Options may change the delay of the graph
+  g_atomic_int_set(&gpac_tf->latency_changed, TRUE);
   if (gpac_set_property(GPAC_PROP_CTX(GPAC_CTX), prop_id, value, pspec))
     return;
 
@@ -158,6 +164,26 @@ gst_gpac_tf_set_property(GObject* object,
                          GST_TIME_ARGS(gpac_tf->global_idr_period));
         break;
 
+      case GPAC_PROP_SEGMENT_STORE:
+        gpac_tf->segment_store = g_value_get_boolean(value);
+        break;
+
+      case GPAC_PROP_DVR_WINDOW:
+        gpac_tf->dvr_window = g_value_get_uint64(value);
+        break;
+
+      case GPAC_PROP_STORE_MAX_SIZE:
+        gpac_tf->store_max_size = g_value_get_uint64(value);
+        break;
+
+      case GPAC_PROP_MAX_QUEUE_BYTES:
+        GPAC_SESS_CTX(GPAC_CTX)->level.max_bytes = g_value_get_uint64(value);
+        break;
+
+      case GPAC_PROP_MAX_QUEUE_TIME:
+        GPAC_SESS_CTX(GPAC_CTX)->level.max_time = g_value_get_uint64(value);
+        break;
+
       default:
         break;
     }
@@ -186,6 +212,62 @@ gst_gpac_tf_get_property(GObject* object,
                           ((float)gpac_tf->global_idr_period) / GST_SECOND);
         break;
 
+      case GPAC_PROP_SEGMENT_STORE:
+        g_value_set_boolean(value, gpac_tf->segment_store);
+        break;
+
+      case GPAC_PROP_DVR_WINDOW:
+        g_value_set_uint64(value, gpac_tf->dvr_window);
+        break;
+
+      case GPAC_PROP_STORE_MAX_SIZE:
+        g_value_set_uint64(value, gpac_tf->store_max_size);
+        break;
+
+      case GPAC_PROP_MAX_QUEUE_BYTES:
+        g_value_set_uint64(value, GPAC_SESS_CTX(GPAC_CTX)->level.max_bytes);
+        break;
+
+      case GPAC_PROP_MAX_QUEUE_TIME:
+        g_value_set_uint64(value, GPAC_SESS_CTX(GPAC_CTX)->level.max_time);
+        break;
+
+      case GPAC_PROP_QUEUE_LEVEL: {
+        GPAC_QueueLevel* level = &GPAC_SESS_CTX(GPAC_CTX)->level;
+        g_value_take_boxed(value, gpac_queue_level_to_structure(level));
+        break;
+      }
+
+      case GPAC_PROP_RUN_STATS: {
+        GPAC_SessionStats* stats = &GPAC_SESS_CTX(GPAC_CTX)->stats;
+        g_value_take_boxed(
+          value,
+          gst_structure_new("run-stats",
+                            "runs",
+                            G_TYPE_UINT64,
+                            stats->runs,
+                            "steps",
+                            G_TYPE_UINT64,
+                            stats->steps,
+                            "tasks",
+                            G_TYPE_UINT64,
+                            gpac_session_get_tasks(GPAC_SESS_CTX(GPAC_CTX)),
+                            "packets",
+                            G_TYPE_UINT64,
+                            stats->packets,
+                            "time",
+                            G_TYPE_UINT64,
+                            stats->time,
+                            "max-run-time",
+                            G_TYPE_UINT64,
+                            stats->max_run_time,
+                            "budget-exceeded",
+                            G_TYPE_UINT64,
+                            stats->budget_exceeded,
+                            NULL));
+        break;
+      }
+
       default:
         break;
     }
@@ -196,100 +278,378 @@ gst_gpac_tf_get_property(GObject* object,
 }
 
 // #MARK: Helper Functions
-static gboolean
-gpac_prepare_pids(GstElement* element)
+static void
+gpac_update_pad_snapshot(GstGpacTransform* gpac_tf)
 {
-  GstGpacTransform* gpac_tf = GST_GPAC_TF(element);
-  GstIterator* pad_iter;
-  GValue item = G_VALUE_INIT;
-  gboolean done = FALSE;
-  gboolean ret = FALSE;
+  GPtrArray* old_pads = gpac_tf->pads;
+  GPtrArray* pads = g_ptr_array_new_with_free_func(gst_object_unref);
+
+  // Take a reference on the current sink pads
+  GST_OBJECT_LOCK(gpac_tf);
+  for (GList* l = GST_ELEMENT(gpac_tf)->sinkpads; l; l = l->next)
+    g_ptr_array_add(pads, gst_object_ref(l->data));
+  GST_OBJECT_UNLOCK(gpac_tf);
+
+  // Delete the PIDs of the pads that are gone
+  for (guint i = 0; old_pads && i < old_pads->len; i++) {
+    GstPad* pad = g_ptr_array_index(old_pads, i);
+    GpacPadPrivate* priv = gst_pad_get_element_private(pad);
+    if (g_ptr_array_find(pads, pad, NULL) || !priv->pid)
+      continue;
+    gpac_pid_del(priv->pid);
+    priv->pid = NULL;
+  }
 
-  // Track configuration status
-  GHashTable* pids_before_reset =
-    g_hash_table_new(g_direct_hash, g_direct_equal);
-  GHashTable* pids_seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+  gpac_tf->pads = pads;
+  if (old_pads)
+    g_ptr_array_unref(old_pads);
+  GST_DEBUG_OBJECT(gpac_tf, "Pad snapshot updated, %u pads", pads->len);
+}
 
-  // Iterate over the pads
-  pad_iter = gst_element_iterate_sink_pads(element);
-  while (!done) {
-    switch (gst_iterator_next(pad_iter, &item)) {
-      case GST_ITERATOR_OK: {
-        GstPad* pad = g_value_get_object(&item);
-        GstAggregatorPad* agg_pad = GST_AGGREGATOR_PAD(pad);
-        GpacPadPrivate* priv = gst_pad_get_element_private(pad);
+// Sink pads as seen from the aggregator thread, refreshed once they changed
+static GPtrArray*
+gpac_get_pad_snapshot(GstGpacTransform* gpac_tf)
+{
+  if (g_atomic_int_compare_and_exchange(&gpac_tf->pads_changed, TRUE, FALSE) ||
+      !gpac_tf->pads)
+    gpac_update_pad_snapshot(gpac_tf);
+  return gpac_tf->pads;
+}
 
-        // Get the PID
-        GF_FilterPid* pid = NULL;
-        g_object_get(agg_pad, "pid", &pid, NULL);
-
-        // Create the PID if necessary
-        if (pid == NULL) {
-          pid = gpac_pid_new(GPAC_SESS_CTX(GPAC_CTX));
-          if (G_UNLIKELY(pid == NULL)) {
-            GST_ELEMENT_ERROR(
-              element, STREAM, FAILED, (NULL), ("Failed to create PID"));
-            goto fail;
-          }
-          g_object_set(agg_pad, "pid", pid, NULL);
+static gboolean
+gpac_prepare_pids(GstElement* element)
+{
+  GstGpacTransform* gpac_tf = GST_GPAC_TF(element);
 
-          // Share the pad private data
-          gf_filter_pid_set_udta(pid, priv);
-        }
+  // Refresh the snapshot if pads were added or removed
+  gpac_get_pad_snapshot(gpac_tf);
 
-        if (priv->flags) {
-          if (G_UNLIKELY(!gpac_pid_reconfigure(element, priv, pid))) {
-            GST_ELEMENT_ERROR(
-              element, STREAM, FAILED, (NULL), ("Failed to reconfigure PID"));
-            goto fail;
-          }
-          priv->flags = 0;
-        }
+  // Nothing to do until a pad or its caps, tags or segment change
+  if (!g_atomic_int_compare_and_exchange(&gpac_tf->pids_changed, TRUE, FALSE))
+    return TRUE;
 
-        // Track the PID
-        g_hash_table_insert(pids_seen, pid, GINT_TO_POINTER(1));
+  for (guint i = 0; i < gpac_tf->pads->len; i++) {
+    GstPad* pad = g_ptr_array_index(gpac_tf->pads, i);
+    GpacPadPrivate* priv = gst_pad_get_element_private(pad);
 
-        g_value_reset(&item);
-        break;
+    // Create the PID if necessary
+    if (priv->pid == NULL) {
+      priv->pid = gpac_pid_new(GPAC_SESS_CTX(GPAC_CTX));
+      if (G_UNLIKELY(priv->pid == NULL)) {
+        GST_ELEMENT_ERROR(
+          element, STREAM, FAILED, (NULL), ("Failed to create PID"));
+        goto fail;
       }
-      case GST_ITERATOR_RESYNC:
-        gst_iterator_resync(pad_iter);
 
-        // Add seen PIDs to the before reset list
-        g_hash_table_foreach(
-          pids_seen, (GHFunc)g_hash_table_insert, pids_before_reset);
-        g_hash_table_remove_all(pids_seen);
+      // Share the pad private data
+      gf_filter_pid_set_udta(priv->pid, priv);
+      priv->refs = gpac_memio_get_pck_refs(GPAC_SESS_CTX(GPAC_CTX)->memin);
+      gpac_pck_cache_pid_params(element, priv, priv->pid);
+    }
 
-        break;
-      case GST_ITERATOR_ERROR:
+    if (priv->flags) {
+      if (G_UNLIKELY(!gpac_pid_reconfigure(element, priv, priv->pid))) {
         GST_ELEMENT_ERROR(
-          element, STREAM, FAILED, (NULL), ("Failed to iterate over pads"));
+          element, STREAM, FAILED, (NULL), ("Failed to reconfigure PID"));
         goto fail;
-      case GST_ITERATOR_DONE:
-        done = TRUE;
-        ret = TRUE;
-        break;
+      }
+      priv->flags = 0;
     }
   }
 
-  // Check for PIDs that are no longer needed
-  GHashTableIter iter;
-  gpointer key, value;
-  g_hash_table_iter_init(&iter, pids_before_reset);
-  while (g_hash_table_iter_next(&iter, &key, &value)) {
-    if (!g_hash_table_contains(pids_seen, key)) {
-      GF_FilterPid* pid = key;
-      gpac_pid_del(pid);
+  return TRUE;
+
+fail:
+  // Retry on the next call
+  g_atomic_int_set(&gpac_tf->pids_changed, TRUE);
+  return FALSE;
+}
+
+// #MARK: Source Pads
+static GstPad*
+gst_gpac_tf_get_output_pad(GstGpacTransform* gpac_tf, GF_FilterPid* pid)
+{
+  GstElement* element = GST_ELEMENT(gpac_tf);
+  GstAggregator* agg = GST_AGGREGATOR(gpac_tf);
+  GstPad* pad = gpac_memio_get_src_pad(pid);
+  if (pad)
+    return pad;
+
+  // The first output keeps the always pad, so single output graphs are as is
+  GstElementClass* klass = GST_ELEMENT_GET_CLASS(element);
+  GstPadTemplate* templ = gst_element_class_get_pad_template(klass, "src_%u");
+  if (!gpac_tf->srcpad_claimed || !templ) {
+    gpac_tf->srcpad_claimed = TRUE;
+    gpac_memio_set_src_pad(pid, agg->srcpad);
+    return agg->srcpad;
+  }
+
+  gchar* name = g_strdup_printf("src_%u", gpac_tf->src_pad_count++);
+  pad = gst_pad_new_from_template(templ, name);
+  g_free(name);
+  gst_pad_use_fixed_caps(pad);
+  gst_pad_set_active(pad, TRUE);
+
+  // Sticky events, sent downstream once the pad is linked
+  gchar* stream_id = gst_pad_create_stream_id(pad, element, GST_PAD_NAME(pad));
+  gst_pad_push_event(pad, gst_event_new_stream_start(stream_id));
+  g_free(stream_id);
+
+  GstCaps* caps = gpac_caps_from_pid(pid);
+  GST_DEBUG_OBJECT(
+    element, "Adding pad %s, caps: %" GST_PTR_FORMAT, GST_PAD_NAME(pad), caps);
+  gst_pad_set_caps(pad, caps);
+  gst_caps_unref(caps);
+
+  GstSegment* segment = &GST_AGGREGATOR_PAD(agg->srcpad)->segment;
+  gst_pad_push_event(pad, gst_event_new_segment(segment));
+
+  gst_element_add_pad(element, pad);
+  gst_flow_combiner_add_pad(gpac_tf->flow_combiner, pad);
+  gpac_tf->src_pads = g_list_append(gpac_tf->src_pads, gst_object_ref(pad));
+  gpac_memio_set_src_pad(pid, pad);
+  return pad;
+}
+
+static GstFlowReturn
+gst_gpac_tf_push_output(GstGpacTransform* gpac_tf,
+                        GstPad* pad,
+                        GPAC_FilterPPRet ret,
+                        void* output)
+{
+  GstFlowReturn flow_ret;
+  if (HAS_FLAG(ret, GPAC_FILTER_PP_RET_BUFFER))
+    flow_ret = gst_pad_push(pad, GST_BUFFER(output));
+  else
+    flow_ret = gst_pad_push_list(pad, GST_BUFFER_LIST(output));
+
+  // An output nobody is linked to must not stop the others
+  flow_ret = gst_flow_combiner_update_pad_flow(
+    gpac_tf->flow_combiner, pad, flow_ret);
+  return flow_ret == GST_FLOW_NOT_LINKED ? GST_FLOW_OK : flow_ret;
+}
+
+static void
+gst_gpac_tf_push_src_pads_eos(GstGpacTransform* gpac_tf)
+{
+  for (GList* l = gpac_tf->src_pads; l; l = l->next)
+    gst_pad_push_event(GST_PAD(l->data), gst_event_new_eos());
+}
+
+static gboolean
+gst_gpac_tf_forward_event(GstElement* element, GstPad* pad, gpointer event)
+{
+  // The aggregator takes care of the always pad
+  if (pad != GST_AGGREGATOR(element)->srcpad)
+    gst_pad_push_event(pad, gst_event_ref(GST_EVENT(event)));
+  return TRUE;
+}
+
+static void
+gst_gpac_tf_queue_src_pads_event(GstGpacTransform* gpac_tf, GstEvent* event)
+{
+  GST_OBJECT_LOCK(gpac_tf);
+  g_queue_push_tail(&gpac_tf->src_pad_events, gst_event_ref(event));
+  GST_OBJECT_UNLOCK(gpac_tf);
+}
+
+static void
+gst_gpac_tf_push_src_pads_events(GstGpacTransform* gpac_tf)
+{
+  GstEvent* event;
+  while (TRUE) {
+    GST_OBJECT_LOCK(gpac_tf);
+    event = g_queue_pop_head(&gpac_tf->src_pad_events);
+    GST_OBJECT_UNLOCK(gpac_tf);
+    if (!event)
+      break;
+
+    gst_element_foreach_src_pad(
+      GST_ELEMENT(gpac_tf), gst_gpac_tf_forward_event, event);
+    gst_event_unref(event);
+  }
+}
+
+static void
+gst_gpac_tf_clear_src_pads_events(GstGpacTransform* gpac_tf)
+{
+  GST_OBJECT_LOCK(gpac_tf);
+  g_queue_clear_full(&gpac_tf->src_pad_events,
+                     (GDestroyNotify)gst_mini_object_unref);
+  GST_OBJECT_UNLOCK(gpac_tf);
+}
+
+static void
+gst_gpac_tf_check_no_more_pads(GstGpacTransform* gpac_tf, gboolean is_eos)
+{
+  if (gpac_tf->no_more_pads)
+    return;
+
+  // Outputs are only known once each of them has delivered data
+  if (!is_eos) {
+    GF_Filter* memout = GPAC_SESS_CTX(GPAC_CTX)->memout;
+    u32 count = memout ? gf_filter_get_ipid_count(memout) : 0;
+    if (!count)
+      return;
+    for (u32 i = 0; i < count; i++) {
+      if (!gpac_memio_get_src_pad(gf_filter_get_ipid(memout, i)))
+        return;
     }
   }
 
-fail:
-  // Clean up
-  g_value_unset(&item);
-  gst_iterator_free(pad_iter);
-  g_hash_table_destroy(pids_before_reset);
-  g_hash_table_destroy(pids_seen);
-  return ret;
+  GST_DEBUG_OBJECT(gpac_tf, "All output pads are exposed");
+  gpac_tf->no_more_pads = TRUE;
+  gst_element_no_more_pads(GST_ELEMENT(gpac_tf));
+}
+
+static void
+gst_gpac_tf_remove_src_pads(GstGpacTransform* gpac_tf)
+{
+  for (GList* l = gpac_tf->src_pads; l; l = l->next) {
+    GstPad* pad = GST_PAD(l->data);
+    gst_flow_combiner_remove_pad(gpac_tf->flow_combiner, pad);
+    gst_pad_set_active(pad, FALSE);
+    gst_element_remove_pad(GST_ELEMENT(gpac_tf), pad);
+  }
+  g_list_free_full(gpac_tf->src_pads, gst_object_unref);
+  gpac_tf->src_pads = NULL;
+  gpac_tf->src_pad_count = 0;
+  gpac_tf->srcpad_claimed = FALSE;
+  gpac_tf->no_more_pads = FALSE;
+  gst_gpac_tf_clear_src_pads_events(gpac_tf);
+}
+
+// #MARK: Batching
+static GstFlowReturn
+gst_gpac_tf_flush_batch(GstAggregator* agg, GstBufferList** batch)
+{
+  GstBufferList* buffer_list = g_steal_pointer(batch);
+  if (!buffer_list)
+    return GST_FLOW_OK;
+
+  // A single buffer does not need the list
+  if (gst_buffer_list_length(buffer_list) == 1) {
+    GstBuffer* buffer = gst_buffer_ref(gst_buffer_list_get(buffer_list, 0));
+    gst_buffer_list_unref(buffer_list);
+    return gst_aggregator_finish_buffer(agg, buffer);
+  }
+
+  GST_LOG_OBJECT(
+    agg, "Pushing %u buffers", gst_buffer_list_length(buffer_list));
+  return gst_aggregator_finish_buffer_list(agg, buffer_list);
+}
+
+static GstFlowReturn
+gst_gpac_tf_batch_buffer(GstGpacTransform* gpac_tf,
+                         GstBufferList** batch,
+                         GstClockTime* batch_start,
+                         GstBuffer* buffer)
+{
+  GstAggregator* agg = GST_AGGREGATOR(gpac_tf);
+  GPAC_PropertyContext* ctx = GPAC_PROP_CTX(GPAC_CTX);
+  GstClockTime ts = GST_BUFFER_DTS_OR_PTS(buffer);
+
+  // Push what we have if this buffer would go over the latency cap
+  if (*batch && ctx->push_max_latency && GST_CLOCK_TIME_IS_VALID(ts) &&
+      GST_CLOCK_TIME_IS_VALID(*batch_start) &&
+      ts > *batch_start + ctx->push_max_latency * GST_USECOND) {
+    GstFlowReturn flow_ret = gst_gpac_tf_flush_batch(agg, batch);
+    if (flow_ret != GST_FLOW_OK) {
+      gst_buffer_unref(buffer);
+      return flow_ret;
+    }
+  }
+
+  if (!*batch) {
+    *batch = gst_buffer_list_new_sized(MIN(ctx->push_max_buffers, 1024));
+    *batch_start = GST_CLOCK_TIME_NONE;
+  }
+  if (!GST_CLOCK_TIME_IS_VALID(*batch_start))
+    *batch_start = ts;
+  gst_buffer_list_add(*batch, buffer);
+
+  if (gst_buffer_list_length(*batch) >= ctx->push_max_buffers)
+    return gst_gpac_tf_flush_batch(agg, batch);
+  return GST_FLOW_OK;
+}
+
+// #MARK: Queue Level
+// Running time of the newest buffer of an output
+static GstClockTime
+gst_gpac_tf_output_time(GstSegment* segment, GPAC_FilterPPRet ret, void* output)
+{
+  GstBuffer* buffer = NULL;
+  if (HAS_FLAG(ret, GPAC_FILTER_PP_RET_BUFFER_LIST)) {
+    guint length = gst_buffer_list_length(GST_BUFFER_LIST(output));
+    if (length)
+      buffer = gst_buffer_list_get(GST_BUFFER_LIST(output), length - 1);
+  } else {
+    buffer = GST_BUFFER(output);
+  }
+
+  if (!buffer || !GST_CLOCK_TIME_IS_VALID(GST_BUFFER_DTS_OR_PTS(buffer)))
+    return GST_CLOCK_TIME_NONE;
+  return gst_segment_to_running_time(
+    segment, GST_FORMAT_TIME, GST_BUFFER_DTS_OR_PTS(buffer));
+}
+
+// Called after a throttled aggregate ran the session
+static void
+gst_gpac_tf_check_queue(GstGpacTransform* gpac_tf,
+                        guint64 bytes,
+                        GstClockTime time)
+{
+  GPAC_QueueLevel* level = &GPAC_SESS_CTX(GPAC_CTX)->level;
+
+  // Input is released by the worker threads, or without them by downstream
+  // letting go of the output that shares it. Wait for it instead of running
+  // the session again right away
+  if (gpac_queue_level_wait(level, GPAC_QUEUE_WAIT_TIMEOUT))
+    return;
+
+  // Keep throttling as long as the session works through its input
+  if (gpac_queue_level_get_bytes(level) < bytes ||
+      gpac_queue_level_get_time(level) < time)
+    return;
+
+  // The session needs more input to produce anything, e.g. to finish a
+  // segment, let it through until the level goes down again
+  GST_WARNING_OBJECT(
+    gpac_tf,
+    "Queue limits reached with no progress, at %" G_GUINT64_FORMAT
+    " bytes and %" GST_TIME_FORMAT ", letting input through",
+    gpac_queue_level_get_bytes(level),
+    GST_TIME_ARGS(gpac_queue_level_get_time(level)));
+  gpac_tf->queue_overrun = TRUE;
+}
+
+// #MARK: Latency
+static void
+gst_gpac_tf_update_latency(GstGpacTransform* gpac_tf)
+{
+  GPAC_SessionContext* sess = GPAC_SESS_CTX(GPAC_CTX);
+  if (!sess->session)
+    return;
+
+  // Filters are loaded as the graph resolves
+  guint n_filters = gf_fs_get_filters_count(sess->session);
+  if (!g_atomic_int_compare_and_exchange(
+        &gpac_tf->latency_changed, TRUE, FALSE) &&
+      n_filters == gpac_tf->latency_filters)
+    return;
+  gpac_tf->latency_filters = n_filters;
+
+  GstClockTime latency = gpac_session_get_latency(sess);
+  if (latency == gpac_tf->latency)
+    return;
+
+  // Posts a latency message, so that the pipeline picks up the new value
+  GST_INFO_OBJECT(gpac_tf,
+                  "Reporting a latency of %" GST_TIME_FORMAT,
+                  GST_TIME_ARGS(latency));
+  gpac_tf->latency = latency;
+  gst_aggregator_set_latency(
+    GST_AGGREGATOR(gpac_tf), latency, GST_CLOCK_TIME_NONE);
 }
 
 // #MARK: Aggregator
@@ -299,12 +659,23 @@ gst_gpac_tf_consume(GstAggregator* agg, Bool is_eos)
   GstFlowReturn flow_ret = GST_FLOW_OK;
   GstGpacTransform* gpac_tf = GST_GPAC_TF(agg);
   GstSegment* segment = &GST_AGGREGATOR_PAD(agg->srcpad)->segment;
+  GPAC_QueueLevel* level = &GPAC_SESS_CTX(GPAC_CTX)->level;
 
   GST_DEBUG_OBJECT(agg, "Consuming output...");
 
+  // Events of the sink pads go before the data that follows them
+  gst_gpac_tf_push_src_pads_events(gpac_tf);
+
+  // Single buffers for the always pad are pushed together
+  GstBufferList* batch = NULL;
+  GstClockTime batch_start = GST_CLOCK_TIME_NONE;
+  gboolean batching = GPAC_PROP_CTX(GPAC_CTX)->push_max_buffers > 1;
+
   void* output;
+  GF_FilterPid* pid;
   GPAC_FilterPPRet ret;
-  while ((ret = gpac_memio_consume(GPAC_SESS_CTX(GPAC_CTX), &output))) {
+  while (
+    (ret = gpac_memio_consume(GPAC_SESS_CTX(GPAC_CTX), &output, &pid))) {
     if (ret & GPAC_FILTER_PP_RET_ERROR) {
       // An error occurred, stop processing
       goto error;
@@ -313,6 +684,10 @@ gst_gpac_tf_consume(GstAggregator* agg, Bool is_eos)
     if (ret == GPAC_FILTER_PP_RET_EMPTY) {
       // No data available
       GST_DEBUG_OBJECT(agg, "No more data available, exiting");
+      gst_gpac_tf_check_no_more_pads(gpac_tf, is_eos);
+      flow_ret = gst_gpac_tf_flush_batch(agg, &batch);
+      if (flow_ret != GST_FLOW_OK)
+        return flow_ret;
       return is_eos ? GST_FLOW_EOS : GST_FLOW_OK;
     }
 
@@ -325,9 +700,32 @@ gst_gpac_tf_consume(GstAggregator* agg, Bool is_eos)
                                         GST_BUFFER_DTS(output),
                                         GST_BUFFER_DURATION(output),
                                         NULL);
+        gpac_queue_level_update_output(
+          level, gst_gpac_tf_output_time(segment, ret, output));
       }
 
-      if (HAS_FLAG(ret, GPAC_FILTER_PP_RET_BUFFER)) {
+      // Outputs other than the first one go to their own pad
+      GstPad* pad = pid ? gst_gpac_tf_get_output_pad(gpac_tf, pid) : NULL;
+      gboolean is_main = !pad || pad == agg->srcpad;
+      gboolean is_buffer = HAS_FLAG(ret, GPAC_FILTER_PP_RET_BUFFER);
+
+      // Anything else on the always pad goes after the gathered buffers
+      if (is_main && !(batching && is_buffer)) {
+        flow_ret = gst_gpac_tf_flush_batch(agg, &batch);
+        if (flow_ret != GST_FLOW_OK) {
+          if (output)
+            gst_mini_object_unref(GST_MINI_OBJECT_CAST(output));
+          goto flow_error;
+        }
+      }
+
+      if (!is_main) {
+        GST_DEBUG_OBJECT(agg, "Pushing output on %s", GST_PAD_NAME(pad));
+        flow_ret = gst_gpac_tf_push_output(gpac_tf, pad, ret, output);
+      } else if (is_buffer && batching) {
+        flow_ret = gst_gpac_tf_batch_buffer(
+          gpac_tf, &batch, &batch_start, GST_BUFFER(output));
+      } else if (is_buffer) {
         // Send the buffer
         GST_DEBUG_OBJECT(agg, "Sending buffer");
         flow_ret = gst_aggregator_finish_buffer(agg, GST_BUFFER(output));
@@ -376,6 +774,9 @@ gst_gpac_tf_consume(GstAggregator* agg, Bool is_eos)
         GstBuffer* buffer = gpac_tf->sync_buffer;
         if (!buffer)
           buffer = gst_buffer_new();
+        gpac_queue_level_update_output(
+          level,
+          gst_gpac_tf_output_time(segment, GPAC_FILTER_PP_RET_BUFFER, buffer));
 
         // Send the sync buffer
         flow_ret = gst_aggregator_finish_buffer(agg, buffer);
@@ -391,20 +792,24 @@ gst_gpac_tf_consume(GstAggregator* agg, Bool is_eos)
         g_warn_if_reached();
       }
 
-      if (flow_ret != GST_FLOW_OK) {
-        GST_ELEMENT_ERROR(agg,
-                          STREAM,
-                          FAILED,
-                          (NULL),
-                          ("Failed to finish buffer, ret: %d", flow_ret));
-        return flow_ret;
-      }
+      if (flow_ret != GST_FLOW_OK)
+        goto flow_error;
     }
   }
 
 error:
+  g_clear_pointer(&batch, gst_buffer_list_unref);
   GST_ELEMENT_ERROR(agg, STREAM, FAILED, (NULL), ("Failed to consume output"));
   return GST_FLOW_ERROR;
+
+flow_error:
+  g_clear_pointer(&batch, gst_buffer_list_unref);
+  GST_ELEMENT_ERROR(agg,
+                    STREAM,
+                    FAILED,
+                    (NULL),
+                    ("Failed to finish buffer, ret: %d", flow_ret));
+  return flow_ret;
 }
 
 static gboolean
@@ -417,34 +822,44 @@ gst_gpac_tf_sink_event(GstAggregator* agg,
 
   switch (GST_EVENT_TYPE(event)) {
     case GST_EVENT_CAPS: {
-      if (priv->caps)
-        gst_caps_unref(priv->caps);
-
       GstCaps* caps;
       gst_event_parse_caps(event, &caps);
-      priv->caps = gst_caps_ref(caps);
-      priv->flags |= GPAC_PAD_CAPS_SET;
+
+      // Identical caps leave the PID as it is
+      if (gpac_pid_set_caps(priv, caps)) {
+        priv->flags |= GPAC_PAD_CAPS_SET;
+        g_atomic_int_set(&gpac_tf->pids_changed, TRUE);
+      }
       break;
     }
 
     case GST_EVENT_SEGMENT: {
-      if (priv->segment)
-        gst_segment_free(priv->segment);
-
       const GstSegment* segment;
       gst_event_parse_segment(event, &segment);
-      priv->segment = gst_segment_copy(segment);
-      priv->flags |= GPAC_PAD_SEGMENT_SET;
       priv->dts_offset_set = FALSE;
 
-      gboolean is_video_pad = gst_pad_get_pad_template(GST_PAD(pad)) ==
-                              gst_gpac_get_sink_template(GPAC_TEMPLATE_VIDEO);
-      gboolean is_only_pad = g_list_length(GST_ELEMENT(agg)->sinkpads) == 1;
+      // Identical segments leave the PID as it is
+      if (!priv->segment || !gst_segment_is_equal(priv->segment, segment)) {
+        if (priv->segment)
+          gst_segment_free(priv->segment);
+        priv->segment = gst_segment_copy(segment);
+        priv->duration_queried = FALSE;
+        priv->flags |= GPAC_PAD_SEGMENT_SET;
+        g_atomic_int_set(&gpac_tf->pids_changed, TRUE);
+      }
+
+      gboolean is_video_pad = priv->kind == GPAC_TEMPLATE_VIDEO;
+      // Serialized events run on the aggregator thread, as aggregate does
+      GPtrArray* pads = gpac_get_pad_snapshot(gpac_tf);
+      gboolean is_only_pad = pads->len == 1;
 
       // Update the segment and global offset only if video pad or the only pad
       if (is_video_pad || is_only_pad) {
         gst_aggregator_update_segment(agg, gst_segment_copy(segment));
         gpac_memio_set_global_offset(GPAC_SESS_CTX(GPAC_CTX), segment);
+
+        // Flushes drop the segment of the other outputs too
+        gst_gpac_tf_queue_src_pads_event(gpac_tf, event);
       }
 
       // Check if playback rate is equal to 1.0
@@ -457,26 +872,39 @@ gst_gpac_tf_sink_event(GstAggregator* agg,
     }
 
     case GST_EVENT_TAG: {
-      if (priv->tags)
-        gst_tag_list_unref(priv->tags);
-
       GstTagList* tags;
       gst_event_parse_tag(event, &tags);
+
+      // Identical tags leave the PID as it is
+      if (priv->tags && gst_tag_list_is_equal(priv->tags, tags))
+        break;
+
+      if (priv->tags)
+        gst_tag_list_unref(priv->tags);
       priv->tags = gst_tag_list_ref(tags);
       priv->flags |= GPAC_PAD_TAGS_SET;
+      g_atomic_int_set(&gpac_tf->pids_changed, TRUE);
+
+      // Stream tags end up in the PID, global ones concern every output
+      if (gst_tag_list_get_scope(tags) == GST_TAG_SCOPE_GLOBAL)
+        gst_gpac_tf_queue_src_pads_event(gpac_tf, event);
       break;
     }
 
+    case GST_EVENT_GAP:
+      gst_gpac_tf_queue_src_pads_event(gpac_tf, event);
+      break;
+
     case GST_EVENT_EOS: {
       // Set this pad as EOS
       priv->eos = TRUE;
 
       // Are all pads EOS?
       gboolean all_eos = TRUE;
-      GList* sinkpads = GST_ELEMENT(agg)->sinkpads;
-      for (GList* l = sinkpads; l; l = l->next) {
-        GstAggregatorPad* agg_pad = GST_AGGREGATOR_PAD(l->data);
-        GpacPadPrivate* priv = gst_pad_get_element_private(GST_PAD(agg_pad));
+      GPtrArray* pads = gpac_get_pad_snapshot(gpac_tf);
+      for (guint i = 0; i < pads->len; i++) {
+        GpacPadPrivate* priv =
+          gst_pad_get_element_private(g_ptr_array_index(pads, i));
         if (!priv->eos) {
           all_eos = FALSE;
           break;
@@ -493,12 +921,26 @@ gst_gpac_tf_sink_event(GstAggregator* agg,
       gpac_memio_set_eos(GPAC_SESS_CTX(GPAC_CTX), TRUE);
       gpac_session_run(GPAC_SESS_CTX(GPAC_CTX), TRUE);
       gst_gpac_tf_consume(agg, GST_EVENT_TYPE(event) == GST_EVENT_EOS);
+
+      // The aggregator only forwards EOS on the always pad
+      gst_gpac_tf_push_src_pads_eos(gpac_tf);
       break;
     }
 
     case GST_EVENT_FLUSH_START:
       gpac_session_run(GPAC_SESS_CTX(GPAC_CTX), TRUE);
       gst_gpac_tf_consume(agg, GST_EVENT_TYPE(event) == GST_EVENT_EOS);
+
+      // Unblock the other outputs, what they had not sent yet is dropped
+      gst_gpac_tf_clear_src_pads_events(gpac_tf);
+      gst_element_foreach_src_pad(
+        GST_ELEMENT(agg), gst_gpac_tf_forward_event, event);
+      break;
+
+    case GST_EVENT_FLUSH_STOP:
+      gst_element_foreach_src_pad(
+        GST_ELEMENT(agg), gst_gpac_tf_forward_event, event);
+      gst_flow_combiner_reset(gpac_tf->flow_combiner);
       break;
 
     default:
@@ -616,11 +1058,11 @@ static GstFlowReturn
 gst_gpac_tf_aggregate(GstAggregator* agg, gboolean timeout)
 {
   GstGpacTransform* gpac_tf = GST_GPAC_TF(GST_ELEMENT(agg));
-  GstIterator* pad_iter;
-  GValue item = G_VALUE_INIT;
-  gboolean done = FALSE;
   gboolean has_buffers = TRUE;
 
+  // Pick up any debug threshold change made since the last call
+  gpac_log_sync_levels(FALSE);
+
   // Check and create PIDs if necessary
   if (!gpac_prepare_pids(GST_ELEMENT(agg))) {
     GST_ELEMENT_ERROR(agg, STREAM, FAILED, (NULL), ("Failed to prepare PIDs"));
@@ -629,136 +1071,151 @@ gst_gpac_tf_aggregate(GstAggregator* agg, gboolean timeout)
 
   GST_DEBUG_OBJECT(agg, "Aggregating buffers");
 
-  // Create the temporary queue
-  GQueue* queue = g_queue_new();
+  // Number of packets handed to memin in this call
+  guint num_packets = 0;
+  gboolean is_only_pad = gpac_tf->pads->len == 1;
+
+  // Input is left on the pads while the session holds too much of it
+  GPAC_QueueLevel* level = &GPAC_SESS_CTX(GPAC_CTX)->level;
+  gboolean throttled = FALSE;
+  if (gpac_tf->queue_overrun && !gpac_queue_level_is_full(level))
+    gpac_tf->queue_overrun = FALSE;
 
   // Keep consuming buffers until all pads are drained
-  while (has_buffers) {
+  while (has_buffers && !throttled) {
     has_buffers = FALSE;
-    done = FALSE;
-
-    // Iterate over the pads
-    pad_iter = gst_element_iterate_sink_pads(GST_ELEMENT(agg));
-    while (!done) {
-      switch (gst_iterator_next(pad_iter, &item)) {
-        case GST_ITERATOR_OK: {
-          GF_FilterPid* pid = NULL;
-          GstPad* pad = g_value_get_object(&item);
-          GpacPadPrivate* priv = gst_pad_get_element_private(pad);
-          GstBuffer* buffer =
-            gst_aggregator_pad_pop_buffer(GST_AGGREGATOR_PAD(pad));
-
-          // Continue if no buffer is available
-          if (!buffer) {
-            GST_DEBUG_OBJECT(
-              agg, "No buffer available on pad %s", GST_PAD_NAME(pad));
-            goto next;
-          }
 
-          // We found at least one buffer, continue the outer loop
-          has_buffers = TRUE;
+    // Iterate over the pad snapshot, from where the last throttle stopped
+    guint n_pads = gpac_tf->pads->len;
+    for (guint n = 0; n < n_pads; n++) {
+      guint i = (gpac_tf->next_pad + n) % n_pads;
+      GstPad* pad = g_ptr_array_index(gpac_tf->pads, i);
+      GpacPadPrivate* priv = gst_pad_get_element_private(pad);
+      gboolean is_video_pad = priv->kind == GPAC_TEMPLATE_VIDEO;
+      if (!gpac_tf->queue_overrun && gpac_queue_level_is_full(level)) {
+        GST_LOG_OBJECT(agg, "Queue limits reached, holding the input back");
+        gpac_tf->next_pad = i;
+        throttled = TRUE;
+        break;
+      }
 
-          // Skip droppable/gap buffers
-          if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_GAP)) {
-            GST_DEBUG_OBJECT(
-              agg, "Gap buffer received on pad %s", GST_PAD_NAME(pad));
-            goto next;
-          }
+      GstBuffer* buffer =
+        gst_aggregator_pad_pop_buffer(GST_AGGREGATOR_PAD(pad));
 
-          // Send the key frame request
-          // Only send IDR request for video pads
-          if (gst_pad_get_pad_template(pad) ==
-              gst_gpac_get_sink_template(GPAC_TEMPLATE_VIDEO)) {
-            gst_gpac_request_idr(agg, pad, buffer);
-          }
+      // Continue if no buffer is available
+      if (!buffer) {
+        GST_DEBUG_OBJECT(
+          agg, "No buffer available on pad %s", GST_PAD_NAME(pad));
+        continue;
+      }
 
-          // Get the PID
-          g_object_get(GST_AGGREGATOR_PAD(pad), "pid", &pid, NULL);
-          g_assert(pid);
-
-          // Create the packet
-          GF_FilterPacket* packet = gpac_pck_new_from_buffer(buffer, priv, pid);
-          if (!packet) {
-            GST_ELEMENT_ERROR(agg,
-                              STREAM,
-                              FAILED,
-                              (NULL),
-                              ("Failed to create packet from buffer"));
-            goto next;
-          }
+      // We found at least one buffer, continue the outer loop
+      has_buffers = TRUE;
 
-          // Enqueue the packet
-          g_queue_push_tail(queue, packet);
-
-          // Select the highest PTS for sync buffer
-          gboolean is_video_pad =
-            gst_pad_get_pad_template(GST_PAD(pad)) ==
-            gst_gpac_get_sink_template(GPAC_TEMPLATE_VIDEO);
-          gboolean is_only_pad = g_list_length(GST_ELEMENT(agg)->sinkpads) == 1;
-          if (is_video_pad || is_only_pad) {
-            if (gpac_tf->sync_buffer) {
-              guint64 current_pts = GST_BUFFER_PTS(buffer);
-              guint64 sync_pts = GST_BUFFER_PTS(gpac_tf->sync_buffer);
-              if (current_pts > sync_pts) {
-                gst_buffer_replace(&gpac_tf->sync_buffer, buffer);
-              }
-            } else {
-              // If no sync buffer exists, create one
-              gpac_tf->sync_buffer = gst_buffer_ref(buffer);
-            }
-          }
+      // Skip droppable/gap buffers
+      if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_GAP)) {
+        GST_DEBUG_OBJECT(
+          agg, "Gap buffer received on pad %s", GST_PAD_NAME(pad));
+        goto next;
+      }
 
-        next:
-          if (buffer)
-            gst_buffer_unref(buffer);
-          g_value_reset(&item);
-          break;
+      // Send the key frame request
+      // Only send IDR request for video pads
+      if (is_video_pad)
+        gst_gpac_request_idr(agg, pad, buffer);
+
+      // Buffers of an upstream gpac element carry the properties of its PID
+      g_assert(priv->pid);
+      if (gpac_pid_set_source(priv, buffer)) {
+        priv->flags |= GPAC_PAD_SOURCE_SET;
+        if (G_UNLIKELY(
+              !gpac_pid_reconfigure(GST_ELEMENT(agg), priv, priv->pid))) {
+          GST_ELEMENT_ERROR(
+            agg, STREAM, FAILED, (NULL), ("Failed to reconfigure PID"));
+          goto next;
         }
-        case GST_ITERATOR_RESYNC:
-          gst_iterator_resync(pad_iter);
-          GST_ELEMENT_WARNING(agg,
-                              STREAM,
-                              FAILED,
-                              (NULL),
-                              ("Data structure changed during pad iteration, "
-                               "discarding all packets"));
-          g_queue_clear_full(queue, (GDestroyNotify)gf_filter_pck_unref);
-          break;
-        case GST_ITERATOR_ERROR:
-        case GST_ITERATOR_DONE:
-          done = TRUE;
-          break;
+        priv->flags = 0;
+      }
+
+      // Create the packet
+      GF_FilterPacket* packet =
+        gpac_pck_new_from_buffer(buffer, priv, priv->pid);
+      if (!packet) {
+        GST_ELEMENT_ERROR(agg,
+                          STREAM,
+                          FAILED,
+                          (NULL),
+                          ("Failed to create packet from buffer"));
+        goto next;
       }
+
+      // Enqueue the packet, draining memin first if it is full
+      if (!gpac_memio_push(GPAC_SESS_CTX(GPAC_CTX), packet)) {
+        GST_DEBUG_OBJECT(agg, "Input queue is full, running the session");
+        gpac_session_run(GPAC_SESS_CTX(GPAC_CTX), FALSE);
+        if (!gpac_memio_push(GPAC_SESS_CTX(GPAC_CTX), packet)) {
+          GST_ELEMENT_ERROR(
+            agg,
+            STREAM,
+            FAILED,
+            (NULL),
+            ("Failed to queue packet, input queue is still full"));
+          gf_filter_pck_discard(packet);
+          goto next;
+        }
+      }
+      num_packets++;
+      if (priv->segment)
+        gpac_queue_level_update_input(
+          level,
+          gst_segment_to_running_time(
+            priv->segment, GST_FORMAT_TIME, GST_BUFFER_DTS_OR_PTS(buffer)));
+
+      // Select the highest PTS for sync buffer
+      if (is_video_pad || is_only_pad) {
+        if (gpac_tf->sync_buffer) {
+          guint64 current_pts = GST_BUFFER_PTS(buffer);
+          guint64 sync_pts = GST_BUFFER_PTS(gpac_tf->sync_buffer);
+          if (current_pts > sync_pts) {
+            gst_buffer_replace(&gpac_tf->sync_buffer, buffer);
+          }
+        } else {
+          // If no sync buffer exists, create one
+          gpac_tf->sync_buffer = gst_buffer_ref(buffer);
+        }
+      }
+
+    next:
+      gst_buffer_unref(buffer);
     }
   }
 
-  // Clean up
-  g_value_unset(&item);
-  gst_iterator_free(pad_iter);
-
   // Check if we have any packets to send
-  if (g_queue_is_empty(queue)) {
+  if (!num_packets && !throttled) {
     GST_DEBUG_OBJECT(agg, "No packets to send, returning EOS");
-    g_queue_free(queue);
     return GST_FLOW_EOS;
   }
-
-  // Merge the queues
-  while (!g_queue_is_empty(queue)) {
-    gpointer pck = g_queue_pop_head(queue);
-    g_queue_push_tail(gpac_tf->queue, pck);
-  }
-  g_queue_free(queue);
+  GST_LOG_OBJECT(agg,
+                 "Queued %u packets, input queue at %u/%u",
+                 num_packets,
+                 gpac_memio_get_pending(GPAC_SESS_CTX(GPAC_CTX)),
+                 gpac_memio_get_capacity(GPAC_SESS_CTX(GPAC_CTX)));
 
   // Run the filter session
+  guint64 held_bytes = gpac_queue_level_get_bytes(level);
+  GstClockTime held_time = gpac_queue_level_get_time(level);
   if (gpac_session_run(GPAC_SESS_CTX(GPAC_CTX), FALSE) != GF_OK) {
     GST_ELEMENT_ERROR(
       agg, STREAM, FAILED, (NULL), ("Failed to run the GPAC session"));
     return GST_FLOW_ERROR;
   }
+  gst_gpac_tf_update_latency(gpac_tf);
 
   // Consume the output
-  return gst_gpac_tf_consume(agg, FALSE);
+  GstFlowReturn flow_ret = gst_gpac_tf_consume(agg, FALSE);
+  if (throttled && flow_ret == GST_FLOW_OK)
+    gst_gpac_tf_check_queue(gpac_tf, held_bytes, held_time);
+  return flow_ret;
 }
 
 // #MARK: Pad Management
@@ -772,21 +1229,23 @@ gst_gpac_tf_create_new_pad(GstAggregator* element,
   GstGpacTransform* agg = GST_GPAC_TF(element);
   gchar* name;
   gint pad_id;
+  GstGpacSinkTemplateType kind;
 
-#define TEMPLATE_CHECK(prefix, count_field)                                 \
+#define TEMPLATE_CHECK(prefix, count_field, template_type)                  \
   if (templ == gst_element_class_get_pad_template(klass, prefix "_%u")) {   \
     if (pad_name != NULL && sscanf(pad_name, prefix "_%u", &pad_id) == 1) { \
       name = g_strdup(pad_name);                                            \
     } else {                                                                \
       name = g_strdup_printf(prefix "_%u", agg->count_field++);             \
     }                                                                       \
+    kind = template_type;                                                   \
   } else
 
   // Check the pad template and decide the pad name
-  TEMPLATE_CHECK("video", video_pad_count)
-  TEMPLATE_CHECK("audio", audio_pad_count)
-  TEMPLATE_CHECK("subtitle", subtitle_pad_count)
-  TEMPLATE_CHECK("caption", caption_pad_count)
+  TEMPLATE_CHECK("video", video_pad_count, GPAC_TEMPLATE_VIDEO)
+  TEMPLATE_CHECK("audio", audio_pad_count, GPAC_TEMPLATE_AUDIO)
+  TEMPLATE_CHECK("subtitle", subtitle_pad_count, GPAC_TEMPLATE_SUBTITLE)
+  TEMPLATE_CHECK("caption", caption_pad_count, GPAC_TEMPLATE_CAPTION)
   {
     GST_ELEMENT_WARNING(
       agg, STREAM, FAILED, (NULL), ("This is not our template!"));
@@ -815,8 +1274,10 @@ gst_gpac_tf_create_new_pad(GstAggregator* element,
   // Initialize the private data
   GpacPadPrivate* priv = gst_pad_get_element_private(GST_PAD(pad));
   priv->id = pad_count;
+  priv->kind = kind;
+  priv->level = &agg->gpac_ctx.sess.level;
   if (caps) {
-    priv->caps = gst_caps_copy(caps);
+    gpac_pid_set_caps(priv, caps);
     priv->flags |= GPAC_PAD_CAPS_SET;
   }
 
@@ -833,12 +1294,20 @@ gst_gpac_tf_reset(GstGpacTransform* tf)
   while (!done) {
     switch (gst_iterator_next(pad_iter, &item)) {
       case GST_ITERATOR_OK: {
-        GF_FilterPid* pid = NULL;
         GstPad* pad = g_value_get_object(&item);
         GpacPadPrivate* priv = gst_pad_get_element_private(pad);
 
-        // Reset the PID
-        g_object_set(GST_AGGREGATOR_PAD(pad), "pid", NULL, NULL);
+        // Reset the PID, the new one is configured from what is known
+        priv->pid = NULL;
+        if (priv->caps)
+          priv->flags |= GPAC_PAD_CAPS_SET;
+        if (priv->tags)
+          priv->flags |= GPAC_PAD_TAGS_SET;
+        if (priv->segment)
+          priv->flags |= GPAC_PAD_SEGMENT_SET;
+        if (priv->source)
+          priv->flags |= GPAC_PAD_SOURCE_SET;
+        g_value_reset(&item);
         break;
       }
       case GST_ITERATOR_RESYNC:
@@ -851,9 +1320,55 @@ gst_gpac_tf_reset(GstGpacTransform* tf)
   g_value_unset(&item);
   gst_iterator_free(pad_iter);
 
-  // Empty the queue
-  if (tf->queue)
-    g_queue_clear_full(tf->queue, (GDestroyNotify)gf_filter_pck_unref);
+  // PIDs must be recreated on the next start
+  g_atomic_int_set(&tf->pads_changed, TRUE);
+  g_atomic_int_set(&tf->pids_changed, TRUE);
+}
+
+static void
+gst_gpac_tf_pad_added(GstElement* element, GstPad* pad)
+{
+  GstGpacTransform* gpac_tf = GST_GPAC_TF(element);
+  if (GST_PAD_IS_SINK(pad)) {
+    g_atomic_int_set(&gpac_tf->pads_changed, TRUE);
+    g_atomic_int_set(&gpac_tf->pids_changed, TRUE);
+  }
+
+  if (GST_ELEMENT_CLASS(parent_class)->pad_added)
+    GST_ELEMENT_CLASS(parent_class)->pad_added(element, pad);
+}
+
+static void
+gst_gpac_tf_pad_removed(GstElement* element, GstPad* pad)
+{
+  GstGpacTransform* gpac_tf = GST_GPAC_TF(element);
+  if (GST_PAD_IS_SINK(pad))
+    g_atomic_int_set(&gpac_tf->pads_changed, TRUE);
+
+  if (GST_ELEMENT_CLASS(parent_class)->pad_removed)
+    GST_ELEMENT_CLASS(parent_class)->pad_removed(element, pad);
+}
+
+// Sessions can only be shared between identical configurations
+static gchar*
+gst_gpac_tf_session_key(GstGpacTransform* gpac_tf,
+                        const gchar* graph,
+                        gboolean requires_memout)
+{
+  GPAC_PropertyContext* ctx = GPAC_PROP_CTX(GPAC_CTX);
+  GString* key = g_string_new(G_OBJECT_TYPE_NAME(gpac_tf));
+  g_string_append_printf(key,
+                         "\n%s\n%s\n%d\n%s\n%d",
+                         graph,
+                         ctx->destination ? ctx->destination : "",
+                         ctx->threads,
+                         ctx->cpu_affinity ? ctx->cpu_affinity : "",
+                         requires_memout);
+
+  // The gpac arguments are global, but they shape the filters
+  for (guint i = 0; ctx->props_as_argv && ctx->props_as_argv[i]; i++)
+    g_string_append_printf(key, "\n%s", ctx->props_as_argv[i]);
+  return g_string_free(key, FALSE);
 }
 
 static gboolean
@@ -886,20 +1401,32 @@ gst_gpac_tf_start(GstAggregator* aggregator)
     return FALSE;
   }
 
-  // Create the session
-  if (!gpac_session_init(GPAC_SESS_CTX(GPAC_CTX), element, params)) {
-    GST_ELEMENT_ERROR(
-      element, LIBRARY, INIT, (NULL), ("Failed to initialize GPAC session"));
-    return FALSE;
+  // Set the threading and scheduling options on session context
+  GPAC_SessionContext* sess_ctx = GPAC_SESS_CTX(GPAC_CTX);
+  GPAC_PropertyContext* prop_ctx = GPAC_PROP_CTX(GPAC_CTX);
+  sess_ctx->threads = prop_ctx->threads;
+  sess_ctx->cpu_affinity = prop_ctx->cpu_affinity;
+  sess_ctx->budget.max_steps = prop_ctx->run_max_steps;
+  sess_ctx->budget.max_time = prop_ctx->run_max_time;
+  sess_ctx->budget.max_packets = prop_ctx->run_max_packets;
+  sess_ctx->budget.until_drained = prop_ctx->run_until_drained;
+  gpac_queue_level_reset(&sess_ctx->level);
+  gpac_tf->queue_overrun = FALSE;
+
+  // The latency is computed again once the new graph resolves
+  gpac_tf->latency_filters = 0;
+  g_atomic_int_set(&gpac_tf->latency_changed, TRUE);
+
+  // Start from an empty store, entries of the previous run are stale
+  sess_ctx->store = NULL;
+  if (gpac_tf->segment_store) {
+    sess_ctx->store = g_object_get_qdata(G_OBJECT(element), GPAC_STORE_QDATA);
+    gpac_store_clear(sess_ctx->store);
+    gpac_store_set_limits(
+      sess_ctx->store, gpac_tf->dvr_window, gpac_tf->store_max_size);
   }
 
-  // Create the memory input
-  gpac_return_val_if_fail(
-    gpac_memio_new(GPAC_SESS_CTX(GPAC_CTX), GPAC_MEMIO_DIR_IN), FALSE);
-  gpac_memio_assign_queue(
-    GPAC_SESS_CTX(GPAC_CTX), GPAC_MEMIO_DIR_IN, gpac_tf->queue);
-
-  // Open the session
+  // Build the graph
   gchar* graph = NULL;
   if (params->is_single) {
     if (params->info->default_options) {
@@ -948,22 +1475,38 @@ gst_gpac_tf_start(GstAggregator* aggregator)
   // Set the destination override on session context
   GPAC_SESS_CTX(GPAC_CTX)->destination = GPAC_PROP_CTX(GPAC_CTX)->destination;
 
-  gpac_return_val_if_fail(gpac_session_open(GPAC_SESS_CTX(GPAC_CTX), graph),
-                          FALSE);
-  g_free(graph);
-
-  // Create the memory output
+  // Check if the session needs a memory output
   gboolean is_inside_sink = GST_IS_GPAC_SINK(gst_element_get_parent(element));
   gboolean requires_memout =
     params->info && GPAC_SE_IS_REQUIRES_MEMOUT(params->info->flags);
   requires_memout = !is_inside_sink || (is_inside_sink && requires_memout) ||
                     GPAC_PROP_CTX(GPAC_CTX)->destination;
 
-  if (requires_memout) {
-    gpac_return_val_if_fail(
-      gpac_memio_new(GPAC_SESS_CTX(GPAC_CTX), GPAC_MEMIO_DIR_OUT), FALSE);
+  // Create the session, or take the one prepared by the previous start
+  gchar* key = NULL;
+  if (prop_ctx->warm_restart)
+    key = gst_gpac_tf_session_key(gpac_tf, graph, requires_memout);
+  if (!key || !gpac_session_pool_acquire(sess_ctx, element, params, key)) {
+    if (gpac_session_prepare(
+          sess_ctx, element, params, graph, requires_memout) != GF_OK) {
+      GST_ELEMENT_ERROR(
+        element, LIBRARY, INIT, (NULL), ("Failed to prepare GPAC session"));
+      g_free(key);
+      g_free(graph);
+      return FALSE;
+    }
   }
 
+  // Build the session of the next start while this one runs, the previous
+  // key is released afterwards so that its sessions survive if it is the same
+  if (key)
+    gpac_session_pool_prepare(sess_ctx, key, graph, requires_memout);
+  if (gpac_tf->pool_key)
+    gpac_session_pool_release(gpac_tf->pool_key);
+  g_free(gpac_tf->pool_key);
+  gpac_tf->pool_key = key;
+  g_free(graph);
+
   // Check if the session has an output
   if (!gpac_session_has_output(GPAC_SESS_CTX(GPAC_CTX))) {
     GST_ELEMENT_ERROR(
@@ -996,6 +1539,7 @@ gst_gpac_tf_stop(GstAggregator* aggregator)
 
   // Reset the element
   gst_gpac_tf_reset(gpac_tf);
+  gst_gpac_tf_remove_src_pads(gpac_tf);
 
   // Close the session
   if (!gpac_session_close(GPAC_SESS_CTX(GPAC_CTX),
@@ -1020,6 +1564,18 @@ gst_gpac_tf_finalize(GObject* object)
   // Free the properties
   g_list_free(ctx->properties);
   ctx->properties = NULL;
+  g_clear_pointer(&ctx->cpu_affinity, g_free);
+
+  // Nothing can acquire the sessions prepared for this element anymore
+  if (gpac_tf->pool_key)
+    gpac_session_pool_release(gpac_tf->pool_key);
+  g_clear_pointer(&gpac_tf->pool_key, g_free);
+
+  // Release the pad snapshot
+  g_clear_pointer(&gpac_tf->pads, g_ptr_array_unref);
+  g_clear_pointer(&gpac_tf->flow_combiner, gst_flow_combiner_free);
+  gst_gpac_tf_clear_src_pads_events(gpac_tf);
+  gpac_queue_level_clear(&GPAC_SESS_CTX(GPAC_CTX)->level);
 
   if (ctx->props_as_argv) {
     for (u32 i = 0; ctx->props_as_argv[i]; i++)
@@ -1027,13 +1583,6 @@ gst_gpac_tf_finalize(GObject* object)
     g_free((void*)ctx->props_as_argv);
   }
 
-  // Free the queue
-  if (gpac_tf->queue) {
-    g_assert(g_queue_is_empty(gpac_tf->queue));
-    g_queue_free(gpac_tf->queue);
-    gpac_tf->queue = NULL;
-  }
-
   G_OBJECT_CLASS(parent_class)->finalize(object);
 }
 
@@ -1041,8 +1590,17 @@ gst_gpac_tf_finalize(GObject* object)
 static void
 gst_gpac_tf_init(GstGpacTransform* tf)
 {
+  tf->pads = g_ptr_array_new_with_free_func(gst_object_unref);
+  tf->flow_combiner = gst_flow_combiner_new();
+  g_queue_init(&tf->src_pad_events);
+  gpac_queue_level_init(&tf->gpac_ctx.sess.level);
+  g_object_set_qdata_full(G_OBJECT(tf),
+                          GPAC_STORE_QDATA,
+                          gpac_store_new(),
+                          (GDestroyNotify)gpac_store_unref);
   gst_gpac_tf_reset(tf);
-  tf->queue = g_queue_new();
+  tf->gpac_ctx.prop.run_max_steps = GPAC_DEFAULT_RUN_MAX_STEPS;
+  tf->gpac_ctx.prop.push_max_buffers = GPAC_DEFAULT_PUSH_MAX_BUFFERS;
 }
 
 static void
@@ -1058,6 +1616,8 @@ gst_gpac_tf_class_init(GstGpacTransformClass* klass)
   gpac_install_sink_pad_templates(gstelement_class);
 
   // Set the pad management functions
+  gstelement_class->pad_added = GST_DEBUG_FUNCPTR(gst_gpac_tf_pad_added);
+  gstelement_class->pad_removed = GST_DEBUG_FUNCPTR(gst_gpac_tf_pad_removed);
   gstaggregator_class->create_new_pad =
     GST_DEBUG_FUNCPTR(gst_gpac_tf_create_new_pad);
 
@@ -1087,8 +1647,22 @@ gst_gpac_tf_subclass_init(GstGpacTransformClass* klass)
   gobject_class->set_property = GST_DEBUG_FUNCPTR(gst_gpac_tf_set_property);
   gobject_class->get_property = GST_DEBUG_FUNCPTR(gst_gpac_tf_get_property);
   gpac_install_global_properties(gobject_class);
-  gpac_install_local_properties(
-    gobject_class, GPAC_PROP_PRINT_STATS, GPAC_PROP_0);
+  gpac_install_local_properties(gobject_class,
+                                GPAC_PROP_PRINT_STATS,
+                                GPAC_PROP_THREADS,
+                                GPAC_PROP_CPU_AFFINITY,
+                                GPAC_PROP_RUN_MAX_STEPS,
+                                GPAC_PROP_RUN_MAX_TIME,
+                                GPAC_PROP_RUN_MAX_PACKETS,
+                                GPAC_PROP_RUN_UNTIL_DRAINED,
+                                GPAC_PROP_WARM_RESTART,
+                                GPAC_PROP_PUSH_MAX_BUFFERS,
+                                GPAC_PROP_PUSH_MAX_LATENCY,
+                                GPAC_PROP_MAX_QUEUE_BYTES,
+                                GPAC_PROP_MAX_QUEUE_TIME,
+                                GPAC_PROP_RUN_STATS,
+                                GPAC_PROP_QUEUE_LEVEL,
+                                GPAC_PROP_0);
 
   // Add the subclass-specific properties and pad templates
   if (params->is_single) {
@@ -1135,6 +1709,7 @@ gst_gpac_tf_subclass_init(GstGpacTransformClass* klass)
     }
   } else {
     gpac_install_src_pad_templates(gstelement_class);
+    gpac_install_src_sometimes_pad_template(gstelement_class);
     gpac_install_local_properties(
       gobject_class, GPAC_PROP_GRAPH, GPAC_PROP_DESTINATION, GPAC_PROP_0);
 
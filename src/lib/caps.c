@@ -26,8 +26,9 @@
 #include "lib/caps.h"
 
 GstGpacFormatProp gst_gpac_sink_formats = {
-  .video_caps = GST_STATIC_CAPS(AV1_CAPS "; " H264_CAPS "; " H265_CAPS),
-  .audio_caps = GST_STATIC_CAPS(AAC_CAPS "; " EAC3_CAPS),
+  .video_caps = GST_STATIC_CAPS(AV1_CAPS "; " H264_CAPS "; " H265_CAPS
+                                         "; " RAW_VIDEO_CAPS),
+  .audio_caps = GST_STATIC_CAPS(AAC_CAPS "; " EAC3_CAPS "; " RAW_AUDIO_CAPS),
   .subtitle_caps = GST_STATIC_CAPS(TEXT_UTF8),
   .caption_caps = GST_STATIC_CAPS(CEA708_CAPS),
 };
@@ -95,12 +96,23 @@ GstStaticPadTemplate gst_gpac_src_template =
                           GST_PAD_ALWAYS,
                           GST_STATIC_CAPS(QT_CAPS "; " MPEG_TS_CAPS));
 
+// Additional outputs of the session, described by their PID
+GstStaticPadTemplate gst_gpac_src_sometimes_template = GST_STATIC_PAD_TEMPLATE(
+  "src_%u", GST_PAD_SRC, GST_PAD_SOMETIMES, GST_STATIC_CAPS_ANY);
+
 void
 gpac_install_src_pad_templates(GstElementClass* klass)
 {
   gst_element_class_add_static_pad_template(klass, &gst_gpac_src_template);
 }
 
+void
+gpac_install_src_sometimes_pad_template(GstElementClass* klass)
+{
+  gst_element_class_add_static_pad_template(klass,
+                                            &gst_gpac_src_sometimes_template);
+}
+
 GF_FilterCapability*
 gpac_gstcaps_to_gfcaps(GstCaps* caps, guint* nb_caps)
 {
@@ -141,3 +153,248 @@ gpac_gstcaps_to_gfcaps(GstCaps* caps, guint* nb_caps)
 
   return gf_caps;
 }
+
+// #MARK: Raw formats
+static const struct
+{
+  GstVideoFormat format;
+  u32 pixel_format;
+} raw_video_formats[] = {
+  { GST_VIDEO_FORMAT_I420, GF_PIXEL_YUV },
+  { GST_VIDEO_FORMAT_YV12, GF_PIXEL_YVU },
+  { GST_VIDEO_FORMAT_NV12, GF_PIXEL_NV12 },
+  { GST_VIDEO_FORMAT_NV21, GF_PIXEL_NV21 },
+  { GST_VIDEO_FORMAT_Y42B, GF_PIXEL_YUV422 },
+  { GST_VIDEO_FORMAT_Y444, GF_PIXEL_YUV444 },
+  { GST_VIDEO_FORMAT_I420_10LE, GF_PIXEL_YUV_10 },
+  { GST_VIDEO_FORMAT_I422_10LE, GF_PIXEL_YUV422_10 },
+  { GST_VIDEO_FORMAT_Y444_10LE, GF_PIXEL_YUV444_10 },
+  { GST_VIDEO_FORMAT_YUY2, GF_PIXEL_YUYV },
+  { GST_VIDEO_FORMAT_UYVY, GF_PIXEL_UYVY },
+  { GST_VIDEO_FORMAT_YVYU, GF_PIXEL_YVYU },
+  { GST_VIDEO_FORMAT_GRAY8, GF_PIXEL_GREYSCALE },
+  { GST_VIDEO_FORMAT_RGB, GF_PIXEL_RGB },
+  { GST_VIDEO_FORMAT_BGR, GF_PIXEL_BGR },
+  { GST_VIDEO_FORMAT_RGBA, GF_PIXEL_RGBA },
+  { GST_VIDEO_FORMAT_BGRA, GF_PIXEL_BGRA },
+  { GST_VIDEO_FORMAT_ARGB, GF_PIXEL_ARGB },
+  { GST_VIDEO_FORMAT_ABGR, GF_PIXEL_ABGR },
+  { GST_VIDEO_FORMAT_RGBx, GF_PIXEL_RGBX },
+  { GST_VIDEO_FORMAT_BGRx, GF_PIXEL_BGRX },
+  { GST_VIDEO_FORMAT_xRGB, GF_PIXEL_XRGB },
+  { GST_VIDEO_FORMAT_xBGR, GF_PIXEL_XBGR },
+};
+
+static const struct
+{
+  const gchar* format;
+  u32 audio_format;
+} raw_audio_formats[] = {
+  { "U8", GF_AUDIO_FMT_U8 },
+  { "S16LE", GF_AUDIO_FMT_S16 },
+  { "S16BE", GF_AUDIO_FMT_S16_BE },
+  { "S24LE", GF_AUDIO_FMT_S24 },
+  { "S32LE", GF_AUDIO_FMT_S32 },
+  { "F32LE", GF_AUDIO_FMT_FLT },
+  { "F64LE", GF_AUDIO_FMT_DBL },
+};
+
+u32
+gpac_caps_get_pixel_format(GstVideoFormat format)
+{
+  for (guint i = 0; i < G_N_ELEMENTS(raw_video_formats); i++)
+    if (raw_video_formats[i].format == format)
+      return raw_video_formats[i].pixel_format;
+  return 0;
+}
+
+u32
+gpac_caps_get_audio_format(const gchar* format)
+{
+  for (guint i = 0; i < G_N_ELEMENTS(raw_audio_formats); i++)
+    if (!g_strcmp0(raw_audio_formats[i].format, format))
+      return raw_audio_formats[i].audio_format;
+  return 0;
+}
+
+static GstVideoFormat
+gpac_caps_get_video_format(u32 pixel_format)
+{
+  for (guint i = 0; i < G_N_ELEMENTS(raw_video_formats); i++)
+    if (raw_video_formats[i].pixel_format == pixel_format)
+      return raw_video_formats[i].format;
+  return GST_VIDEO_FORMAT_UNKNOWN;
+}
+
+static const gchar*
+gpac_caps_get_audio_format_name(u32 audio_format)
+{
+  for (guint i = 0; i < G_N_ELEMENTS(raw_audio_formats); i++)
+    if (raw_audio_formats[i].audio_format == audio_format)
+      return raw_audio_formats[i].format;
+  return NULL;
+}
+
+// #MARK: PID caps
+static GstCaps*
+gpac_caps_from_file_pid(GF_FilterPid* pid)
+{
+  const GF_PropertyValue* p;
+  p = gf_filter_pid_get_property(pid, GF_PROP_PID_MIME);
+  const gchar* mime = p ? p->value.string : NULL;
+  p = gf_filter_pid_get_property(pid, GF_PROP_PID_FILE_EXT);
+  const gchar* ext = p ? p->value.string : NULL;
+
+  // Same caps as the always pad for the containers we know
+  if (!g_strcmp0(ext, "m4s") || !g_strcmp0(ext, "cmfv") ||
+      !g_strcmp0(ext, "cmfa"))
+    return gst_caps_from_string(QT_CMAF_CAPS);
+  if (!g_strcmp0(ext, "mp4") || g_str_has_suffix(mime ? mime : "", "/mp4"))
+    return gst_caps_from_string(QT_CAPS);
+  if (!g_strcmp0(mime, "video/mp2t") || !g_strcmp0(ext, "ts"))
+    return gst_caps_from_string(MPEG_TS_CAPS);
+
+  if (mime && strchr(mime, '/'))
+    return gst_caps_new_empty_simple(mime);
+  return gst_caps_new_empty_simple("application/octet-stream");
+}
+
+GstCaps*
+gpac_caps_from_pid(GF_FilterPid* pid)
+{
+  const GF_PropertyValue* p;
+  p = gf_filter_pid_get_property(pid, GF_PROP_PID_STREAM_TYPE);
+  u32 stream_type = p ? p->value.uint : GF_STREAM_UNKNOWN;
+  if (stream_type == GF_STREAM_FILE)
+    return gpac_caps_from_file_pid(pid);
+
+  p = gf_filter_pid_get_property(pid, GF_PROP_PID_DECODER_CONFIG);
+  gboolean has_dsi = p && p->value.data.size;
+  GstCaps* caps = NULL;
+
+  p = gf_filter_pid_get_property(pid, GF_PROP_PID_CODECID);
+  u32 codec_id = p ? p->value.uint : GF_CODECID_NONE;
+  switch (codec_id) {
+    case GF_CODECID_AVC:
+      caps = gst_caps_new_simple("video/x-h264",
+                                 "stream-format",
+                                 G_TYPE_STRING,
+                                 has_dsi ? "avc" : "byte-stream",
+                                 "alignment",
+                                 G_TYPE_STRING,
+                                 "au",
+                                 NULL);
+      break;
+    case GF_CODECID_HEVC:
+      caps = gst_caps_new_simple("video/x-h265",
+                                 "stream-format",
+                                 G_TYPE_STRING,
+                                 has_dsi ? "hvc1" : "byte-stream",
+                                 "alignment",
+                                 G_TYPE_STRING,
+                                 "au",
+                                 NULL);
+      break;
+    case GF_CODECID_AV1:
+      caps = gst_caps_new_simple("video/x-av1",
+                                 "stream-format",
+                                 G_TYPE_STRING,
+                                 "obu-stream",
+                                 "alignment",
+                                 G_TYPE_STRING,
+                                 "tu",
+                                 NULL);
+      break;
+    case GF_CODECID_AAC_MPEG4:
+      caps = gst_caps_new_simple("audio/mpeg",
+                                 "mpegversion",
+                                 G_TYPE_INT,
+                                 4,
+                                 "stream-format",
+                                 G_TYPE_STRING,
+                                 has_dsi ? "raw" : "adts",
+                                 NULL);
+      break;
+    case GF_CODECID_AC3:
+      caps = gst_caps_new_empty_simple("audio/x-ac3");
+      break;
+    case GF_CODECID_EAC3:
+      caps = gst_caps_new_empty_simple("audio/x-eac3");
+      break;
+    case GF_CODECID_RAW: {
+      if (stream_type == GF_STREAM_VISUAL) {
+        p = gf_filter_pid_get_property(pid, GF_PROP_PID_PIXFMT);
+        GstVideoFormat format =
+          gpac_caps_get_video_format(p ? p->value.uint : 0);
+        if (format != GST_VIDEO_FORMAT_UNKNOWN)
+          caps = gst_caps_new_simple("video/x-raw",
+                                     "format",
+                                     G_TYPE_STRING,
+                                     gst_video_format_to_string(format),
+                                     NULL);
+      } else if (stream_type == GF_STREAM_AUDIO) {
+        p = gf_filter_pid_get_property(pid, GF_PROP_PID_AUDIO_FORMAT);
+        const gchar* format =
+          gpac_caps_get_audio_format_name(p ? p->value.uint : 0);
+        if (format)
+          caps = gst_caps_new_simple("audio/x-raw",
+                                     "format",
+                                     G_TYPE_STRING,
+                                     format,
+                                     "layout",
+                                     G_TYPE_STRING,
+                                     "interleaved",
+                                     NULL);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+
+  // Anything else is only understood by another gpac element
+  if (!caps)
+    caps = gst_caps_new_simple(INTERNAL_CAPS,
+                               "codec",
+                               G_TYPE_STRING,
+                               gf_codecid_name(codec_id),
+                               NULL);
+  GstStructure* structure = gst_caps_get_structure(caps, 0);
+
+  // Fill in what the PID knows about the stream
+  if (stream_type == GF_STREAM_VISUAL) {
+    p = gf_filter_pid_get_property(pid, GF_PROP_PID_WIDTH);
+    if (p)
+      gst_structure_set(structure, "width", G_TYPE_INT, p->value.uint, NULL);
+    p = gf_filter_pid_get_property(pid, GF_PROP_PID_HEIGHT);
+    if (p)
+      gst_structure_set(structure, "height", G_TYPE_INT, p->value.uint, NULL);
+    p = gf_filter_pid_get_property(pid, GF_PROP_PID_FPS);
+    if (p && p->value.frac.den)
+      gst_structure_set(structure,
+                        "framerate",
+                        GST_TYPE_FRACTION,
+                        p->value.frac.num,
+                        p->value.frac.den,
+                        NULL);
+  } else if (stream_type == GF_STREAM_AUDIO) {
+    p = gf_filter_pid_get_property(pid, GF_PROP_PID_SAMPLE_RATE);
+    if (p)
+      gst_structure_set(structure, "rate", G_TYPE_INT, p->value.uint, NULL);
+    p = gf_filter_pid_get_property(pid, GF_PROP_PID_NUM_CHANNELS);
+    if (p)
+      gst_structure_set(
+        structure, "channels", G_TYPE_INT, p->value.uint, NULL);
+  }
+
+  p = gf_filter_pid_get_property(pid, GF_PROP_PID_DECODER_CONFIG);
+  if (p && p->value.data.size) {
+    GstBuffer* codec_data =
+      gst_buffer_new_memdup(p->value.data.ptr, p->value.data.size);
+    gst_structure_set(
+      structure, "codec_data", GST_TYPE_BUFFER, codec_data, NULL);
+    gst_buffer_unref(codec_data);
+  }
+
+  return caps;
+}
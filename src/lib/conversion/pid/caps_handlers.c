@@ -36,12 +36,11 @@
     return FALSE;                                                \
   }
 
-#define GET_MEDIA_AND_CODEC                                             \
-  GstStructure* structure = gst_caps_get_structure(priv->caps, 0);      \
-  const gchar* media_type_full = gst_structure_get_name(structure);     \
-  g_auto(GStrv) media_type_parts = g_strsplit(media_type_full, "/", 2); \
-  gchar* media = media_type_parts[0];                                   \
-  gchar* codec = media_type_parts[1];
+// The caps are parsed once per change, see gpac_pid_set_caps
+#define GET_MEDIA_AND_CODEC                    \
+  const GpacCapsInfo* info = &priv->caps_info; \
+  const gchar* media = info->media;            \
+  const gchar* codec = info->codec;
 
 //
 // Default Caps handlers
@@ -56,7 +55,7 @@ CAPS_HANDLER_SIGNATURE(stream_type)
   GET_MEDIA_AND_CODEC
 
   // Get the stream type
-  u32 stream_type = gf_stream_type_by_name(media);
+  u32 stream_type = info->stream_type;
   if (stream_type == GF_STREAM_UNKNOWN) {
     GST_ELEMENT_ERROR(
       element, LIBRARY, FAILED, (NULL), ("Unknown stream type"));
@@ -65,7 +64,7 @@ CAPS_HANDLER_SIGNATURE(stream_type)
 
   // Check the subtype
   if (!g_strcmp0(media, "video")) {
-    const gchar* subtype = gst_structure_get_string(structure, "stream-format");
+    const gchar* subtype = info->stream_format;
     if (!g_strcmp0(subtype, "avc") || !g_strcmp0(subtype, "hev1"))
       SET_PROP(GF_PROP_PID_ISOM_SUBTYPE, PROP_STRING(subtype));
   }
@@ -80,6 +79,12 @@ CAPS_HANDLER_SIGNATURE(codec_id)
   GET_MEDIA_AND_CODEC
   GF_CodecID codec_id = GF_CODECID_NONE;
 
+  // Raw streams are described by their pixel or audio format
+  if (info->is_raw) {
+    codec_id = GF_CODECID_RAW;
+    goto finish;
+  }
+
   // In most cases the substring after "x-" can be used to query the codec id
   if (g_str_has_prefix(codec, "x-")) {
     codec_id = gf_codecid_parse(codec + 2);
@@ -114,8 +119,7 @@ CAPS_HANDLER_SIGNATURE(unframed)
 {
   GET_MEDIA_AND_CODEC
 
-  const gchar* stream_format =
-    gst_structure_get_string(structure, "stream-format");
+  const gchar* stream_format = info->stream_format;
 
   // Check if the stream is framed
   gboolean framed = TRUE;
@@ -126,7 +130,7 @@ CAPS_HANDLER_SIGNATURE(unframed)
         framed = FALSE;
     }
   } else if (!g_strcmp0(media, "audio")) {
-    gst_structure_get_boolean(structure, "framed", &framed);
+    framed = info->framed;
   }
 
   //* For AVC, HEVC, AV1, etc. our caps always ask for streams with start codes.
@@ -155,8 +159,7 @@ CAPS_HANDLER_SIGNATURE(width)
   if (g_strcmp0(media, "video"))
     return TRUE;
 
-  gint width = -1;
-  gst_structure_get_int(structure, "width", &width);
+  gint width = info->width;
   if (width <= 0) {
     GST_ELEMENT_ERROR(element, LIBRARY, FAILED, (NULL), ("Invalid width"));
     return FALSE;
@@ -175,8 +178,7 @@ CAPS_HANDLER_SIGNATURE(height)
   if (g_strcmp0(media, "video"))
     return TRUE;
 
-  gint height = -1;
-  gst_structure_get_int(structure, "height", &height);
+  gint height = info->height;
   if (height <= 0) {
     GST_ELEMENT_ERROR(element, LIBRARY, FAILED, (NULL), ("Invalid height"));
     return FALSE;
@@ -187,6 +189,55 @@ CAPS_HANDLER_SIGNATURE(height)
   return TRUE;
 }
 
+CAPS_HANDLER_SIGNATURE(pixel_format)
+{
+  GET_MEDIA_AND_CODEC
+
+  // Only process raw video
+  if (!info->is_raw || g_strcmp0(media, "video"))
+    return TRUE;
+
+  u32 pixel_format =
+    gpac_caps_get_pixel_format(GST_VIDEO_INFO_FORMAT(&info->video_info));
+  if (!pixel_format) {
+    GST_ELEMENT_ERROR(
+      element, LIBRARY, FAILED, (NULL), ("Unsupported raw video format"));
+    return FALSE;
+  }
+
+  // Set the pixel format property
+  SET_PROP(GF_PROP_PID_PIXFMT, PROP_UINT(pixel_format));
+  return TRUE;
+}
+
+CAPS_HANDLER_SIGNATURE(stride)
+{
+  GET_MEDIA_AND_CODEC
+
+  // Only process raw video
+  if (!info->is_raw || g_strcmp0(media, "video"))
+    return TRUE;
+
+  // Frames with another layout are shared plane by plane
+  gint stride = GST_VIDEO_INFO_PLANE_STRIDE(&info->video_info, 0);
+  SET_PROP(GF_PROP_PID_STRIDE, PROP_UINT(stride));
+  return TRUE;
+}
+
+CAPS_HANDLER_SIGNATURE(stride_uv)
+{
+  GET_MEDIA_AND_CODEC
+
+  // Only process planar raw video
+  if (!info->is_raw || g_strcmp0(media, "video") ||
+      GST_VIDEO_INFO_N_PLANES(&info->video_info) < 2)
+    return TRUE;
+
+  gint stride_uv = GST_VIDEO_INFO_PLANE_STRIDE(&info->video_info, 1);
+  SET_PROP(GF_PROP_PID_STRIDE_UV, PROP_UINT(stride_uv));
+  return TRUE;
+}
+
 CAPS_HANDLER_SIGNATURE(sample_rate)
 {
   GET_MEDIA_AND_CODEC
@@ -195,8 +246,7 @@ CAPS_HANDLER_SIGNATURE(sample_rate)
   if (g_strcmp0(media, "audio"))
     return TRUE;
 
-  gint rate = -1;
-  gst_structure_get_int(structure, "rate", &rate);
+  gint rate = info->rate;
   if (rate <= 0) {
     GST_ELEMENT_ERROR(
       element, LIBRARY, FAILED, (NULL), ("Invalid sample rate"));
@@ -216,8 +266,7 @@ CAPS_HANDLER_SIGNATURE(fps)
   if (g_strcmp0(media, "video"))
     return TRUE;
 
-  gint num = -1, denom = -1;
-  gst_structure_get_fraction(structure, "framerate", &num, &denom);
+  gint num = info->fps_num, denom = info->fps_den;
   if (num < 0 || denom < 0)
     return FALSE;
 
@@ -266,26 +315,42 @@ CAPS_HANDLER_SIGNATURE(num_channels)
   if (g_strcmp0(media, "audio"))
     return TRUE;
 
-  gint channels = -1;
-  gst_structure_get_int(structure, "channels", &channels);
+  gint channels = info->channels;
 
   // Set the number of channels property
   SET_PROP(GF_PROP_PID_NUM_CHANNELS, PROP_UINT(channels));
   return TRUE;
 }
 
+CAPS_HANDLER_SIGNATURE(audio_format)
+{
+  GET_MEDIA_AND_CODEC
+
+  // Only process raw audio
+  if (!info->is_raw || g_strcmp0(media, "audio"))
+    return TRUE;
+
+  u32 audio_format = gpac_caps_get_audio_format(info->audio_format);
+  if (!audio_format) {
+    GST_ELEMENT_ERROR(
+      element, LIBRARY, FAILED, (NULL), ("Unsupported raw audio format"));
+    return FALSE;
+  }
+
+  // Set the audio format property
+  SET_PROP(GF_PROP_PID_AUDIO_FORMAT, PROP_UINT(audio_format));
+  return TRUE;
+}
+
 CAPS_HANDLER_SIGNATURE(decoder_config)
 {
   SKIP_IF_SET(GF_PROP_PID_DECODER_CONFIG);
 
-  GstStructure* structure = gst_caps_get_structure(priv->caps, 0);
-
   // Get the codec data
-  const GValue* codec_data = gst_structure_get_value(structure, "codec_data");
-  if (!GST_VALUE_HOLDS_BUFFER(codec_data))
+  GstBuffer* buffer = priv->caps_info.codec_data;
+  if (!buffer)
     return TRUE;
 
-  GstBuffer* buffer = gst_value_get_buffer(codec_data);
   g_auto(GstBufferMapInfo) map = GST_MAP_INFO_INIT;
   if (!gst_buffer_map(buffer, &map, GST_MAP_READ)) {
     GST_ELEMENT_ERROR(
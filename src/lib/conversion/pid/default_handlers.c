@@ -55,6 +55,10 @@ DEFAULT_HANDLER_MANDATORY(unframed, GF_PROP_PID_UNFRAMED)
 // Following are optional
 DEFAULT_HANDLER(width)
 DEFAULT_HANDLER(height)
+DEFAULT_HANDLER(pixel_format)
+DEFAULT_HANDLER(stride)
+DEFAULT_HANDLER(stride_uv)
+DEFAULT_HANDLER(audio_format)
 DEFAULT_HANDLER(bitrate)
 DEFAULT_HANDLER(max_bitrate)
 DEFAULT_HANDLER(decoder_config)
@@ -47,18 +47,21 @@ QUERY_HANDLER_SIGNATURE(duration)
 {
   const GF_PropertyValue* p;
 
-  // Query the duration
-  g_autoptr(GstQuery) query = gst_query_new_duration(GST_FORMAT_TIME);
-  gboolean ret = gst_pad_peer_query(priv->self, query);
-  if (!ret) {
-    GST_ELEMENT_ERROR(
-      priv->self, LIBRARY, FAILED, (NULL), ("Failed to query duration"));
-    return FALSE;
-  }
+  // Query the duration, once until the caps or segment change
+  if (!priv->duration_queried) {
+    g_autoptr(GstQuery) query = gst_query_new_duration(GST_FORMAT_TIME);
+    gboolean ret = gst_pad_peer_query(priv->self, query);
+    if (!ret) {
+      GST_ELEMENT_ERROR(
+        priv->self, LIBRARY, FAILED, (NULL), ("Failed to query duration"));
+      return FALSE;
+    }
 
-  // Parse the duration
-  gint64 duration;
-  gst_query_parse_duration(query, NULL, &duration);
+    // Parse the duration
+    gst_query_parse_duration(query, NULL, &priv->duration);
+    priv->duration_queried = TRUE;
+  }
+  gint64 duration = priv->duration;
 
   // Get the fps from the PID
   GF_Fraction fps = { 30, 1 };
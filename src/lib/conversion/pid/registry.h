@@ -131,6 +131,9 @@ GPAC_PROP_IMPL_DECL_BUNDLE_CAPS(unframed)
 
 GPAC_PROP_IMPL_DECL_BUNDLE_CAPS(width)
 GPAC_PROP_IMPL_DECL_BUNDLE_CAPS(height)
+GPAC_PROP_IMPL_DECL_BUNDLE_CAPS(pixel_format)
+GPAC_PROP_IMPL_DECL_BUNDLE_CAPS(stride)
+GPAC_PROP_IMPL_DECL_BUNDLE_CAPS(stride_uv)
 
 GPAC_PROP_IMPL_DECL_BUNDLE_TAGS(dbsize)
 GPAC_PROP_IMPL_DECL_BUNDLE_TAGS(bitrate)
@@ -142,6 +145,7 @@ GPAC_PROP_IMPL_DECL_BUNDLE_CAPS(sample_rate)
 GPAC_PROP_IMPL_DECL_BUNDLE_CAPS(fps)
 
 GPAC_PROP_IMPL_DECL_BUNDLE_CAPS(num_channels)
+GPAC_PROP_IMPL_DECL_BUNDLE_CAPS(audio_format)
 GPAC_PROP_IMPL_DECL_BUNDLE_TAGS(language)
 
 GPAC_PROP_IMPL_DECL_BUNDLE_CAPS(decoder_config)
@@ -168,6 +172,9 @@ static prop_registry_entry prop_registry[] = {
 
   GPAC_PROP_DEFINE_CAPS(GF_PROP_PID_WIDTH, width),
   GPAC_PROP_DEFINE_CAPS(GF_PROP_PID_HEIGHT, height),
+  GPAC_PROP_DEFINE_CAPS(GF_PROP_PID_PIXFMT, pixel_format),
+  GPAC_PROP_DEFINE_CAPS(GF_PROP_PID_STRIDE, stride),
+  GPAC_PROP_DEFINE_CAPS(GF_PROP_PID_STRIDE_UV, stride_uv),
 
   GPAC_PROP_DEFINE_TAGS(GF_PROP_PID_DBSIZE, dbsize),
   GPAC_PROP_DEFINE_TAGS(GF_PROP_PID_BITRATE, bitrate),
@@ -180,6 +187,7 @@ static prop_registry_entry prop_registry[] = {
   GPAC_PROP_DEFINE_ALL(GF_PROP_PID_DURATION, duration),
 
   GPAC_PROP_DEFINE_CAPS(GF_PROP_PID_NUM_CHANNELS, num_channels),
+  GPAC_PROP_DEFINE_CAPS(GF_PROP_PID_AUDIO_FORMAT, audio_format),
   GPAC_PROP_DEFINE_TAGS(GF_PROP_PID_LANGUAGE, language),
 
   GPAC_PROP_DEFINE_CAPS(GF_PROP_PID_DECODER_CONFIG, decoder_config),
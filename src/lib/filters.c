@@ -0,0 +1,293 @@
+/*
+ *			GPAC - Multimedia Framework C SDK
+ *
+ *			Authors: Deniz Ugur, Romain Bouqueau, Sohaib Larbi
+ *			Copyright (c) Motion Spell
+ *				All rights reserved
+ *
+ *  This file is part of the GPAC/GStreamer wrapper
+ *
+ *  This GPAC/GStreamer wrapper is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Affero General Public License
+ *  as published by the Free Software Foundation; either version 3, or (at
+ *  your option) any later version.
+ *
+ *  This GPAC/GStreamer wrapper is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public
+ *  License along with this library; see the file LICENSE.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+#include "lib/filters.h"
+#include "config.h"
+
+#include <glib/gstdio.h>
+#include <gpac/config_file.h>
+#ifdef G_OS_UNIX
+#include <dlfcn.h>
+#endif
+
+// (list separator, [(filter name, [(name, desc, default, enum, type, flags)])])
+#define GPAC_FILTERS_ARG_TYPE "(smsmsmsuu)"
+#define GPAC_FILTERS_FILTER_TYPE "(sa" GPAC_FILTERS_ARG_TYPE ")"
+#define GPAC_FILTERS_INDEX_TYPE "(ya" GPAC_FILTERS_FILTER_TYPE ")"
+
+static GHashTable* filters_index = NULL;
+static gchar filters_list_sep = ',';
+
+// #MARK: Cache
+static gchar*
+gpac_filters_cache_path(void)
+{
+  const gchar* env = g_getenv(GPAC_FILTERS_CACHE_ENV);
+  if (!g_strcmp0(env, "0"))
+    return NULL;
+
+  // Anything that may change the filters must change the file name
+  gchar* key = g_strdup_printf(
+    "filters-%s-gpac-%s.cache", VERSION, gf_gpac_full_version());
+  g_strcanon(key,
+             "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789.-",
+             '_');
+
+  gchar* path = NULL;
+  if (env && *env)
+    path = g_build_filename(env, key, NULL);
+  else
+    path = g_build_filename(g_get_user_cache_dir(), PACKAGE, key, NULL);
+  g_free(key);
+  return path;
+}
+
+static gint64
+gpac_filters_mtime(const gchar* path)
+{
+  GStatBuf st;
+  return g_stat(path, &st) == 0 ? (gint64)st.st_mtime : 0;
+}
+
+// Last time libgpac or its modules were installed, 0 if unknown
+static gint64
+gpac_filters_install_mtime(void)
+{
+  gint64 mtime = 0;
+#ifdef G_OS_UNIX
+  Dl_info info;
+  if (dladdr((gpointer)gf_gpac_full_version, &info) && info.dli_fname)
+    mtime = gpac_filters_mtime(info.dli_fname);
+#endif
+
+  // Modules are added, removed or rebuilt without touching libgpac
+  const gchar* mod_dir = gf_opts_get_key("core", "module-dir");
+  GDir* dir = mod_dir ? g_dir_open(mod_dir, 0, NULL) : NULL;
+  if (dir) {
+    mtime = MAX(mtime, gpac_filters_mtime(mod_dir));
+    const gchar* name;
+    while ((name = g_dir_read_name(dir))) {
+      gchar* file = g_build_filename(mod_dir, name, NULL);
+      mtime = MAX(mtime, gpac_filters_mtime(file));
+      g_free(file);
+    }
+    g_dir_close(dir);
+  }
+  return mtime;
+}
+
+static GVariant*
+gpac_filters_cache_load(const gchar* path)
+{
+  // A cache older than the installation may list stale filters
+  gint64 mtime = gpac_filters_mtime(path);
+  if (!mtime || mtime < gpac_filters_install_mtime())
+    return NULL;
+
+  GMappedFile* file = g_mapped_file_new(path, FALSE, NULL);
+  if (!file)
+    return NULL;
+
+  GBytes* bytes = g_mapped_file_get_bytes(file);
+  g_mapped_file_unref(file);
+  GVariant* index = g_variant_ref_sink(g_variant_new_from_bytes(
+    G_VARIANT_TYPE(GPAC_FILTERS_INDEX_TYPE), bytes, FALSE));
+  g_bytes_unref(bytes);
+
+  // Don't trust a truncated or foreign file
+  if (!g_variant_is_normal_form(index)) {
+    g_variant_unref(index);
+    return NULL;
+  }
+  return index;
+}
+
+static void
+gpac_filters_cache_save(const gchar* path, GBytes* bytes)
+{
+  gchar* dir = g_path_get_dirname(path);
+  if (g_mkdir_with_parents(dir, 0755) == 0) {
+    gsize size;
+    gconstpointer data = g_bytes_get_data(bytes, &size);
+    // Written to a temporary file first, concurrent scans are safe
+    g_file_set_contents(path, data, (gssize)size, NULL);
+  }
+  g_free(dir);
+}
+
+// #MARK: Index
+static GVariant*
+gpac_filters_collect(void)
+{
+  GF_FilterSession* session = gf_fs_new_defaults(0U);
+
+  // Get the list separator
+  GF_Err e;
+  GF_Filter* dummy = gf_fs_new_filter(session, "dummy", 0, &e);
+  guint8 sep_list = dummy ? (guint8)gf_filter_get_sep(dummy, GF_FS_SEP_LIST)
+                          : (guint8)filters_list_sep;
+
+  GVariantBuilder filters;
+  g_variant_builder_init(&filters,
+                         G_VARIANT_TYPE("a" GPAC_FILTERS_FILTER_TYPE));
+  guint num_filters = gf_fs_filters_registers_count(session);
+  for (guint i = 0; i < num_filters; i++) {
+    const GF_FilterRegister* filter = gf_fs_get_filter_register(session, i);
+    if (!filter || !filter->name)
+      continue;
+
+    GVariantBuilder args;
+    g_variant_builder_init(&args, G_VARIANT_TYPE("a" GPAC_FILTERS_ARG_TYPE));
+    for (guint j = 0; filter->args && filter->args[j].arg_name; j++) {
+      const GF_FilterArgs* arg = &filter->args[j];
+      g_variant_builder_add(&args,
+                            GPAC_FILTERS_ARG_TYPE,
+                            arg->arg_name,
+                            arg->arg_desc,
+                            arg->arg_default_val,
+                            arg->min_max_enum,
+                            (guint32)arg->arg_type,
+                            (guint32)arg->flags);
+    }
+    g_variant_builder_add(
+      &filters, GPAC_FILTERS_FILTER_TYPE, filter->name, &args);
+  }
+  gf_fs_del(session);
+
+  return g_variant_ref_sink(
+    g_variant_new(GPAC_FILTERS_INDEX_TYPE, sep_list, &filters));
+}
+
+static const gchar*
+gpac_filters_get_maybe_string(GVariant* tuple, gsize idx)
+{
+  // The string lives in the serialized data of the index, not in the child
+  GVariant* maybe = g_variant_get_child_value(tuple, idx);
+  GVariant* value = g_variant_get_maybe(maybe);
+  const gchar* str = value ? g_variant_get_string(value, NULL) : NULL;
+  if (value)
+    g_variant_unref(value);
+  g_variant_unref(maybe);
+  return str;
+}
+
+static GHashTable*
+gpac_filters_build_index(GVariant* index)
+{
+  GHashTable* table = g_hash_table_new(g_str_hash, g_str_equal);
+
+  GVariant* sep = g_variant_get_child_value(index, 0);
+  filters_list_sep = (gchar)g_variant_get_byte(sep);
+  g_variant_unref(sep);
+
+  GVariant* filters = g_variant_get_child_value(index, 1);
+  gsize num_filters = g_variant_n_children(filters);
+  for (gsize i = 0; i < num_filters; i++) {
+    GVariant* filter = g_variant_get_child_value(filters, i);
+    GVariant* name = g_variant_get_child_value(filter, 0);
+    GVariant* args = g_variant_get_child_value(filter, 1);
+
+    GPAC_FilterInfo* info = g_new0(GPAC_FilterInfo, 1);
+    info->name = g_variant_get_string(name, NULL);
+    info->n_args = g_variant_n_children(args);
+    info->args = g_new0(GPAC_FilterArg, info->n_args);
+    for (guint j = 0; j < info->n_args; j++) {
+      GVariant* arg = g_variant_get_child_value(args, j);
+      GVariant* arg_name = g_variant_get_child_value(arg, 0);
+      GVariant* type = g_variant_get_child_value(arg, 4);
+      GVariant* flags = g_variant_get_child_value(arg, 5);
+
+      info->args[j].name = g_variant_get_string(arg_name, NULL);
+      info->args[j].desc = gpac_filters_get_maybe_string(arg, 1);
+      info->args[j].default_val = gpac_filters_get_maybe_string(arg, 2);
+      info->args[j].min_max_enum = gpac_filters_get_maybe_string(arg, 3);
+      info->args[j].type = g_variant_get_uint32(type);
+      info->args[j].flags = g_variant_get_uint32(flags);
+
+      g_variant_unref(flags);
+      g_variant_unref(type);
+      g_variant_unref(arg_name);
+      g_variant_unref(arg);
+    }
+
+    // The first register wins, like in a filter session
+    if (!g_hash_table_contains(table, info->name))
+      g_hash_table_insert(table, (gpointer)info->name, info);
+
+    g_variant_unref(args);
+    g_variant_unref(name);
+    g_variant_unref(filter);
+  }
+  g_variant_unref(filters);
+  return table;
+}
+
+static gpointer
+gpac_filters_init(gpointer data)
+{
+  gchar* path = gpac_filters_cache_path();
+  GVariant* index = path ? gpac_filters_cache_load(path) : NULL;
+
+  if (!index) {
+    // Work on the serialized form, exactly like a loaded cache
+    GVariant* collected = gpac_filters_collect();
+    GBytes* bytes = g_variant_get_data_as_bytes(collected);
+    g_variant_unref(collected);
+
+    index = g_variant_ref_sink(g_variant_new_from_bytes(
+      G_VARIANT_TYPE(GPAC_FILTERS_INDEX_TYPE), bytes, TRUE));
+    if (path)
+      gpac_filters_cache_save(path, bytes);
+    g_bytes_unref(bytes);
+  }
+  g_free(path);
+
+  // The index keeps pointers into the data, so it is never released
+  filters_index = gpac_filters_build_index(index);
+  return index;
+}
+
+static void
+gpac_filters_ensure(void)
+{
+  static GOnce once = G_ONCE_INIT;
+  g_once(&once, gpac_filters_init, NULL);
+}
+
+const GPAC_FilterInfo*
+gpac_filters_lookup(const gchar* filter_name)
+{
+  gpac_filters_ensure();
+  return g_hash_table_lookup(filters_index, filter_name);
+}
+
+gchar
+gpac_filters_get_list_sep(void)
+{
+  gpac_filters_ensure();
+  return filters_list_sep;
+}
@@ -0,0 +1,194 @@
+/*
+ *			GPAC - Multimedia Framework C SDK
+ *
+ *			Authors: Deniz Ugur, Romain Bouqueau, Sohaib Larbi
+ *			Copyright (c) Motion Spell
+ *				All rights reserved
+ *
+ *  This file is part of the GPAC/GStreamer wrapper
+ *
+ *  This GPAC/GStreamer wrapper is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Affero General Public License
+ *  as published by the Free Software Foundation; either version 3, or (at
+ *  your option) any later version.
+ *
+ *  This GPAC/GStreamer wrapper is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public
+ *  License along with this library; see the file LICENSE.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include "lib/level.h"
+
+void
+gpac_queue_level_init(GPAC_QueueLevel* level)
+{
+  g_mutex_init(&level->lock);
+  g_cond_init(&level->cond);
+  gpac_queue_level_reset(level);
+}
+
+void
+gpac_queue_level_clear(GPAC_QueueLevel* level)
+{
+  g_cond_clear(&level->cond);
+  g_mutex_clear(&level->lock);
+}
+
+void
+gpac_queue_level_reset(GPAC_QueueLevel* level)
+{
+  g_mutex_lock(&level->lock);
+  level->bytes = 0;
+  level->buffers = 0;
+  level->in_time = GST_CLOCK_TIME_NONE;
+  level->out_time = GST_CLOCK_TIME_NONE;
+  g_mutex_unlock(&level->lock);
+}
+
+void
+gpac_queue_level_hold(GPAC_QueueLevel* level, gsize size)
+{
+  g_mutex_lock(&level->lock);
+  level->bytes += size;
+  level->buffers++;
+  g_mutex_unlock(&level->lock);
+}
+
+void
+gpac_queue_level_release(GPAC_QueueLevel* level, gsize size)
+{
+  g_mutex_lock(&level->lock);
+  level->bytes -= MIN(level->bytes, size);
+  if (level->buffers)
+    level->buffers--;
+  g_cond_signal(&level->cond);
+  g_mutex_unlock(&level->lock);
+}
+
+void
+gpac_queue_level_update_input(GPAC_QueueLevel* level,
+                              GstClockTime running_time)
+{
+  if (!GST_CLOCK_TIME_IS_VALID(running_time))
+    return;
+
+  g_mutex_lock(&level->lock);
+  if (!GST_CLOCK_TIME_IS_VALID(level->in_time) ||
+      running_time > level->in_time)
+    level->in_time = running_time;
+
+  // Nothing came out yet, count from the first input
+  if (!GST_CLOCK_TIME_IS_VALID(level->out_time))
+    level->out_time = running_time;
+  g_mutex_unlock(&level->lock);
+}
+
+void
+gpac_queue_level_update_output(GPAC_QueueLevel* level,
+                               GstClockTime running_time)
+{
+  if (!GST_CLOCK_TIME_IS_VALID(running_time))
+    return;
+
+  g_mutex_lock(&level->lock);
+  if (!GST_CLOCK_TIME_IS_VALID(level->out_time) ||
+      running_time > level->out_time)
+    level->out_time = running_time;
+  g_mutex_unlock(&level->lock);
+}
+
+guint64
+gpac_queue_level_get_bytes(GPAC_QueueLevel* level)
+{
+  g_mutex_lock(&level->lock);
+  guint64 bytes = level->bytes;
+  g_mutex_unlock(&level->lock);
+  return bytes;
+}
+
+static GstClockTime
+gpac_queue_level_get_time_unlocked(GPAC_QueueLevel* level)
+{
+  GstClockTime in_time = level->in_time;
+  GstClockTime out_time = level->out_time;
+  if (!GST_CLOCK_TIME_IS_VALID(in_time) || !GST_CLOCK_TIME_IS_VALID(out_time))
+    return 0;
+  return in_time > out_time ? in_time - out_time : 0;
+}
+
+GstClockTime
+gpac_queue_level_get_time(GPAC_QueueLevel* level)
+{
+  g_mutex_lock(&level->lock);
+  GstClockTime time = gpac_queue_level_get_time_unlocked(level);
+  g_mutex_unlock(&level->lock);
+  return time;
+}
+
+static gboolean
+gpac_queue_level_is_full_unlocked(GPAC_QueueLevel* level)
+{
+  if (level->max_bytes && level->bytes >= level->max_bytes)
+    return TRUE;
+  if (level->max_time &&
+      gpac_queue_level_get_time_unlocked(level) >= level->max_time)
+    return TRUE;
+  return FALSE;
+}
+
+gboolean
+gpac_queue_level_is_full(GPAC_QueueLevel* level)
+{
+  if (!level->max_bytes && !level->max_time)
+    return FALSE;
+
+  g_mutex_lock(&level->lock);
+  gboolean full = gpac_queue_level_is_full_unlocked(level);
+  g_mutex_unlock(&level->lock);
+  return full;
+}
+
+gboolean
+gpac_queue_level_wait(GPAC_QueueLevel* level, gint64 timeout)
+{
+  gint64 end_time = g_get_monotonic_time() + timeout;
+
+  // Only the byte level changes while waiting, the times are updated from
+  // the streaming thread that waits
+  g_mutex_lock(&level->lock);
+  while (gpac_queue_level_is_full_unlocked(level)) {
+    if (!g_cond_wait_until(&level->cond, &level->lock, end_time))
+      break;
+  }
+  gboolean full = gpac_queue_level_is_full_unlocked(level);
+  g_mutex_unlock(&level->lock);
+  return !full;
+}
+
+GstStructure*
+gpac_queue_level_to_structure(GPAC_QueueLevel* level)
+{
+  g_mutex_lock(&level->lock);
+  guint64 bytes = level->bytes;
+  guint buffers = level->buffers;
+  GstClockTime time = gpac_queue_level_get_time_unlocked(level);
+  g_mutex_unlock(&level->lock);
+
+  return gst_structure_new("queue-level",
+                           "bytes",
+                           G_TYPE_UINT64,
+                           bytes,
+                           "buffers",
+                           G_TYPE_UINT,
+                           buffers,
+                           "time",
+                           G_TYPE_UINT64,
+                           time,
+                           NULL);
+}
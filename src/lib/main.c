@@ -26,6 +26,91 @@
 #include "lib/main.h"
 #include "gpacmessages.h"
 
+// #MARK: Logging
+static GstDebugCategory* gpac_log_cat = NULL;
+static GstDebugCategory* gpac_log_tool_cats[GF_LOG_TOOL_MAX];
+static gint gpac_log_tool_thresholds[GF_LOG_TOOL_MAX];
+
+static void
+gpac_log_init_categories(void)
+{
+  static gsize initialized = 0;
+  if (!g_once_init_enter(&initialized))
+    return;
+
+  /* Define a custom log category for GPAC */
+  gpac_log_cat = _gst_debug_get_category("gpac");
+  if (gpac_log_cat == NULL)
+    gpac_log_cat =
+      _gst_debug_category_new("gpac", 0, "GPAC GStreamer integration");
+
+  /* And one sub-category per GPAC log tool, e.g. "gpac:container" */
+  for (guint tool = 0; tool < GF_LOG_TOOL_MAX; tool++) {
+    const char* tool_name = gf_log_tool_name((GF_LOG_Tool)tool);
+    gpac_log_tool_thresholds[tool] = -1;
+    if (!tool_name) {
+      gpac_log_tool_cats[tool] = gpac_log_cat;
+      continue;
+    }
+
+    g_autofree gchar* name = g_strdup_printf("gpac:%s", tool_name);
+    g_autofree gchar* desc = g_strdup_printf("GPAC %s log tool", tool_name);
+    gpac_log_tool_cats[tool] = _gst_debug_get_category(name);
+    if (gpac_log_tool_cats[tool] == NULL)
+      gpac_log_tool_cats[tool] = _gst_debug_category_new(name, 0, desc);
+  }
+
+  g_once_init_leave(&initialized, 1);
+}
+
+static GstDebugLevel
+gpac_log_get_threshold(GF_LOG_Tool log_tool)
+{
+  GstDebugLevel parent = gst_debug_category_get_threshold(gpac_log_cat);
+  if (log_tool >= GF_LOG_TOOL_MAX)
+    return parent;
+
+  // A tool is as verbose as the most verbose of "gpac" and "gpac:<tool>"
+  GstDebugLevel tool =
+    gst_debug_category_get_threshold(gpac_log_tool_cats[log_tool]);
+  return MAX(parent, tool);
+}
+
+static GF_LOG_Level
+gpac_log_level_from_gst(GstDebugLevel level)
+{
+  switch (level) {
+    case GST_LEVEL_NONE:
+      return GF_LOG_QUIET;
+    case GST_LEVEL_ERROR:
+      return GF_LOG_ERROR;
+    case GST_LEVEL_WARNING:
+      return GF_LOG_WARNING;
+    case GST_LEVEL_FIXME:
+    case GST_LEVEL_INFO:
+      return GF_LOG_INFO;
+    default:
+      return GF_LOG_DEBUG;
+  }
+}
+
+static GstDebugLevel
+gpac_log_level_to_gst(GF_LOG_Level level)
+{
+  switch (level) {
+    case GF_LOG_ERROR:
+      return GST_LEVEL_ERROR;
+    case GF_LOG_WARNING:
+      return GST_LEVEL_WARNING;
+    case GF_LOG_INFO:
+      return GST_LEVEL_INFO;
+    case GF_LOG_DEBUG:
+      return GST_LEVEL_DEBUG;
+    default:
+      return GST_LEVEL_LOG;
+  }
+}
+
 static void
 gpac_log_callback(void* cbck,
                   GF_LOG_Level log_level,
@@ -33,49 +118,58 @@ gpac_log_callback(void* cbck,
                   const char* fmt,
                   va_list vlist)
 {
-  /* Define a custom log category for GPAC */
-  static GstDebugCategory* gpac_cat = NULL;
-  if (G_UNLIKELY(gpac_cat == NULL)) {
-    gpac_cat = _gst_debug_get_category("gpac");
-    if (gpac_cat == NULL) {
-      gpac_cat =
-        _gst_debug_category_new("gpac", 0, "GPAC GStreamer integration");
-    }
-  }
-
   GstElement* element = (GstElement*)cbck;
 
+  // Drop the message before formatting it if nobody is going to see it
+  GstDebugLevel level = gpac_log_level_to_gst(log_level);
+  if (level > gpac_log_get_threshold(log_tool))
+    return;
+
+  GstDebugCategory* cat = log_tool < GF_LOG_TOOL_MAX
+                            ? gpac_log_tool_cats[log_tool]
+                            : gpac_log_cat;
+
   char msg[1024];
   vsnprintf(msg, sizeof(msg), fmt, vlist);
   size_t len = strlen(msg);
   if (len > 0 && msg[len - 1] == '\n')
     msg[len - 1] = '\0';
 
-  switch (log_level) {
-    case GF_LOG_ERROR:
-      GST_CAT_ERROR_OBJECT(gpac_cat, element, "%s", msg);
-      break;
-    case GF_LOG_WARNING:
-      GST_CAT_WARNING_OBJECT(gpac_cat, element, "%s", msg);
-      break;
-    case GF_LOG_INFO:
-      GST_CAT_INFO_OBJECT(gpac_cat, element, "%s", msg);
-      break;
-    case GF_LOG_DEBUG:
-      GST_CAT_DEBUG_OBJECT(gpac_cat, element, "%s", msg);
-      break;
-    default:
-      GST_CAT_LOG_OBJECT(gpac_cat, element, "%s", msg);
-      break;
+  // The threshold was already checked above, so log unconditionally
+  gst_debug_log(cat,
+                level,
+                __FILE__,
+                GST_FUNCTION,
+                __LINE__,
+                element ? G_OBJECT(element) : NULL,
+                "%s",
+                msg);
+}
+
+void
+gpac_log_sync_levels(gboolean force)
+{
+  gpac_log_init_categories();
+
+  for (guint tool = 0; tool < GF_LOG_TOOL_MAX; tool++) {
+    GstDebugLevel threshold = gpac_log_get_threshold((GF_LOG_Tool)tool);
+    if (!force && g_atomic_int_get(&gpac_log_tool_thresholds[tool]) ==
+                    (gint)threshold)
+      continue;
+
+    g_atomic_int_set(&gpac_log_tool_thresholds[tool], (gint)threshold);
+    gf_log_set_tool_level((GF_LOG_Tool)tool,
+                          gpac_log_level_from_gst(threshold));
   }
 }
 
+// #MARK: Context
 gboolean
 gpac_init(GPAC_Context* ctx, GstElement* element)
 {
   gpac_return_val_if_fail(gf_sys_init(GF_MemTrackerNone, NULL), FALSE);
   gf_log_set_callback(element, gpac_log_callback);
-  gf_log_set_tools_levels("all@debug", GF_TRUE);
+  gpac_log_sync_levels(TRUE);
   return TRUE;
 }
 
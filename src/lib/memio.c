@@ -29,6 +29,7 @@
 #include "lib/pid.h"
 #include "post-process/common.h"
 #include "post-process/registry.h"
+#include "utils.h"
 #include <gst/video/video-event.h>
 
 static GF_Err
@@ -84,8 +85,9 @@ GF_FilterRegister MemOutRegister = {
   .private_size = sizeof(GPAC_MemOutPrivateContext),
   .max_extra_pids = -1,
   .priority = -1,
-  .flags =
-    GF_FS_REG_FORCE_REMUX | GF_FS_REG_TEMP_INIT | GF_FS_REG_EXPLICIT_ONLY,
+  // Runs on the calling thread, post-processed output is consumed from there
+  .flags = GF_FS_REG_FORCE_REMUX | GF_FS_REG_TEMP_INIT |
+           GF_FS_REG_EXPLICIT_ONLY | GF_FS_REG_MAIN_THREAD,
   .caps = DefaultMemOutCaps,
   .nb_caps = G_N_ELEMENTS(DefaultMemOutCaps),
   .initialize = gpac_default_memout_initialize_cb,
@@ -103,7 +105,9 @@ gpac_memio_new(GPAC_SessionContext* sess, GPAC_MemIoDirection dir)
   GF_Filter* memio = NULL;
 
   if (dir == GPAC_MEMIO_DIR_IN) {
-    memio = sess->memin = gf_fs_new_filter(sess->session, "memin", 0, &e);
+    // Keep memin on the calling thread, the element feeds it from there
+    memio = sess->memin =
+      gf_fs_new_filter(sess->session, "memin", GF_FS_REG_MAIN_THREAD, &e);
     if (!sess->memin) {
       GST_ELEMENT_ERROR(sess->element,
                         LIBRARY,
@@ -182,6 +186,10 @@ gpac_memio_new(GPAC_SessionContext* sess, GPAC_MemIoDirection dir)
     return GF_OUT_OF_MEM;
   }
   gpac_return_if_fail(gf_filter_set_rt_udta(memio, rt_udta));
+  if (dir == GPAC_MEMIO_DIR_IN) {
+    rt_udta->ring = gpac_ring_new(GPAC_MEMIO_RING_CAPACITY);
+    rt_udta->refs = gpac_pck_refs_new();
+  }
   rt_udta->dir = dir;
   rt_udta->global_offset = GST_CLOCK_TIME_NONE;
   rt_udta->sess = sess;
@@ -192,29 +200,77 @@ gpac_memio_new(GPAC_SessionContext* sess, GPAC_MemIoDirection dir)
 void
 gpac_memio_free(GPAC_SessionContext* sess)
 {
-  if (sess->memin)
-    gf_free(gf_filter_get_rt_udta(sess->memin));
+  if (sess->memin) {
+    GPAC_MemIoContext* rt_udta = gf_filter_get_rt_udta(sess->memin);
+    if (rt_udta) {
+      // Packets that were never sent are destroyed with the ring
+      gpac_ring_free(rt_udta->ring, (GDestroyNotify)gf_filter_pck_discard);
+      // Packets destroyed with the session no longer find their records
+      gf_filter_set_rt_udta(sess->memin, NULL);
+      gpac_pck_refs_free(rt_udta->refs);
+      g_free(rt_udta);
+    }
+  }
+
+  if (sess->memout) {
+    // Buffers held downstream must not reach the PIDs from now on
+    for (u32 i = 0; i < gf_filter_get_ipid_count(sess->memout); i++) {
+      GF_FilterPid* ipid = gf_filter_get_ipid(sess->memout, i);
+      GPAC_MemOutPIDContext* pctx = gf_filter_pid_get_udta(ipid);
+      if (pctx) {
+        gpac_pck_source_detach(pctx->source);
+        gst_clear_object(&pctx->src_pad);
+      }
+    }
 
-  if (sess->memout)
-    gf_free(gf_filter_get_rt_udta(sess->memout));
+    GPAC_MemIoContext* rt_udta = gf_filter_get_rt_udta(sess->memout);
+    if (rt_udta) {
+      // Lanes still alive keep the pool running until they are freed
+      gpac_writer_pool_unref(rt_udta->writers);
+      // Buffers still held downstream are freed when they are released
+      gpac_pckmem_pool_free(rt_udta->pckmem);
+      g_free(rt_udta);
+    }
+  }
 }
 
-void
-gpac_memio_assign_queue(GPAC_SessionContext* sess,
-                        GPAC_MemIoDirection dir,
-                        GQueue* queue)
+gboolean
+gpac_memio_push(GPAC_SessionContext* sess, GF_FilterPacket* packet)
 {
-  GPAC_MemIoContext* rt_udta = gf_filter_get_rt_udta(
-    dir == GPAC_MEMIO_DIR_IN ? sess->memin : sess->memout);
+  GPAC_MemIoContext* rt_udta = gf_filter_get_rt_udta(sess->memin);
   if (!rt_udta) {
     GST_ELEMENT_ERROR(sess->element,
                       LIBRARY,
                       FAILED,
                       (NULL),
                       ("Failed to get runtime user data"));
-    return;
+    return FALSE;
   }
-  rt_udta->queue = queue;
+  return gpac_ring_push(rt_udta->ring, packet);
+}
+
+guint
+gpac_memio_get_pending(GPAC_SessionContext* sess)
+{
+  if (!sess->memin)
+    return 0;
+
+  GPAC_MemIoContext* rt_udta = gf_filter_get_rt_udta(sess->memin);
+  if (!rt_udta || !rt_udta->ring)
+    return 0;
+  return gpac_ring_get_length(rt_udta->ring);
+}
+
+guint
+gpac_memio_get_capacity(GPAC_SessionContext* sess)
+{
+  if (!sess->memin)
+    return 0;
+
+  GPAC_MemIoContext* rt_udta = gf_filter_get_rt_udta(sess->memin);
+  if (!rt_udta || !rt_udta->ring)
+    return 0;
+  return gpac_ring_get_capacity(rt_udta->ring);
 }
 
 void
@@ -282,59 +338,94 @@ gpac_memio_set_gst_caps(GPAC_SessionContext* sess, GstCaps* caps)
 }
 
 GPAC_FilterPPRet
-gpac_memio_consume(GPAC_SessionContext* sess, void** outptr)
+gpac_memio_consume(GPAC_SessionContext* sess,
+                   void** outptr,
+                   GF_FilterPid** out_pid)
 {
+  *outptr = NULL;
+  if (out_pid)
+    *out_pid = NULL;
   if (!sess->memout)
     return GPAC_FILTER_PP_RET_NULL;
 
-  // Context
-  guint32 pid_to_consume = 0;
-  GF_FilterPid* best_ipid = NULL;
-  GPAC_MemOutPIDContext* best_pctx = NULL;
+  GPAC_MemIoContext* ctx = gf_filter_get_rt_udta(sess->memout);
   GPAC_FilterPPRet ret = GPAC_FILTER_PP_RET_INVALID;
+  GPAC_FilterPPRet idle_ret = GPAC_FILTER_PP_RET_INVALID;
+  u32 count = gf_filter_get_ipid_count(sess->memout);
+  gboolean has_consumable = FALSE;
 
-  // Find the PID to consume
-  for (u32 i = 0; i < gf_filter_get_ipid_count(sess->memout); i++) {
+  // PIDs that we should not consume only get their consume callback called
+  for (u32 i = 0; i < count; i++) {
     GF_FilterPid* ipid = gf_filter_get_ipid(sess->memout, i);
-    GPAC_MemOutPIDContext* pctx =
-      (GPAC_MemOutPIDContext*)gf_filter_pid_get_udta(ipid);
-    GPAC_MemOutPIDFlags udta_flags = gf_filter_pid_get_udta_flags(ipid);
-
-    // If we should not consume this PID, call the consume callback
-    // and continue to the next one
-    if (udta_flags & GPAC_MEMOUT_PID_FLAG_DONT_CONSUME) {
+    GPAC_MemOutPIDFlags flags = gf_filter_pid_get_udta_flags(ipid);
+    if (flags & GPAC_MEMOUT_PID_FLAG_DONT_CONSUME) {
+      GPAC_MemOutPIDContext* pctx = gf_filter_pid_get_udta(ipid);
       ret |= pctx->entry->consume(sess->memout, ipid, NULL);
-      continue;
     }
+  }
 
-    // Check if there are more than one PID to consume
-    if (pid_to_consume > 0) {
-      GST_ELEMENT_ERROR(sess->element,
-                        STREAM,
-                        FAILED,
-                        (NULL),
-                        ("Multiple PIDs to consume, this is not supported by "
-                         "the memout filter"));
-      return GPAC_FILTER_PP_RET_ERROR;
+  // Poll the others, starting after the one that had output last time
+  for (u32 n = 0; n < count; n++) {
+    u32 i = (ctx->next_pid + n) % count;
+    GF_FilterPid* ipid = gf_filter_get_ipid(sess->memout, i);
+    if (gf_filter_pid_get_udta_flags(ipid) & GPAC_MEMOUT_PID_FLAG_DONT_CONSUME)
+      continue;
+    has_consumable = TRUE;
+
+    GPAC_MemOutPIDContext* pctx = gf_filter_pid_get_udta(ipid);
+    GPAC_FilterPPRet pid_ret = pctx->entry->consume(sess->memout, ipid, outptr);
+    if (pid_ret & GPAC_FILTER_PP_RET_ERROR)
+      return ret | pid_ret;
+
+    if (HAS_FLAG(pid_ret, GPAC_FILTER_PP_RET_BUFFER) ||
+        HAS_FLAG(pid_ret, GPAC_FILTER_PP_RET_BUFFER_LIST)) {
+      ctx->next_pid = i + 1;
+      if (out_pid)
+        *out_pid = ipid;
+      return ret | pid_ret;
     }
-
-    // We can consume this PID
-    pid_to_consume++;
-    best_ipid = ipid;
-    best_pctx = pctx;
+    idle_ret |= pid_ret;
   }
 
-  if (!best_ipid) {
-    *outptr = NULL;
-    // No PID to consume
+  // No PID to consume
+  *outptr = NULL;
+  if (!has_consumable)
     return ret == GPAC_FILTER_PP_RET_INVALID
              ? GPAC_FILTER_PP_RET_EMPTY
              : ret; // If we have a signal, return it
-  }
+  return ret | idle_ret;
+}
 
-  // We can consume the PID
-  ret |= best_pctx->entry->consume(sess->memout, best_ipid, outptr);
-  return ret;
+GstPad*
+gpac_memio_get_src_pad(GF_FilterPid* pid)
+{
+  GPAC_MemOutPIDContext* pctx = gf_filter_pid_get_udta(pid);
+  return pctx ? pctx->src_pad : NULL;
+}
+
+void
+gpac_memio_set_src_pad(GF_FilterPid* pid, GstPad* pad)
+{
+  GPAC_MemOutPIDContext* pctx = gf_filter_pid_get_udta(pid);
+  if (pctx)
+    gst_object_replace((GstObject**)&pctx->src_pad, (GstObject*)pad);
+}
+
+GPAC_PckMemPool*
+gpac_memio_get_pckmem(GF_Filter* memout)
+{
+  // Post-processors run on the filter thread, no need for a lock
+  GPAC_MemIoContext* ctx = gf_filter_get_rt_udta(memout);
+  if (!ctx->pckmem)
+    ctx->pckmem = gpac_pckmem_pool_new();
+  return ctx->pckmem;
+}
+
+GPAC_PckRefs*
+gpac_memio_get_pck_refs(GF_Filter* memin)
+{
+  GPAC_MemIoContext* ctx = gf_filter_get_rt_udta(memin);
+  return ctx ? ctx->refs : NULL;
 }
 
 void
@@ -380,7 +471,7 @@ gpac_default_memin_process_cb(GF_Filter* filter)
 
   // Flush the queue
   GF_FilterPacket* packet = NULL;
-  while ((packet = g_queue_pop_head(ctx->queue)))
+  while ((packet = gpac_ring_pop(ctx->ring)))
     gf_filter_pck_send(packet);
 
   // All packets are sent, check if the EOS is set
@@ -402,7 +493,7 @@ gpac_default_memin_process_event_cb(GF_Filter* filter,
     GF_FilterPid* pid = evt->base.on_pid;
     GF_Fraction intra_period = evt->encode_hints.intra_period;
     GpacPadPrivate* priv = gf_filter_pid_get_udta(pid);
-    GstElement* element = gst_pad_get_parent_element(priv->self);
+    GstElement* element = priv->element;
 
     // Set the IDR period
     priv->idr_period =
@@ -477,6 +568,8 @@ gpac_default_memout_process_cb(GF_Filter* filter)
 
     // Get the packet
     GF_FilterPacket* pck = gf_filter_pid_get_packet(ipid);
+    if (pck)
+      ctx->sess->stats.packets++;
 
     // If we have a post-process context, process the packet
     if (pctx && pctx->entry)
@@ -532,6 +625,9 @@ gpac_default_memout_configure_pid_cb(GF_Filter* filter,
       // Free the post-process context if it exists
       if (pctx->entry)
         pctx->entry->ctx_free(pctx->private_ctx);
+      gpac_pck_source_detach(pctx->source);
+      gpac_pck_source_unref(pctx->source);
+      gst_clear_object(&pctx->src_pad);
       g_free(pctx);
     }
     return GF_OK;
@@ -549,12 +645,14 @@ gpac_default_memout_configure_pid_cb(GF_Filter* filter,
                        "PID %s is already initialized, proceeding with "
                        "configure_pid callback only",
                        gf_filter_pid_get_name(pid));
+      gpac_pck_source_update(pctx->source);
       return pctx->entry->configure_pid(filter, pid);
     }
   }
 
   // Allocate the post-process context
   pctx = g_new0(GPAC_MemOutPIDContext, 1);
+  pctx->source = gpac_pck_source_new(pid);
   gf_filter_pid_set_udta(pid, pctx);
 
   // Check if there is a "dasher" upstream filter
@@ -25,25 +25,148 @@
 
 #include "lib/packet.h"
 #include "conversion/packet/registry.h"
+#include "lib/memio.h"
 #include "utils.h"
 
+// #MARK: Buffer refs
+// Released records kept for reuse, per store
+#define GPAC_BUFFER_REF_FREE_MAX 64
+
+typedef struct _GpacBufferRef GpacBufferRef;
+struct _GpacBufferRef
+{
+  GstBuffer* buffer;
+  GstMapInfo map; // Kept mapped until gpac releases the packet
+  GPAC_QueueLevel* level;
+  GpacBufferRef* next; // Free list link
+};
+
+struct _GPAC_PckRefs
+{
+  GMutex lock;
+  GHashTable* live; // GF_FilterPacket* -> GpacBufferRef*
+  GpacBufferRef* free;
+  guint n_free;
+};
+
+GPAC_PckRefs*
+gpac_pck_refs_new(void)
+{
+  GPAC_PckRefs* refs = g_new0(GPAC_PckRefs, 1);
+  g_mutex_init(&refs->lock);
+  refs->live = g_hash_table_new(g_direct_hash, g_direct_equal);
+  return refs;
+}
+
+static void
+gpac_buffer_ref_release(GpacBufferRef* ref)
+{
+  if (ref->level)
+    gpac_queue_level_release(ref->level, ref->map.size);
+  gst_buffer_unmap(ref->buffer, &ref->map);
+  gst_buffer_unref(ref->buffer);
+}
+
+void
+gpac_pck_refs_free(GPAC_PckRefs* refs)
+{
+  if (!refs)
+    return;
+
+  // The session no longer reads the packets that still hold a record
+  GHashTableIter iter;
+  gpointer ref;
+  g_hash_table_iter_init(&iter, refs->live);
+  while (g_hash_table_iter_next(&iter, NULL, &ref)) {
+    gpac_buffer_ref_release(ref);
+    g_free(ref);
+  }
+  g_hash_table_unref(refs->live);
+
+  while (refs->free) {
+    GpacBufferRef* next = refs->free->next;
+    g_free(refs->free);
+    refs->free = next;
+  }
+  g_mutex_clear(&refs->lock);
+  g_free(refs);
+}
+
+static GpacBufferRef*
+gpac_buffer_ref_new(GPAC_PckRefs* refs)
+{
+  GpacBufferRef* ref = NULL;
+
+  g_mutex_lock(&refs->lock);
+  if (refs->free) {
+    ref = refs->free;
+    refs->free = ref->next;
+    refs->n_free--;
+  }
+  g_mutex_unlock(&refs->lock);
+
+  if (!ref)
+    ref = g_new(GpacBufferRef, 1);
+  ref->next = NULL;
+  return ref;
+}
+
+static void
+gpac_buffer_ref_free(GPAC_PckRefs* refs, GpacBufferRef* ref)
+{
+  g_mutex_lock(&refs->lock);
+  if (refs->n_free < GPAC_BUFFER_REF_FREE_MAX) {
+    ref->next = refs->free;
+    refs->free = ref;
+    refs->n_free++;
+    ref = NULL;
+  }
+  g_mutex_unlock(&refs->lock);
+  g_free(ref);
+}
+
 static void
 gpac_pck_destructor(GF_Filter* filter, GF_FilterPid* PID, GF_FilterPacket* pck)
 {
-  const GF_PropertyValue* prop =
-    gf_filter_pck_get_property(pck, GF_PROP_PCK_UDTA);
-  if (prop) {
-    GstBuffer* buffer = prop->value.ptr;
-    gst_buffer_unref(buffer);
+  // Detached when the memory input filter is freed
+  GPAC_PckRefs* refs = gpac_memio_get_pck_refs(filter);
+  if (G_UNLIKELY(!refs))
+    return;
+
+  g_mutex_lock(&refs->lock);
+  GpacBufferRef* ref = g_hash_table_lookup(refs->live, pck);
+  if (ref)
+    g_hash_table_remove(refs->live, pck);
+  g_mutex_unlock(&refs->lock);
+  if (G_UNLIKELY(!ref))
+    return;
+
+  gpac_buffer_ref_release(ref);
+  gpac_buffer_ref_free(refs, ref);
+}
+
+// Whether the memories of the buffer can be mapped without merging them
+static gboolean
+gpac_pck_buffer_is_contiguous(GstBuffer* buffer)
+{
+  guint n_mem = gst_buffer_n_memory(buffer);
+  for (guint i = 1; i < n_mem; i++) {
+    gsize offset;
+    if (!gst_memory_is_span(gst_buffer_peek_memory(buffer, i - 1),
+                            gst_buffer_peek_memory(buffer, i),
+                            &offset))
+      return FALSE;
   }
+  return TRUE;
 }
 
+// #MARK: Configuration
 guint64
 gpac_pck_get_stream_time(GstClockTime time,
                          GpacPadPrivate* priv,
                          gboolean is_dts)
 {
-  GstElement* element = gst_pad_get_parent_element(priv->self);
+  GstElement* element = priv->element;
   if (!GST_CLOCK_TIME_IS_VALID(time))
     goto fail;
 
@@ -145,72 +268,271 @@ gpac_pck_prop_configure(GPAC_PCK_PROP_IMPL_ARGS)
   }
 }
 
-GF_FilterPacket*
-gpac_pck_new_from_buffer(GstBuffer* buffer,
-                         GpacPadPrivate* priv,
-                         GF_FilterPid* pid)
+void
+gpac_pck_cache_pid_params(GPAC_PID_PROP_IMPL_ARGS)
 {
   const GF_PropertyValue* p;
-  GstElement* element = gst_pad_get_parent_element(priv->self);
+  priv->element = element;
 
-  // Map the buffer
-  g_auto(GstBufferMapInfo) map = GST_MAP_INFO_INIT;
-  if (G_UNLIKELY(!gst_buffer_map(buffer, &map, GST_MAP_READ))) {
+  // Get the timescale from the PID
+  priv->timescale = GST_SECOND;
+  p = gf_filter_pid_get_property(pid, GF_PROP_PID_TIMESCALE);
+  if (p)
+    priv->timescale = p->value.uint;
+
+  // Round to the nearest tick, GStreamer timestamps are often truncated
+  gpac_time_converter_init(&priv->to_pid, GST_SECOND, priv->timescale);
+
+  // Raw video is handed over frame by frame
+  p = gf_filter_pid_get_property(pid, GF_PROP_PID_CODECID);
+  priv->raw_video = p && p->value.uint == GF_CODECID_RAW &&
+                    priv->caps_info.is_raw &&
+                    GST_VIDEO_INFO_FORMAT(&priv->caps_info.video_info) !=
+                      GST_VIDEO_FORMAT_UNKNOWN;
+  p = gf_filter_pid_get_property(pid, GF_PROP_PID_STRIDE);
+  priv->stride = p ? p->value.uint : 0;
+  p = gf_filter_pid_get_property(pid, GF_PROP_PID_STRIDE_UV);
+  priv->stride_uv = p ? p->value.uint : 0;
+
+  // Pick the packet builder for the stream type
+  p = gf_filter_pid_get_property(pid, GF_PROP_PID_STREAM_TYPE);
+  priv->stream_type = p ? p->value.uint : GF_STREAM_UNKNOWN;
+  switch (priv->stream_type) {
+    case GF_STREAM_VISUAL:
+      priv->builder = gpac_configure_video;
+      break;
+    default:
+      priv->builder = NULL;
+      break;
+  }
+}
+
+// #MARK: Shared packets
+static GF_FilterPacket*
+gpac_pck_new_shared(GstBuffer* buffer, GpacPadPrivate* priv, GF_FilterPid* pid)
+{
+  GstElement* element = priv->element;
+  gsize size = gst_buffer_get_size(buffer);
+
+  // Scattered memories would be merged into a temporary copy when mapped,
+  // copy them into a gpac owned packet instead and let go of the buffer.
+  // Compressed data is read through gf_filter_pck_get_data, as one block
+  if (size == 0 || !gpac_pck_buffer_is_contiguous(buffer)) {
+    u8* data = NULL;
+    GF_FilterPacket* packet = gf_filter_pck_new_alloc(pid, size, &data);
+    if (G_UNLIKELY(!packet)) {
+      GST_ELEMENT_ERROR(
+        element, STREAM, FAILED, (NULL), ("Failed to allocate packet"));
+      return NULL;
+    }
+    if (size)
+      gst_buffer_extract(buffer, 0, data, size);
+    return packet;
+  }
+
+  // Map the buffer for as long as gpac holds the packet
+  GPAC_PckRefs* refs = priv->refs;
+  GpacBufferRef* ref = gpac_buffer_ref_new(refs);
+  if (G_UNLIKELY(!gst_buffer_map(buffer, &ref->map, GST_MAP_READ))) {
     GST_ELEMENT_ERROR(
       element, STREAM, FAILED, (NULL), ("Failed to map buffer"));
+    gpac_buffer_ref_free(refs, ref);
     return NULL;
   }
+  ref->buffer = gst_buffer_ref(buffer);
 
   // Create a new shared packet
-  GF_FilterPacket* packet =
-    gf_filter_pck_new_shared(pid, map.data, map.size, gpac_pck_destructor);
-
-  // Ref the buffer so that we can free it later
-  GstBuffer* ref = gst_buffer_ref(buffer);
-  GF_Err err =
-    gf_filter_pck_set_property(packet, GF_PROP_PCK_UDTA, &PROP_POINTER(ref));
-  if (G_UNLIKELY(err != GF_OK)) {
-    GST_ELEMENT_ERROR(element,
-                      STREAM,
-                      FAILED,
-                      (NULL),
-                      ("Failed to save the buffer ref to the packet"));
-    gst_buffer_unref(ref);
-    gf_filter_pck_unref(packet);
+  GF_FilterPacket* packet = gf_filter_pck_new_shared(
+    pid, ref->map.data, ref->map.size, gpac_pck_destructor);
+  if (G_UNLIKELY(!packet)) {
+    GST_ELEMENT_ERROR(
+      element, STREAM, FAILED, (NULL), ("Failed to create shared packet"));
+    gst_buffer_unmap(ref->buffer, &ref->map);
+    gst_buffer_unref(ref->buffer);
+    gpac_buffer_ref_free(refs, ref);
     return NULL;
   }
 
-  // Get the fps from the PID
-  GF_Fraction fps = { 30, 1 };
-  p = gf_filter_pid_get_property(pid, GF_PROP_PID_FPS);
-  if (p)
-    fps = p->value.frac;
+  // Found again by the destructor, keyed by the packet
+  ref->level = priv->level;
+  if (ref->level)
+    gpac_queue_level_hold(ref->level, ref->map.size);
+  g_mutex_lock(&refs->lock);
+  g_hash_table_insert(refs->live, packet, ref);
+  g_mutex_unlock(&refs->lock);
+  return packet;
+}
 
-  // Get the timescale from the PID
-  guint64 timescale = GST_SECOND;
-  p = gf_filter_pid_get_property(pid, GF_PROP_PID_TIMESCALE);
-  if (p)
-    timescale = p->value.uint;
+// #MARK: Raw video
+typedef struct
+{
+  GF_FilterFrameInterface ifce;
+  GstVideoFrame frame; // Holds a ref on the buffer while mapped
+  GPAC_QueueLevel* level;
+} GpacVideoFrame;
+
+static GF_Err
+gpac_pck_get_plane(GF_FilterFrameInterface* ifce,
+                   u32 plane_idx,
+                   const u8** out_plane,
+                   u32* out_stride)
+{
+  GpacVideoFrame* frame = ifce->user_data;
+  if (plane_idx >= GST_VIDEO_FRAME_N_PLANES(&frame->frame))
+    return GF_BAD_PARAM;
+
+  *out_plane = GST_VIDEO_FRAME_PLANE_DATA(&frame->frame, plane_idx);
+  *out_stride = GST_VIDEO_FRAME_PLANE_STRIDE(&frame->frame, plane_idx);
+  return GF_OK;
+}
+
+static void
+gpac_pck_frame_destructor(GF_Filter* filter,
+                          GF_FilterPid* PID,
+                          GF_FilterPacket* pck)
+{
+  GF_FilterFrameInterface* ifce = gf_filter_pck_get_frame_interface(pck);
+  if (ifce) {
+    GpacVideoFrame* frame = ifce->user_data;
+    if (frame->level)
+      gpac_queue_level_release(frame->level,
+                               gst_buffer_get_size(frame->frame.buffer));
+    gst_video_frame_unmap(&frame->frame);
+    g_free(frame);
+  }
+}
+
+// Whether gpac can read the frame as one block with the strides of the PID
+static gboolean
+gpac_pck_is_packed_layout(GstVideoFrame* frame, GpacPadPrivate* priv)
+{
+  if (gst_buffer_n_memory(frame->buffer) != 1)
+    return FALSE;
+
+  gsize offset = 0;
+  for (guint i = 0; i < GST_VIDEO_FRAME_N_PLANES(frame); i++) {
+    u32 stride = i == 0 ? priv->stride : priv->stride_uv;
+    if (GST_VIDEO_FRAME_PLANE_OFFSET(frame, i) != offset ||
+        (u32)GST_VIDEO_FRAME_PLANE_STRIDE(frame, i) != stride)
+      return FALSE;
+
+    gint comp[GST_VIDEO_MAX_COMPONENTS];
+    gst_video_format_info_component(frame->info.finfo, i, comp);
+    offset += (gsize)stride * GST_VIDEO_FRAME_COMP_HEIGHT(frame, comp[0]);
+  }
+  return TRUE;
+}
+
+static GF_FilterPacket*
+gpac_pck_new_video_frame(GstBuffer* buffer,
+                         GpacPadPrivate* priv,
+                         GF_FilterPid* pid)
+{
+  GstElement* element = priv->element;
+  GpacVideoFrame* frame = g_new0(GpacVideoFrame, 1);
+
+  // Picks up the plane offsets and strides of the video meta, if any
+  if (G_UNLIKELY(!gst_video_frame_map(&frame->frame,
+                                      &priv->caps_info.video_info,
+                                      buffer,
+                                      GST_MAP_READ))) {
+    GST_ELEMENT_ERROR(
+      element, STREAM, FAILED, (NULL), ("Failed to map video frame"));
+    g_free(frame);
+    return NULL;
+  }
+
+  // Frames in the layout announced on the PID are shared as one block
+  if (gpac_pck_is_packed_layout(&frame->frame, priv)) {
+    gst_video_frame_unmap(&frame->frame);
+    g_free(frame);
+    return gpac_pck_new_shared(buffer, priv, pid);
+  }
+
+  // Otherwise gpac reads the planes where they are
+  frame->ifce.get_plane = gpac_pck_get_plane;
+  frame->ifce.user_data = frame;
+  // Buffers from a pool must go back to it quickly
+  if (buffer->pool)
+    frame->ifce.flags |= GF_FRAME_IFCE_BLOCKING;
+
+  GF_FilterPacket* packet = gf_filter_pck_new_frame_interface(
+    pid, &frame->ifce, gpac_pck_frame_destructor);
+  if (G_UNLIKELY(!packet)) {
+    GST_ELEMENT_ERROR(
+      element, STREAM, FAILED, (NULL), ("Failed to create frame packet"));
+    gst_video_frame_unmap(&frame->frame);
+    g_free(frame);
+    return NULL;
+  }
+
+  frame->level = priv->level;
+  if (frame->level)
+    gpac_queue_level_hold(frame->level, gst_buffer_get_size(buffer));
+  return packet;
+}
+
+// #MARK: Forwarded packets
+static Bool
+gpac_pck_is_forwarded_prop(void* cbk,
+                           u32 prop_4cc,
+                           const char* prop_name,
+                           const GF_PropertyValue* src_prop)
+{
+  // The user data of the upstream packet belongs to its own session
+  return prop_4cc != GF_PROP_PCK_UDTA;
+}
+
+/*
+ * Buffers made of a single gpac packet carry its properties along. The packet
+ * belongs to the session of the upstream element, so it is never referenced
+ * from this one: its data is shared through the buffer, which keeps it alive.
+ */
+static void
+gpac_pck_merge_forwarded(GstBuffer* buffer, GF_FilterPacket* packet)
+{
+  if (gst_buffer_n_memory(buffer) != 1)
+    return;
+
+  GF_FilterPacket* ref =
+    gpac_pckmem_get_packet(gst_buffer_peek_memory(buffer, 0), NULL);
+  if (ref)
+    gf_filter_pck_merge_properties_filter(
+      ref, packet, gpac_pck_is_forwarded_prop, NULL);
+}
+
+// #MARK: Packet
+GF_FilterPacket*
+gpac_pck_new_from_buffer(GstBuffer* buffer,
+                         GpacPadPrivate* priv,
+                         GF_FilterPid* pid)
+{
+  GF_FilterPacket* packet = priv->raw_video
+                              ? gpac_pck_new_video_frame(buffer, priv, pid)
+                              : gpac_pck_new_shared(buffer, priv, pid);
+  if (G_UNLIKELY(!packet))
+    return NULL;
+  gpac_pck_merge_forwarded(buffer, packet);
 
   // Set the DTS to DTS or PTS, whichever is valid
   if (GST_BUFFER_DTS_IS_VALID(buffer) || GST_BUFFER_PTS_IS_VALID(buffer)) {
     guint64 dts =
       gpac_pck_get_stream_time(GST_BUFFER_DTS_OR_PTS(buffer), priv, TRUE);
-    dts = gpac_time_rescale_with_fps(dts, fps, timescale);
+    dts = gpac_time_converter_apply(&priv->to_pid, dts);
     gf_filter_pck_set_dts(packet, dts);
   }
 
   // Set the CTS to PTS if it's valid
   if (GST_BUFFER_PTS_IS_VALID(buffer)) {
     guint64 cts = gpac_pck_get_stream_time(GST_BUFFER_PTS(buffer), priv, FALSE);
-    cts = gpac_time_rescale_with_fps(cts, fps, timescale);
+    cts = gpac_time_converter_apply(&priv->to_pid, cts);
     gf_filter_pck_set_cts(packet, cts);
   }
 
   // Set the duration
   if (GST_BUFFER_DURATION_IS_VALID(buffer)) {
     guint64 duration = GST_BUFFER_DURATION(buffer);
-    duration = gpac_time_rescale_with_fps(duration, fps, timescale);
+    duration = gpac_time_converter_apply(&priv->to_pid, duration);
     gf_filter_pck_set_duration(packet, duration);
   }
 
@@ -220,15 +542,9 @@ gpac_pck_new_from_buffer(GstBuffer* buffer,
   // Set the default SAP type
   gf_filter_pck_set_sap(packet, GF_FILTER_SAP_1);
 
-  // Check if this is a video
-  const GF_PropertyValue* p_typ =
-    gf_filter_pid_get_property(pid, GF_PROP_PID_STREAM_TYPE);
-  gboolean is_video = p_typ && p_typ->value.uint == GF_STREAM_VISUAL;
-
-  // For video streams, we need further configuration
-  if (is_video) {
-    gpac_configure_video(buffer, priv, packet);
-  }
+  // Stream type specific configuration, e.g. SAP and dependency flags for video
+  if (priv->builder)
+    priv->builder(buffer, priv, packet);
 
   // Configure the packet properties
   gpac_pck_prop_configure(buffer, priv, packet);
@@ -0,0 +1,435 @@
+/*
+ *			GPAC - Multimedia Framework C SDK
+ *
+ *			Authors: Deniz Ugur, Romain Bouqueau, Sohaib Larbi
+ *			Copyright (c) Motion Spell
+ *				All rights reserved
+ *
+ *  This file is part of the GPAC/GStreamer wrapper
+ *
+ *  This GPAC/GStreamer wrapper is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Affero General Public License
+ *  as published by the Free Software Foundation; either version 3, or (at
+ *  your option) any later version.
+ *
+ *  This GPAC/GStreamer wrapper is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public
+ *  License along with this library; see the file LICENSE.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include "lib/pckmem.h"
+
+// #MARK: Source
+struct _GPAC_PckSource
+{
+  gint ref_count;
+
+  GMutex lock;
+  GF_FilterPid* pid; // NULL once detached
+  guint generation;
+};
+
+GPAC_PckSource*
+gpac_pck_source_new(GF_FilterPid* pid)
+{
+  GPAC_PckSource* source = g_new0(GPAC_PckSource, 1);
+  source->ref_count = 1;
+  g_mutex_init(&source->lock);
+  source->pid = pid;
+  return source;
+}
+
+GPAC_PckSource*
+gpac_pck_source_ref(GPAC_PckSource* source)
+{
+  g_atomic_int_inc(&source->ref_count);
+  return source;
+}
+
+void
+gpac_pck_source_unref(GPAC_PckSource* source)
+{
+  if (!source || !g_atomic_int_dec_and_test(&source->ref_count))
+    return;
+  g_mutex_clear(&source->lock);
+  g_free(source);
+}
+
+void
+gpac_pck_source_update(GPAC_PckSource* source)
+{
+  g_mutex_lock(&source->lock);
+  source->generation++;
+  g_mutex_unlock(&source->lock);
+}
+
+void
+gpac_pck_source_detach(GPAC_PckSource* source)
+{
+  g_mutex_lock(&source->lock);
+  source->pid = NULL;
+  g_mutex_unlock(&source->lock);
+}
+
+guint
+gpac_pck_source_get_generation(GPAC_PckSource* source)
+{
+  g_mutex_lock(&source->lock);
+  guint generation = source->generation;
+  g_mutex_unlock(&source->lock);
+  return generation;
+}
+
+gboolean
+gpac_pck_source_copy_properties(GPAC_PckSource* source, GF_FilterPid* dst)
+{
+  // The lock keeps the PID alive while it is read
+  g_mutex_lock(&source->lock);
+  gboolean copied =
+    source->pid && gf_filter_pid_copy_properties(dst, source->pid) == GF_OK;
+  g_mutex_unlock(&source->lock);
+  return copied;
+}
+
+// #MARK: Packet memory
+typedef struct _GpacPckMemory GpacPckMemory;
+struct _GpacPckMemory
+{
+  GstMemory mem;
+  GF_FilterPacket* pck; // Held by root memories, slices hold their parent
+  GPAC_PckSource* source; // Held along with the packet, may be NULL
+  u8* data;             // Start of the packet data
+  guint flags;          // Mini object flags set by gst_memory_init
+  GpacPckMemory* next;  // Free list link
+};
+
+typedef struct
+{
+  GstAllocator parent;
+
+  GMutex lock;
+  GpacPckMemory* free_list;
+  guint n_free;
+  gboolean closed; // Released memories are freed from now on
+} GpacPckAllocator;
+
+typedef struct
+{
+  GstAllocatorClass parent_class;
+} GpacPckAllocatorClass;
+
+G_DEFINE_TYPE(GpacPckAllocator, gpac_pck_allocator, GST_TYPE_ALLOCATOR);
+
+static gboolean
+gpac_pck_memory_dispose(GstMiniObject* obj)
+{
+  GstMemory* mem = GST_MEMORY_CAST(obj);
+  GpacPckMemory* pmem = (GpacPckMemory*)mem;
+  GpacPckAllocator* alloc = (GpacPckAllocator*)mem->allocator;
+
+  // Let go of the data first, releasing the parent may dispose it as well
+  if (pmem->pck) {
+    gf_filter_pck_unref(pmem->pck);
+    pmem->pck = NULL;
+  }
+  g_clear_pointer(&pmem->source, gpac_pck_source_unref);
+  if (mem->parent) {
+    gst_memory_unlock(mem->parent, GST_LOCK_FLAG_EXCLUSIVE);
+    gst_memory_unref(mem->parent);
+    mem->parent = NULL;
+  }
+  pmem->data = NULL;
+
+  g_mutex_lock(&alloc->lock);
+  if (alloc->closed || alloc->n_free >= GPAC_PCKMEM_FREE_MAX) {
+    g_mutex_unlock(&alloc->lock);
+    return TRUE;
+  }
+
+  // Keep the memory alive on the free list
+  gst_memory_ref(mem);
+  pmem->next = alloc->free_list;
+  alloc->free_list = pmem;
+  alloc->n_free++;
+  g_mutex_unlock(&alloc->lock);
+  return FALSE;
+}
+
+static GpacPckMemory*
+gpac_pck_memory_obtain(GpacPckAllocator* alloc,
+                       GstMemory* parent,
+                       gsize maxsize,
+                       gsize offset,
+                       gsize size)
+{
+  g_mutex_lock(&alloc->lock);
+  GpacPckMemory* pmem = alloc->free_list;
+  if (pmem) {
+    alloc->free_list = pmem->next;
+    alloc->n_free--;
+  }
+  g_mutex_unlock(&alloc->lock);
+
+  if (!pmem) {
+    pmem = g_new0(GpacPckMemory, 1);
+    gst_memory_init(GST_MEMORY_CAST(pmem),
+                    GST_MEMORY_FLAG_READONLY,
+                    GST_ALLOCATOR_CAST(alloc),
+                    parent,
+                    maxsize,
+                    0,
+                    offset,
+                    size);
+    GST_MINI_OBJECT_CAST(pmem)->dispose = gpac_pck_memory_dispose;
+    pmem->flags = GST_MINI_OBJECT_FLAGS(pmem);
+    return pmem;
+  }
+
+  // Same as gst_memory_init, but the allocator ref is still held
+  GstMemory* mem = GST_MEMORY_CAST(pmem);
+  GST_MINI_OBJECT_FLAGS(mem) = pmem->flags;
+  mem->maxsize = maxsize;
+  mem->align = 0;
+  mem->offset = offset;
+  mem->size = size;
+  if (parent) {
+    gst_memory_lock(parent, GST_LOCK_FLAG_EXCLUSIVE);
+    mem->parent = gst_memory_ref(parent);
+  }
+  pmem->next = NULL;
+  return pmem;
+}
+
+static gpointer
+gpac_pck_memory_map(GstMemory* mem, gsize maxsize, GstMapFlags flags)
+{
+  return ((GpacPckMemory*)mem)->data;
+}
+
+static void
+gpac_pck_memory_unmap(GstMemory* mem)
+{
+}
+
+static GstMemory*
+gpac_pck_memory_share(GstMemory* mem, gssize offset, gssize size)
+{
+  GpacPckMemory* pmem = (GpacPckMemory*)mem;
+  GstMemory* parent = mem->parent ? mem->parent : mem;
+  if (size == -1)
+    size = mem->size - offset;
+
+  GpacPckMemory* sub =
+    gpac_pck_memory_obtain((GpacPckAllocator*)mem->allocator,
+                           parent,
+                           mem->maxsize,
+                           mem->offset + offset,
+                           size);
+  sub->data = pmem->data;
+  return GST_MEMORY_CAST(sub);
+}
+
+static gboolean
+gpac_pck_memory_is_span(GstMemory* mem1, GstMemory* mem2, gsize* offset)
+{
+  // Only slices of the same root can be merged by sharing their parent
+  if (!mem1->parent)
+    return FALSE;
+
+  if (offset)
+    *offset = mem1->offset - mem1->parent->offset;
+  return mem1->offset + mem1->size == mem2->offset;
+}
+
+static void
+gpac_pck_allocator_free(GstAllocator* allocator, GstMemory* mem)
+{
+  GpacPckMemory* pmem = (GpacPckMemory*)mem;
+  if (pmem->pck)
+    gf_filter_pck_unref(pmem->pck);
+  gpac_pck_source_unref(pmem->source);
+  g_free(pmem);
+}
+
+static void
+gpac_pck_allocator_finalize(GObject* object)
+{
+  GpacPckAllocator* alloc = (GpacPckAllocator*)object;
+  g_mutex_clear(&alloc->lock);
+  G_OBJECT_CLASS(gpac_pck_allocator_parent_class)->finalize(object);
+}
+
+static void
+gpac_pck_allocator_class_init(GpacPckAllocatorClass* klass)
+{
+  GObjectClass* gobject_class = G_OBJECT_CLASS(klass);
+  GstAllocatorClass* allocator_class = GST_ALLOCATOR_CLASS(klass);
+
+  gobject_class->finalize = gpac_pck_allocator_finalize;
+  allocator_class->free = gpac_pck_allocator_free;
+}
+
+static void
+gpac_pck_allocator_init(GpacPckAllocator* alloc)
+{
+  GstAllocator* allocator = GST_ALLOCATOR_CAST(alloc);
+
+  allocator->mem_type = GPAC_PCKMEM_TYPE;
+  allocator->mem_map = gpac_pck_memory_map;
+  allocator->mem_unmap = gpac_pck_memory_unmap;
+  allocator->mem_share = gpac_pck_memory_share;
+  allocator->mem_is_span = gpac_pck_memory_is_span;
+  // Memories only come from gpac_pckmem_pool_wrap
+  GST_OBJECT_FLAG_SET(allocator, GST_ALLOCATOR_FLAG_CUSTOM_ALLOC);
+
+  g_mutex_init(&alloc->lock);
+}
+
+// #MARK: Buffer shells
+typedef struct
+{
+  GstBufferPool parent;
+} GpacShellPool;
+
+typedef struct
+{
+  GstBufferPoolClass parent_class;
+} GpacShellPoolClass;
+
+G_DEFINE_TYPE(GpacShellPool, gpac_shell_pool, GST_TYPE_BUFFER_POOL);
+
+static GstFlowReturn
+gpac_shell_pool_alloc_buffer(GstBufferPool* pool,
+                             GstBuffer** buffer,
+                             GstBufferPoolAcquireParams* params)
+{
+  *buffer = gst_buffer_new();
+  return GST_FLOW_OK;
+}
+
+static void
+gpac_shell_pool_release_buffer(GstBufferPool* pool, GstBuffer* buffer)
+{
+  // Only the shell is pooled, the memories go back to their own pool
+  gst_buffer_remove_all_memory(buffer);
+  GST_BUFFER_FLAG_UNSET(buffer, GST_BUFFER_FLAG_TAG_MEMORY);
+  GST_BUFFER_POOL_CLASS(gpac_shell_pool_parent_class)
+    ->release_buffer(pool, buffer);
+}
+
+static void
+gpac_shell_pool_class_init(GpacShellPoolClass* klass)
+{
+  GstBufferPoolClass* pool_class = GST_BUFFER_POOL_CLASS(klass);
+
+  pool_class->alloc_buffer = gpac_shell_pool_alloc_buffer;
+  pool_class->release_buffer = gpac_shell_pool_release_buffer;
+}
+
+static void
+gpac_shell_pool_init(GpacShellPool* pool)
+{
+}
+
+// #MARK: Pool
+struct _GPAC_PckMemPool
+{
+  GpacPckAllocator* allocator;
+  GstBufferPool* shells;
+};
+
+GPAC_PckMemPool*
+gpac_pckmem_pool_new(void)
+{
+  GPAC_PckMemPool* pool = g_new0(GPAC_PckMemPool, 1);
+  pool->allocator =
+    gst_object_ref_sink(g_object_new(gpac_pck_allocator_get_type(), NULL));
+  pool->shells =
+    gst_object_ref_sink(g_object_new(gpac_shell_pool_get_type(), NULL));
+
+  // Shells have no memory of their own and the pool is unbounded
+  GstStructure* config = gst_buffer_pool_get_config(pool->shells);
+  gst_buffer_pool_config_set_params(config, NULL, 0, 0, 0);
+  if (!gst_buffer_pool_set_config(pool->shells, config) ||
+      !gst_buffer_pool_set_active(pool->shells, TRUE))
+    GST_WARNING("Failed to activate the buffer shell pool");
+
+  return pool;
+}
+
+void
+gpac_pckmem_pool_free(GPAC_PckMemPool* pool)
+{
+  if (!pool)
+    return;
+
+  // Shells in use are freed when they come back to the inactive pool
+  gst_buffer_pool_set_active(pool->shells, FALSE);
+  gst_object_unref(pool->shells);
+
+  // Same for the memories, the idle ones are freed now
+  GpacPckAllocator* alloc = pool->allocator;
+  g_mutex_lock(&alloc->lock);
+  alloc->closed = TRUE;
+  GpacPckMemory* pmem = alloc->free_list;
+  alloc->free_list = NULL;
+  alloc->n_free = 0;
+  g_mutex_unlock(&alloc->lock);
+  while (pmem) {
+    GpacPckMemory* next = pmem->next;
+    gst_memory_unref(GST_MEMORY_CAST(pmem));
+    pmem = next;
+  }
+  gst_object_unref(alloc);
+
+  g_free(pool);
+}
+
+GstMemory*
+gpac_pckmem_pool_wrap(GPAC_PckMemPool* pool,
+                      GPAC_PckSource* source,
+                      GF_FilterPacket* pck,
+                      gsize offset,
+                      gsize size)
+{
+  u32 pck_size;
+  const u8* data = gf_filter_pck_get_data(pck, &pck_size);
+  g_return_val_if_fail(offset + size <= pck_size, NULL);
+
+  GpacPckMemory* pmem =
+    gpac_pck_memory_obtain(pool->allocator, NULL, pck_size, offset, size);
+  gf_filter_pck_ref(&pck);
+  pmem->pck = pck;
+  pmem->source = source ? gpac_pck_source_ref(source) : NULL;
+  pmem->data = (u8*)data;
+  return GST_MEMORY_CAST(pmem);
+}
+
+GstBuffer*
+gpac_pckmem_pool_new_buffer(GPAC_PckMemPool* pool)
+{
+  GstBuffer* buffer = NULL;
+  if (gst_buffer_pool_acquire_buffer(pool->shells, &buffer, NULL) !=
+      GST_FLOW_OK)
+    buffer = gst_buffer_new();
+  return buffer;
+}
+
+GF_FilterPacket*
+gpac_pckmem_get_packet(GstMemory* mem, GPAC_PckSource** source)
+{
+  if (!gst_memory_is_type(mem, GPAC_PCKMEM_TYPE))
+    return NULL;
+
+  // Slices point at the packet of their root
+  GpacPckMemory* root = (GpacPckMemory*)(mem->parent ? mem->parent : mem);
+  if (source)
+    *source = root->source;
+  return root->pck;
+}
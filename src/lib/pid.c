@@ -24,73 +24,167 @@
  */
 
 #include "lib/pid.h"
+#include "lib/packet.h"
 #include "conversion/pid/registry.h"
 #include "gpacmessages.h"
 
-gboolean
-gpac_pid_apply_overrides(GPAC_PID_PROP_IMPL_ARGS_NO_ELEMENT, GList** to_skip)
+// Overridden registry entries are tracked in a 64-bit mask
+G_STATIC_ASSERT(G_N_ELEMENTS(prop_registry) <= 64);
+
+static void
+gpac_pid_parse_overrides(GpacPadPrivate* priv,
+                         const GstStructure* structure,
+                         const gchar* prefix)
 {
-  GstStructure* caps = gst_caps_get_structure(priv->caps, 0);
-  gchar* prefix = "gpac-";
-  gboolean nested = FALSE;
+  GpacCapsInfo* info = &priv->caps_info;
 
-retry:
-  // Go through the root structure
-  for (gint i = 0; i < gst_structure_n_fields(caps); i++) {
-    const gchar* field_name = gst_structure_nth_field_name(caps, i);
+  for (gint i = 0; i < gst_structure_n_fields(structure); i++) {
+    const gchar* field_name = gst_structure_nth_field_name(structure, i);
 
     // Check if the field name starts with the prefix
-    if (g_str_has_prefix(field_name, prefix)) {
-      GType type = gst_structure_get_field_type(caps, field_name);
-      if (type != G_TYPE_STRING) {
-        GST_WARNING_OBJECT(
-          priv->self,
-          "Property overrides for GPAC must be strings, %s is %s",
-          field_name,
-          g_type_name(type));
-        continue;
-      }
+    if (!g_str_has_prefix(field_name, prefix))
+      continue;
 
-      const gchar* prop_name = field_name + strlen(prefix);
-      u32 prop_4cc = gf_props_get_id(prop_name);
+    const GValue* value = gst_structure_get_value(structure, field_name);
+    if (!G_VALUE_HOLDS_STRING(value)) {
+      GST_WARNING_OBJECT(priv->self,
+                         "Property overrides for GPAC must be strings, %s is %s",
+                         field_name,
+                         G_VALUE_TYPE_NAME(value));
+      continue;
+    }
 
-      // Parse the property value
-      const GValue* value = gst_structure_get_value(caps, field_name);
-      const gchar* prop_value = g_value_get_string(value);
+    // Check if the property value is valid
+    const gchar* prop_name = field_name + strlen(prefix);
+    const gchar* prop_value = g_value_get_string(value);
+    if (prop_value == NULL || prop_value[0] == '\0') {
+      GST_WARNING_OBJECT(priv->self, "Empty value for %s", prop_name);
+      continue;
+    }
 
-      // Check if the property value is valid
-      if (prop_value == NULL || prop_value[0] == '\0') {
-        GST_WARNING_OBJECT(priv->self, "Empty value for %s", prop_name);
-        continue;
-      }
+    GpacCapsOverride override = {
+      .prop_4cc = gf_props_get_id(prop_name),
+      .name = prop_name,
+      .value = prop_value,
+    };
+    g_array_append_val(info->overrides, override);
+
+    // The handlers of this property must not run anymore
+    for (guint j = 0; j < G_N_ELEMENTS(prop_registry); j++)
+      if (prop_registry[j].prop_4cc == override.prop_4cc)
+        info->overridden |= G_GUINT64_CONSTANT(1) << j;
+  }
+}
+
+gboolean
+gpac_pid_set_caps(GpacPadPrivate* priv, const GstCaps* caps)
+{
+  if (priv->caps && gst_caps_is_equal(priv->caps, caps))
+    return FALSE;
 
-      // Set the property
-      GF_PropertyValue pv = gf_props_parse_value(
-        gf_props_4cc_get_type(prop_4cc), prop_name, prop_value, NULL, ',');
-      gpac_return_val_if_fail(gf_filter_pid_set_property(pid, prop_4cc, &pv),
-                              FALSE);
+  gpac_pid_clear_caps(priv);
+  // Shared caps are immutable, holding a reference does not modify them
+  priv->caps = gst_caps_ref((GstCaps*)caps);
+  priv->duration_queried = FALSE;
+  if (gst_caps_get_size(caps) == 0)
+    return TRUE;
 
-      // Add the property to the to_skip list
-      *to_skip = g_list_append(*to_skip, GUINT_TO_POINTER(prop_4cc));
-    }
+  GpacCapsInfo* info = &priv->caps_info;
+  GstStructure* structure = gst_caps_get_structure(caps, 0);
+  info->media_type = g_strsplit(gst_structure_get_name(structure), "/", 2);
+  info->media = info->media_type[0];
+  info->codec = info->media ? info->media_type[1] : NULL;
+  info->stream_type = gf_stream_type_by_name(info->media);
+  info->stream_format = gst_structure_get_string(structure, "stream-format");
+
+  info->width = info->height = -1;
+  info->rate = info->channels = -1;
+  info->fps_num = info->fps_den = -1;
+  info->framed = TRUE;
+  gst_structure_get_int(structure, "width", &info->width);
+  gst_structure_get_int(structure, "height", &info->height);
+  gst_structure_get_int(structure, "rate", &info->rate);
+  gst_structure_get_int(structure, "channels", &info->channels);
+  gst_structure_get_fraction(
+    structure, "framerate", &info->fps_num, &info->fps_den);
+  gst_structure_get_boolean(structure, "framed", &info->framed);
+
+  // Raw streams also carry their sample layout
+  if (!g_strcmp0(info->codec, "x-raw")) {
+    info->is_raw = TRUE;
+    if (!g_strcmp0(info->media, "video"))
+      gst_video_info_from_caps(&info->video_info, caps);
+    info->audio_format = gst_structure_get_string(structure, "format");
   }
 
-  // If we have also processed nested structure, finish
-  if (nested)
-    goto finish;
+  const GValue* codec_data = gst_structure_get_value(structure, "codec_data");
+  if (codec_data && GST_VALUE_HOLDS_BUFFER(codec_data))
+    info->codec_data = gst_value_get_buffer(codec_data);
 
-  // Check if we have nested "gpac" structure
-  if (gst_structure_has_field(caps, "gpac")) {
-    if (!gst_structure_get(caps, "gpac", GST_TYPE_STRUCTURE, &caps, NULL)) {
+  // Collect the overrides, the nested "gpac" structure takes no prefix
+  info->overrides = g_array_new(FALSE, FALSE, sizeof(GpacCapsOverride));
+  gpac_pid_parse_overrides(priv, structure, "gpac-");
+  const GValue* nested = gst_structure_get_value(structure, "gpac");
+  if (nested) {
+    if (GST_VALUE_HOLDS_STRUCTURE(nested))
+      gpac_pid_parse_overrides(priv, gst_value_get_structure(nested), "");
+    else
       GST_ERROR_OBJECT(priv->self, "Failed to get nested gpac structure");
-      return FALSE;
-    }
-    prefix = "";
-    nested = TRUE;
-    goto retry;
   }
+  return TRUE;
+}
+
+void
+gpac_pid_clear_caps(GpacPadPrivate* priv)
+{
+  GpacCapsInfo* info = &priv->caps_info;
+  g_strfreev(info->media_type);
+  if (info->overrides)
+    g_array_unref(info->overrides);
+  memset(info, 0, sizeof(GpacCapsInfo));
+  g_clear_pointer(&priv->caps, gst_caps_unref);
+}
 
-finish:
+static gboolean
+gpac_pid_apply_overrides(GPAC_PID_PROP_IMPL_ARGS_NO_ELEMENT)
+{
+  GArray* overrides = priv->caps_info.overrides;
+  for (guint i = 0; overrides && i < overrides->len; i++) {
+    GpacCapsOverride* override =
+      &g_array_index(overrides, GpacCapsOverride, i);
+
+    // Set the property
+    GF_PropertyValue pv =
+      gf_props_parse_value(gf_props_4cc_get_type(override->prop_4cc),
+                           override->name,
+                           override->value,
+                           NULL,
+                           ',');
+    gpac_return_val_if_fail(
+      gf_filter_pid_set_property(pid, override->prop_4cc, &pv), FALSE);
+  }
+  return TRUE;
+}
+
+gboolean
+gpac_pid_set_source(GpacPadPrivate* priv, GstBuffer* buffer)
+{
+  if (gst_buffer_n_memory(buffer) != 1)
+    return FALSE;
+
+  // Buffers from anywhere else leave the last source in place
+  GPAC_PckSource* source = NULL;
+  gpac_pckmem_get_packet(gst_buffer_peek_memory(buffer, 0), &source);
+  if (!source)
+    return FALSE;
+
+  guint generation = gpac_pck_source_get_generation(source);
+  if (source == priv->source && generation == priv->source_generation)
+    return FALSE;
+
+  gpac_pck_source_unref(priv->source);
+  priv->source = gpac_pck_source_ref(source);
+  priv->source_generation = generation;
   return TRUE;
 }
 
@@ -105,10 +199,21 @@ gpac_pid_reconfigure(GPAC_PID_PROP_IMPL_ARGS)
   // Lock the element
   GST_OBJECT_AUTO_LOCK(element, auto_lock);
 
+  // Start from the properties of the upstream gpac PID, the pad only fills in
+  // what they lack. The copy replaces all properties, so apply all we know
+  if (HAS_FLAG(priv->flags, GPAC_PAD_SOURCE_SET) &&
+      gpac_pck_source_copy_properties(priv->source, pid)) {
+    if (priv->caps)
+      priv->flags |= GPAC_PAD_CAPS_SET;
+    if (priv->tags)
+      priv->flags |= GPAC_PAD_TAGS_SET;
+    if (priv->segment)
+      priv->flags |= GPAC_PAD_SEGMENT_SET;
+  }
+
   // Go through overrides if caps are set
-  g_autoptr(GList) to_skip = g_list_alloc();
   if (HAS_FLAG(priv->flags, GPAC_PAD_CAPS_SET)) {
-    if (!gpac_pid_apply_overrides(priv, pid, &to_skip)) {
+    if (!gpac_pid_apply_overrides(priv, pid)) {
       GST_ERROR_OBJECT(priv->self, "Failed to apply overrides");
       return FALSE;
     }
@@ -118,8 +223,8 @@ gpac_pid_reconfigure(GPAC_PID_PROP_IMPL_ARGS)
   for (u32 i = 0; i < gpac_pid_get_num_supported_props(); i++) {
     prop_registry_entry* entry = &prop_registry[i];
 
-    // Skip the property if it is in the to_skip list
-    if (g_list_find(to_skip, GUINT_TO_POINTER(entry->prop_4cc)))
+    // Skip the property if it was overridden
+    if (priv->caps_info.overridden & (G_GUINT64_CONSTANT(1) << i))
       continue;
 
     // Try each handler
@@ -160,6 +265,8 @@ gpac_pid_reconfigure(GPAC_PID_PROP_IMPL_ARGS)
     return FALSE;
   }
 
+  // Resolve the parameters used for every packet on this pid
+  gpac_pck_cache_pid_params(element, priv, pid);
   return TRUE;
 }
 
@@ -31,4 +31,8 @@ typedef struct
 {
   post_process_registry_entry* entry;
   void* private_ctx;
+  // Lets downstream gpac elements pick up the properties of the PID
+  GPAC_PckSource* source;
+  // Pad the output is pushed on, assigned by the element on first output
+  GstPad* src_pad;
 } GPAC_MemOutPIDContext;
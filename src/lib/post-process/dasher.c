@@ -27,6 +27,8 @@
 #include "gpacmessages.h"
 #include "lib/memio.h"
 #include "lib/signals.h"
+#include "lib/store.h"
+#include "lib/time.h"
 
 #include <gio/gio.h>
 #include <gpac/mpd.h>
@@ -37,16 +39,38 @@ GST_DEBUG_CATEGORY_STATIC(gpac_dasher);
 
 typedef struct
 {
-  gchar* name;        // Name of the file
-  GFile* file;        // GFile object for the file (optional)
-  GOutputStream* out; // Output stream for the file
-} FileAbstract;
+  gchar* name;
+  GPAC_StoreEntryType type;
+
+  // At most one of them is set, depending on where the file goes. With
+  // neither, the data is only handed out through the segment-chunk signal
+  GPAC_WriterFile* file;  // written by the writer pool
+  GPAC_StoreEntry* entry; // kept in the segment store
+
+  // Description of the data written so far
+  guint64 size;
+  gboolean timed;
+  guint64 start; // PTS range, in the PID timescale
+  guint64 end;
+  GF_FilterSAPType sap; // of the first packet
+  GArray* parts;        // offsets where the byte-range parts start, or NULL
+} DasherOutput;
+
+#define DASHER_OUTPUT_IS_OPEN(out) ((out)->name != NULL)
 
 typedef struct
 {
   // current file being processed
-  FileAbstract* main_file;
-  FileAbstract* llhls_file; // for low-latency HLS chunks
+  DasherOutput main_file;
+  DasherOutput llhls_file; // for low-latency HLS chunks
+
+  // File operations of this PID, run in order on the writer pool
+  GPAC_WriterLane* lane;
+  // Files only handed out over the segment-chunk signal, never on disk
+  GHashTable* handed_out;
+
+  // Converts the packet timestamps for the signals
+  GPAC_TimeConverter to_gst;
 
   gchar* llhas_template;
   gboolean is_manifest;
@@ -59,35 +83,35 @@ dasher_ctx_init(void** process_ctx)
 {
   *process_ctx = g_new0(DasherCtx, 1);
   DasherCtx* ctx = (DasherCtx*)*process_ctx;
+  ctx->handed_out =
+    g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
 
   GST_DEBUG_CATEGORY_INIT(
     gpac_dasher, "gpacdasherpp", 0, "GPAC dasher post-processor");
 }
 
-void
-dasher_free_file(FileAbstract* file)
-{
-  if (file) {
-    if (file->out) {
-      g_output_stream_close(file->out, NULL, NULL);
-      g_object_unref(file->out);
-    }
-    if (file->file) {
-      g_object_unref(file->file);
-    }
-    g_free(file->name);
-    g_free(file);
-  }
-}
-
 void
 dasher_ctx_free(void* process_ctx)
 {
   DasherCtx* ctx = (DasherCtx*)process_ctx;
 
-  // Free the main file if it exists
-  dasher_free_file(ctx->main_file);
-  dasher_free_file(ctx->llhls_file);
+  // Close the open files and wait for the pending writes
+  if (ctx->lane) {
+    if (ctx->main_file.file)
+      gpac_writer_close(ctx->lane, ctx->main_file.file, NULL, NULL, NULL);
+    if (ctx->llhls_file.file)
+      gpac_writer_close(ctx->lane, ctx->llhls_file.file, NULL, NULL, NULL);
+    gpac_writer_lane_free(ctx->lane);
+  }
+
+  // Incomplete entries never reach the store
+  gpac_store_entry_discard(ctx->main_file.entry);
+  gpac_store_entry_discard(ctx->llhls_file.entry);
+  if (ctx->main_file.parts)
+    g_array_unref(ctx->main_file.parts);
+  g_free(ctx->main_file.name);
+  g_free(ctx->llhls_file.name);
+  g_hash_table_unref(ctx->handed_out);
 
   // Free the llhas template if it exists
   if (ctx->llhas_template)
@@ -100,17 +124,29 @@ dasher_ctx_free(void* process_ctx)
 GF_Err
 dasher_configure_pid(GF_Filter* filter, GF_FilterPid* pid)
 {
+  GPAC_MemIoContext* io_ctx = (GPAC_MemIoContext*)gf_filter_get_rt_udta(filter);
   GPAC_MemOutPIDContext* ctx =
     (GPAC_MemOutPIDContext*)gf_filter_pid_get_udta(pid);
   DasherCtx* dasher_ctx = (DasherCtx*)ctx->private_ctx;
   GPAC_MemOutPIDFlags udta_flags = gf_filter_pid_get_udta_flags(pid);
 
+  // Each PID writes through its own lane of the shared pool
+  if (!dasher_ctx->lane) {
+    if (!io_ctx->writers)
+      io_ctx->writers = gpac_writer_pool_new(GPAC_WRITER_POOL_THREADS);
+    dasher_ctx->lane = gpac_writer_lane_new(io_ctx->writers);
+  }
+
   // We'll transfer the data over signals
   udta_flags |= GPAC_MEMOUT_PID_FLAG_DONT_CONSUME;
   gf_filter_pid_set_udta_flags(pid, udta_flags);
 
   const GF_PropertyValue* p =
-    gf_filter_pid_get_property(pid, GF_PROP_PID_IS_MANIFEST);
+    gf_filter_pid_get_property(pid, GF_PROP_PID_TIMESCALE);
+  gpac_time_converter_init(
+    &dasher_ctx->to_gst, p ? p->value.uint : 0, GST_SECOND);
+
+  p = gf_filter_pid_get_property(pid, GF_PROP_PID_IS_MANIFEST);
   if (p && p->value.uint)
     dasher_ctx->is_manifest = TRUE;
   else
@@ -149,33 +185,137 @@ dasher_process_event(GF_Filter* filter, const GF_FilterEvent* evt)
                      gf_filter_pid_get_name(evt->base.on_pid),
                      evt->file_del.url);
 
+    // Files kept in memory are only known to the store
+    if (io_ctx->sess->store &&
+        gpac_store_remove(io_ctx->sess->store, evt->file_del.url))
+      return GF_TRUE;
+
     gboolean sent = gpac_signal_try_emit(io_ctx->sess->element,
                                          GPAC_SIGNAL_DASHER_DELETE_SEGMENT,
                                          evt->file_del.url,
                                          NULL);
 
-    if (!sent) {
-      GFile* file = g_file_new_for_path(evt->file_del.url);
-      GError* error = NULL;
-      if (!g_file_delete(file, NULL, &error)) {
-        GST_ELEMENT_WARNING(io_ctx->sess->element,
-                            RESOURCE,
-                            FAILED,
-                            (NULL),
-                            ("Failed to delete file %s: %s",
-                             evt->file_del.url,
-                             error ? error->message : "Unknown error"));
-        if (error)
-          g_error_free(error);
-      }
-      g_object_unref(file);
-    }
+    // Nothing was written for files that were only handed out
+    if (g_hash_table_remove(dasher_ctx->handed_out, evt->file_del.url))
+      return GF_TRUE;
+
+    // Failures are reported as warnings on the next check of the lane
+    if (!sent)
+      gpac_writer_delete(dasher_ctx->lane, evt->file_del.url);
 
     return GF_TRUE;
   }
   return GF_FALSE;
 }
 
+static const gchar*
+dasher_output_type_name(GPAC_StoreEntryType type)
+{
+  switch (type) {
+    case GPAC_STORE_ENTRY_MANIFEST:
+      return "manifest";
+    case GPAC_STORE_ENTRY_INIT:
+      return "init";
+    case GPAC_STORE_ENTRY_PART:
+      return "part";
+    default:
+      return "segment";
+  }
+}
+
+// Report of a completed file, emitted once its data can be read back
+typedef struct
+{
+  GstElement* element;
+  gchar* name;
+  GstStructure* info;
+} DasherReady;
+
+static void
+dasher_ready_emit(gboolean ok, gpointer user_data)
+{
+  DasherReady* ready = user_data;
+
+  // The failure is reported when the lane is checked
+  if (ok)
+    gpac_signal_try_notify(ready->element,
+                           GPAC_SIGNAL_DASHER_SEGMENT_READY,
+                           ready->name,
+                           ready->info);
+}
+
+static void
+dasher_ready_free(gpointer user_data)
+{
+  DasherReady* ready = user_data;
+  gst_object_unref(ready->element);
+  gst_structure_free(ready->info);
+  g_free(ready->name);
+  g_free(ready);
+}
+
+static DasherReady*
+dasher_ready_new(GF_Filter* filter, GF_FilterPid* pid, DasherOutput* file)
+{
+  GPAC_MemIoContext* io_ctx = (GPAC_MemIoContext*)gf_filter_get_rt_udta(filter);
+  GPAC_MemOutPIDContext* ctx =
+    (GPAC_MemOutPIDContext*)gf_filter_pid_get_udta(pid);
+  DasherCtx* dasher_ctx = (DasherCtx*)ctx->private_ctx;
+
+  if (!gpac_signal_is_connected(io_ctx->sess->element,
+                                GPAC_SIGNAL_DASHER_SEGMENT_READY))
+    return NULL;
+
+  GstClockTime pts = GST_CLOCK_TIME_NONE;
+  GstClockTime duration = GST_CLOCK_TIME_NONE;
+  if (file->timed) {
+    pts = gpac_time_converter_apply(&dasher_ctx->to_gst, file->start);
+    duration =
+      gpac_time_converter_apply(&dasher_ctx->to_gst, file->end) - pts;
+  }
+
+  GstStructure* info = gst_structure_new("segment-ready",
+                                         "type",
+                                         G_TYPE_STRING,
+                                         dasher_output_type_name(file->type),
+                                         "size",
+                                         G_TYPE_UINT64,
+                                         file->size,
+                                         "pts",
+                                         G_TYPE_UINT64,
+                                         pts,
+                                         "duration",
+                                         G_TYPE_UINT64,
+                                         duration,
+                                         "starts-with-sap",
+                                         G_TYPE_BOOLEAN,
+                                         file->sap != GF_FILTER_SAP_NONE,
+                                         "sap-type",
+                                         G_TYPE_UINT,
+                                         (guint)file->sap,
+                                         NULL);
+
+  // Where the LL-HLS parts start, whatever the file was written to
+  if (file->parts) {
+    GValue offsets = G_VALUE_INIT;
+    GValue offset = G_VALUE_INIT;
+    g_value_init(&offsets, GST_TYPE_ARRAY);
+    g_value_init(&offset, G_TYPE_UINT64);
+    for (guint i = 0; i < file->parts->len; i++) {
+      g_value_set_uint64(&offset, g_array_index(file->parts, guint64, i));
+      gst_value_array_append_value(&offsets, &offset);
+    }
+    gst_structure_take_value(info, "part-offsets", &offsets);
+    g_value_unset(&offset);
+  }
+
+  DasherReady* ready = g_new(DasherReady, 1);
+  ready->element = gst_object_ref(io_ctx->sess->element);
+  ready->name = g_strdup(file->name);
+  ready->info = info;
+  return ready;
+}
+
 void
 dasher_open_close_file(GF_Filter* filter,
                        GF_FilterPid* pid,
@@ -188,7 +328,7 @@ dasher_open_close_file(GF_Filter* filter,
   DasherCtx* dasher_ctx = (DasherCtx*)ctx->private_ctx;
 
   // Get a pointer to the requested file
-  FileAbstract** file = NULL;
+  DasherOutput* file = NULL;
   if (is_llhls) {
     file = &dasher_ctx->llhls_file;
   } else {
@@ -196,21 +336,39 @@ dasher_open_close_file(GF_Filter* filter,
   }
 
   // If the file is already open, close it
-  if (*file) {
+  if (DASHER_OUTPUT_IS_OPEN(file)) {
     GST_TRACE_OBJECT(io_ctx->sess->element,
                      "Closing file for PID %s: %s",
                      gf_filter_pid_get_name(pid),
-                     (*file)->name);
-    if ((*file)->out)
-      g_output_stream_close((*file)->out, NULL, NULL);
-    if ((*file)->file) {
-      g_object_unref((*file)->out);
-      g_object_unref((*file)->file);
+                     file->name);
+    DasherReady* ready = dasher_ready_new(filter, pid, file);
+    if (file->file) {
+      // Reported from the writer pool, once the file can be read back
+      gpac_writer_close(dasher_ctx->lane,
+                        file->file,
+                        ready ? dasher_ready_emit : NULL,
+                        ready,
+                        ready ? dasher_ready_free : NULL);
+      ready = NULL;
+    } else if (file->entry) {
+      // The window of the store is applied to the media time of segments
+      if (file->timed)
+        gpac_store_entry_set_time(
+          file->entry,
+          gpac_time_converter_apply(&dasher_ctx->to_gst, file->start),
+          gpac_time_converter_apply(&dasher_ctx->to_gst, file->end));
+      gpac_store_commit(io_ctx->sess->store, file->entry);
     }
 
-    g_free((*file)->name);
-    g_free(*file);
-    *file = NULL;
+    // Committed to the store or handed out already
+    if (ready) {
+      dasher_ready_emit(TRUE, ready);
+      dasher_ready_free(ready);
+    }
+    g_free(file->name);
+    if (file->parts)
+      g_array_unref(file->parts);
+    memset(file, 0, sizeof(DasherOutput));
   }
 
   if (!name)
@@ -221,62 +379,50 @@ dasher_open_close_file(GF_Filter* filter,
                    gf_filter_pid_get_name(pid),
                    name);
 
-  // Create a new file
-  *file = g_new0(FileAbstract, 1);
-  (*file)->name = g_strdup(name);
-
-  // Decide on the file flags
-  gboolean has_os = FALSE;
+  // Ask the application for an output stream first
+  GOutputStream* out = NULL;
   if (dasher_ctx->is_manifest) {
     if (g_strcmp0(name, dasher_ctx->dst) == 0) {
-      has_os = gpac_signal_try_emit(io_ctx->sess->element,
-                                    GPAC_SIGNAL_DASHER_MANIFEST,
-                                    (*file)->name,
-                                    &(*file)->out);
+      gpac_signal_try_emit(
+        io_ctx->sess->element, GPAC_SIGNAL_DASHER_MANIFEST, name, &out);
     } else {
-      has_os = gpac_signal_try_emit(io_ctx->sess->element,
-                                    GPAC_SIGNAL_DASHER_MANIFEST_VARIANT,
-                                    (*file)->name,
-                                    &(*file)->out);
+      gpac_signal_try_emit(io_ctx->sess->element,
+                           GPAC_SIGNAL_DASHER_MANIFEST_VARIANT,
+                           name,
+                           &out);
     }
   } else {
     if (g_strcmp0(name, dasher_ctx->dst) == 0) {
-      has_os = gpac_signal_try_emit(io_ctx->sess->element,
-                                    GPAC_SIGNAL_DASHER_SEGMENT_INIT,
-                                    (*file)->name,
-                                    &(*file)->out);
+      gpac_signal_try_emit(
+        io_ctx->sess->element, GPAC_SIGNAL_DASHER_SEGMENT_INIT, name, &out);
     } else {
-      has_os = gpac_signal_try_emit(io_ctx->sess->element,
-                                    GPAC_SIGNAL_DASHER_SEGMENT,
-                                    (*file)->name,
-                                    &(*file)->out);
+      gpac_signal_try_emit(
+        io_ctx->sess->element, GPAC_SIGNAL_DASHER_SEGMENT, name, &out);
     }
   }
 
-  if (!has_os) {
-    // Create a GFile and GOutputStream for the file
-    (*file)->file = g_file_new_for_path((*file)->name);
-
-    GError* error = NULL;
-    (*file)->out = G_OUTPUT_STREAM(g_file_replace(
-      (*file)->file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, &error));
-    if (!(*file)->out) {
-      GST_ELEMENT_ERROR(io_ctx->sess->element,
-                        STREAM,
-                        FAILED,
-                        (NULL),
-                        ("Failed to open output stream for file %s: %s",
-                         (*file)->name,
-                         error ? error->message : "Unknown error"));
-      g_error_free(error);
-      g_object_unref((*file)->file);
-
-      // Reset the current file pointer
-      g_free((*file)->name);
-      g_free(*file);
-      *file = NULL;
-      return;
-    }
+  file->name = g_strdup(name);
+  file->type = GPAC_STORE_ENTRY_SEGMENT;
+  if (dasher_ctx->is_manifest)
+    file->type = GPAC_STORE_ENTRY_MANIFEST;
+  else if (is_llhls)
+    file->type = GPAC_STORE_ENTRY_PART;
+  else if (g_strcmp0(name, dasher_ctx->dst) == 0)
+    file->type = GPAC_STORE_ENTRY_INIT;
+
+  // Without a stream, the data may be taken over the segment-chunk signal
+  if (out) {
+    file->file = gpac_writer_open(dasher_ctx->lane, name, out);
+  } else if (gpac_signal_is_connected(io_ctx->sess->element,
+                                      GPAC_SIGNAL_DASHER_SEGMENT_CHUNK)) {
+    g_hash_table_add(dasher_ctx->handed_out, g_strdup(name));
+    return;
+  } else if (io_ctx->sess->store) {
+    // Kept in memory if the store is enabled
+    file->entry = gpac_store_open(io_ctx->sess->store, name, file->type);
+  } else {
+    // Otherwise, the file is created on the writer pool
+    file->file = gpac_writer_open(dasher_ctx->lane, name, NULL);
   }
 }
 
@@ -314,7 +460,7 @@ dasher_ensure_file(GF_Filter* filter, GF_FilterPid* pid, gboolean is_llhls)
     (GPAC_MemOutPIDContext*)gf_filter_pid_get_udta(pid);
   DasherCtx* dasher_ctx = (DasherCtx*)ctx->private_ctx;
 
-  FileAbstract** file = NULL;
+  DasherOutput* file = NULL;
   if (is_llhls) {
     file = &dasher_ctx->llhls_file;
   } else {
@@ -322,7 +468,7 @@ dasher_ensure_file(GF_Filter* filter, GF_FilterPid* pid, gboolean is_llhls)
   }
 
   // If we don't have a file, set it up
-  if (G_UNLIKELY(!(*file))) {
+  if (G_UNLIKELY(!DASHER_OUTPUT_IS_OPEN(file))) {
     GST_ELEMENT_ERROR(
       io_ctx->sess->element,
       STREAM,
@@ -332,13 +478,42 @@ dasher_ensure_file(GF_Filter* filter, GF_FilterPid* pid, gboolean is_llhls)
     return GF_IO_ERR;
   }
 
-  if (G_UNLIKELY(!(*file)->out)) {
+  return GF_OK;
+}
+
+GF_Err
+dasher_check_lane(GF_Filter* filter, GF_FilterPid* pid)
+{
+  GPAC_MemIoContext* io_ctx = (GPAC_MemIoContext*)gf_filter_get_rt_udta(filter);
+  GPAC_MemOutPIDContext* ctx =
+    (GPAC_MemOutPIDContext*)gf_filter_pid_get_udta(pid);
+  DasherCtx* dasher_ctx = (DasherCtx*)ctx->private_ctx;
+
+  // Report what the writer pool ran into since the last check
+  GError* error = NULL;
+  GError* warning = NULL;
+  gboolean ok = gpac_writer_lane_check(dasher_ctx->lane, &error, &warning);
+
+  if (warning) {
+    GST_ELEMENT_WARNING(io_ctx->sess->element,
+                        RESOURCE,
+                        FAILED,
+                        (NULL),
+                        ("File operation failed for PID %s: %s",
+                         gf_filter_pid_get_name(pid),
+                         warning->message));
+    g_error_free(warning);
+  }
+
+  if (!ok) {
     GST_ELEMENT_ERROR(io_ctx->sess->element,
                       STREAM,
                       FAILED,
                       (NULL),
-                      ("No output stream for file %s",
-                       (*file)->name ? (*file)->name : "unknown"));
+                      ("Failed to write output for PID %s: %s",
+                       gf_filter_pid_get_name(pid),
+                       error ? error->message : "Unknown error"));
+    g_clear_error(&error);
     gf_filter_abort(filter);
     return GF_IO_ERR;
   }
@@ -346,59 +521,65 @@ dasher_ensure_file(GF_Filter* filter, GF_FilterPid* pid, gboolean is_llhls)
   return GF_OK;
 }
 
-GF_Err
+void
 dasher_write_data(GF_Filter* filter,
                   GF_FilterPid* pid,
-                  FileAbstract* file,
-                  const u8* data,
-                  u32 size)
+                  DasherOutput* file,
+                  GF_FilterPacket* pck,
+                  GBytes* data)
 {
   GPAC_MemIoContext* io_ctx = (GPAC_MemIoContext*)gf_filter_get_rt_udta(filter);
   GPAC_MemOutPIDContext* ctx =
     (GPAC_MemOutPIDContext*)gf_filter_pid_get_udta(pid);
   DasherCtx* dasher_ctx = (DasherCtx*)ctx->private_ctx;
 
-  if (!file || !file->out) {
-    GST_ELEMENT_ERROR(io_ctx->sess->element,
-                      STREAM,
-                      FAILED,
-                      (NULL),
-                      ("No output stream for file %s",
-                       file && file->name ? file->name : "unknown"));
-    return GF_IO_ERR;
+  // Keep track of what the file holds
+  guint64 offset = file->size;
+  file->size += g_bytes_get_size(data);
+  if (!offset)
+    file->sap = gf_filter_pck_get_sap(pck);
+
+  u64 cts = gf_filter_pck_get_cts(pck);
+  u64 end = cts + gf_filter_pck_get_duration(pck);
+  if (cts != GF_FILTER_NO_TS) {
+    if (!file->timed || cts < file->start)
+      file->start = cts;
+    if (!file->timed || end > file->end)
+      file->end = end;
+    file->timed = TRUE;
   }
 
-  gssize bytes_written =
-    g_output_stream_write(file->out, data, size, NULL, NULL);
-  if (bytes_written < 0) {
-    GST_ELEMENT_ERROR(io_ctx->sess->element,
-                      STREAM,
-                      FAILED,
-                      (NULL),
-                      ("Failed to write data to output stream for file %s",
-                       file->name ? file->name : "unknown"));
-    return GF_IO_ERR;
-  }
-
-  if (bytes_written < (gssize)size) {
-    GST_ELEMENT_WARNING(io_ctx->sess->element,
-                        STREAM,
-                        FAILED,
-                        (NULL),
-                        ("Partial write to output stream for file %s, "
-                         "expected: %" G_GSIZE_FORMAT
-                         ", written: %" G_GSSIZE_FORMAT,
-                         file->name ? file->name : "unknown",
-                         (gssize)size,
-                         bytes_written));
+  if (file->entry) {
+    gpac_store_entry_append(file->entry, data);
+  } else if (file->file) {
+    // Blocks only when the lane is full
+    gpac_writer_write(dasher_ctx->lane, file->file, data);
+  } else {
+    // Hand the packet data over as is
+    GstBuffer* buffer = gst_buffer_new_wrapped_bytes(data);
+    GST_BUFFER_OFFSET(buffer) = offset;
+    GST_BUFFER_OFFSET_END(buffer) = file->size;
+    if (cts != GF_FILTER_NO_TS) {
+      GST_BUFFER_PTS(buffer) =
+        gpac_time_converter_apply(&dasher_ctx->to_gst, cts);
+      GST_BUFFER_DURATION(buffer) =
+        gpac_time_converter_apply(&dasher_ctx->to_gst, end) -
+        GST_BUFFER_PTS(buffer);
+    }
+    if (gf_filter_pck_get_sap(pck) == GF_FILTER_SAP_NONE)
+      GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+
+    gpac_signal_try_notify(io_ctx->sess->element,
+                           GPAC_SIGNAL_DASHER_SEGMENT_CHUNK,
+                           file->name,
+                           buffer);
+    gst_buffer_unref(buffer);
   }
 
   GST_TRACE_OBJECT(io_ctx->sess->element,
-                   "Wrote %s, size: %" G_GSIZE_FORMAT,
-                   file->name ? file->name : "unknown",
-                   (gssize)size);
-
-  return GF_OK;
+                   "Queued write to %s, size: %" G_GSIZE_FORMAT,
+                   file->name,
+                   g_bytes_get_size(data));
 }
 
 GF_Err
@@ -411,10 +592,17 @@ dasher_post_process(GF_Filter* filter, GF_FilterPid* pid, GF_FilterPacket* pck)
   const GF_PropertyValue* fname;
   const GF_PropertyValue* p;
 
+  // Surface the failures of the previous writes
+  gpac_return_if_fail(dasher_check_lane(filter, pid));
+
   if (!pck) {
     if (gf_filter_pid_is_eos(pid) && !gf_filter_pid_is_flush_eos(pid)) {
       dasher_open_close_file(filter, pid, NULL, FALSE);
       dasher_open_close_file(filter, pid, NULL, TRUE);
+
+      // Files must be complete before the end of stream is reported
+      gpac_writer_lane_flush(dasher_ctx->lane);
+      return dasher_check_lane(filter, pid);
     }
     return GF_OK; // No packet to process
   }
@@ -438,7 +626,7 @@ dasher_post_process(GF_Filter* filter, GF_FilterPid* pid, GF_FilterPacket* pck)
 
   if (start) {
     // Previous file has ended, move to the next file
-    if (dasher_ctx->main_file)
+    if (DASHER_OUTPUT_IS_OPEN(&dasher_ctx->main_file))
       dasher_open_close_file(filter, pid, NULL, FALSE);
 
     const GF_PropertyValue* ext;
@@ -463,7 +651,7 @@ dasher_post_process(GF_Filter* filter, GF_FilterPid* pid, GF_FilterPacket* pck)
 
     if (name) {
       dasher_open_close_file(filter, pid, name, FALSE);
-    } else if (!dasher_ctx->main_file) {
+    } else if (!DASHER_OUTPUT_IS_OPEN(&dasher_ctx->main_file)) {
       dasher_setup_file(filter, pid);
     }
 
@@ -493,9 +681,25 @@ dasher_post_process(GF_Filter* filter, GF_FilterPid* pid, GF_FilterPacket* pck)
 
   // If we are in low-latency HLS mode, we need to handle the llhas chunks
   p = gf_filter_pck_get_property(pck, GF_PROP_PCK_LLHAS_FRAG_NUM);
-  if (p) {
+  if (p && !dasher_ctx->llhas_template) {
+    // Parts are byte ranges of the segment (llhls=br), the data is written
+    // once and only the part boundary is recorded
+    DasherOutput* file = &dasher_ctx->main_file;
+    GST_TRACE_OBJECT(io_ctx->sess->element,
+                     "Part %u starts in %s at %" G_GUINT64_FORMAT,
+                     p->value.uint,
+                     file->name,
+                     file->size);
+    if (!file->parts)
+      file->parts = g_array_new(FALSE, FALSE, sizeof(guint64));
+    g_array_append_val(file->parts, file->size);
+    if (file->entry)
+      gpac_store_entry_mark_part(file->entry, p->value.uint);
+  } else if (p) {
     char* llhas_chunkname = gf_mpd_resolve_subnumber(
-      dasher_ctx->llhas_template, dasher_ctx->main_file->name, p->value.uint);
+      dasher_ctx->llhas_template,
+      dasher_ctx->main_file.name,
+      p->value.uint);
     dasher_open_close_file(
       filter, pid, llhas_chunkname, TRUE); // Open the llhls file
     gf_free(llhas_chunkname);
@@ -504,14 +708,19 @@ dasher_post_process(GF_Filter* filter, GF_FilterPid* pid, GF_FilterPacket* pck)
     gpac_return_if_fail(dasher_ensure_file(filter, pid, TRUE));
   }
 
-  // Write the data to the output stream
-  gpac_return_if_fail(
-    dasher_write_data(filter, pid, dasher_ctx->main_file, data, size));
-  if (dasher_ctx->llhls_file) {
+  // The packet is kept alive until the writer pool or the store is done with
+  // its data
+  gf_filter_pck_ref(&pck);
+  GBytes* bytes = g_bytes_new_with_free_func(
+    data, size, (GDestroyNotify)gf_filter_pck_unref, pck);
+
+  // Queue the data to the output files
+  dasher_write_data(filter, pid, &dasher_ctx->main_file, pck, bytes);
+  if (DASHER_OUTPUT_IS_OPEN(&dasher_ctx->llhls_file)) {
     // Write to the llhls file if it exists
-    gpac_return_if_fail(
-      dasher_write_data(filter, pid, dasher_ctx->llhls_file, data, size));
+    dasher_write_data(filter, pid, &dasher_ctx->llhls_file, pck, bytes);
   }
+  g_bytes_unref(bytes);
 
   // Close the output stream
   if (end && dasher_ctx->is_manifest)
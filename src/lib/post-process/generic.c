@@ -75,21 +75,13 @@ generic_post_process(GF_Filter* filter, GF_FilterPid* pid, GF_FilterPacket* pck)
   if (!pck)
     return GF_OK;
 
-  // Get the data
+  // Wrap the packet in a recycled buffer
+  GPAC_PckMemPool* pckmem = gpac_memio_get_pckmem(filter);
   u32 size;
-  const u8* data = gf_filter_pck_get_data(pck, &size);
-  gf_filter_pck_ref(&pck);
-
-  // Create a new buffer
-  GstBuffer* buffer =
-    gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY,           // flags
-                                (u8*)data,                          // data
-                                size,                               // maxsize
-                                0,                                  // offset
-                                size,                               // size
-                                pck,                                // user_data
-                                (GDestroyNotify)gf_filter_pck_unref // notify
-    );
+  gf_filter_pck_get_data(pck, &size);
+  GstBuffer* buffer = gpac_pckmem_pool_new_buffer(pckmem);
+  gst_buffer_append_memory(
+    buffer, gpac_pckmem_pool_wrap(pckmem, ctx->source, pck, 0, size));
 
   // Enqueue the buffer
   g_queue_push_tail(generic_ctx->output_queue, buffer);
@@ -64,37 +64,78 @@ struct BoxMapping
 
 typedef struct
 {
-  GstBuffer* buffer;
+  GPtrArray* mems; // Shared slices of GPAC packets, kept across resets
+  gboolean active;
+  gsize size;
+  GstClockTime pts;
+  GstClockTime dts;
+  GstClockTime duration;
+} MemoryChain;
+
+typedef struct
+{
+  guint index;
+  gsize offset;
+} MemoryCursor;
+
+typedef struct
+{
+  MemoryChain chain;
   gboolean is_complete;
 } BufferContents;
 
 typedef struct
 {
+  GList link; // Embedded queue link, avoids an allocation per box
   guint32 box_type;
-  guint32 box_size;
-  GstBuffer* buffer;
+  guint64 box_size; // 0 until the header is complete
+  guint8 header[16];
+  guint32 header_size;
+  MemoryChain chain;
   gboolean parsed;
 } BoxInfo;
 
+typedef struct
+{
+  MemoryChain* chain;
+  MemoryCursor cursor;
+  guint64 pos;
+  GstMemory* mapped;
+  GstMapInfo map;
+  gboolean error;
+} BoxReader;
+
 typedef struct
 {
   guint32 track_id;
   guint32 timescale;
+  GPAC_TimeConverter to_gst;
   gboolean defaults_present;
   guint32 default_sample_duration;
   guint32 default_sample_size;
   guint32 default_sample_flags;
 } TrackInfo;
 
+#define MP4MX_OFFSET_NONE G_MAXUINT64
+
 typedef struct
 {
   gboolean is_sync;
   gssize size;
+  guint64 offset; // From the start of the moof, or MP4MX_OFFSET_NONE
   guint64 pts;
   guint64 dts;
   guint64 duration;
 } SampleInfo;
 
+typedef struct
+{
+  guint32 track_id;
+  guint first; // Index of the first sample in next_samples
+  guint count;
+  gboolean has_sync;
+} TrafInfo;
+
 typedef struct
 {
   // Output queue for complete fragments
@@ -106,6 +147,8 @@ typedef struct
 
   // Box parser state
   GQueue* box_queue;
+  GQueue* box_pool;
+  guint32 mdat_header_size;
 
   // Buffer contents for the init, header, and data
   BufferContents* contents[3];
@@ -113,10 +156,195 @@ typedef struct
   // Input context
   guint64 duration;
   guint64 mp4mx_ts;
+  GPAC_TimeConverter mp4mx_to_gst;
   GHashTable* tracks;
+  guint64 moof_size;
+  GArray* trafs;
+  GArray* traf_next; // Next sample of every traf, while slicing the mdat
   GArray* next_samples;
+  GArray* ticks; // Timestamps of a run in the track timescale, 3 per sample
 } Mp4mxCtx;
 
+// #MARK: Memory Chain
+void
+mp4mx_chain_start(MemoryChain* chain, GF_FilterPacket* pck)
+{
+  if (!chain->mems)
+    chain->mems =
+      g_ptr_array_new_with_free_func((GDestroyNotify)gst_memory_unref);
+  chain->active = TRUE;
+  chain->size = 0;
+
+  // Preserve the timing information
+  chain->pts = gf_filter_pck_get_cts(pck);
+  chain->dts = gf_filter_pck_get_dts(pck);
+  chain->duration = gf_filter_pck_get_duration(pck);
+}
+
+void
+mp4mx_chain_append(MemoryChain* chain, GstMemory* mem)
+{
+  g_ptr_array_add(chain->mems, mem);
+  chain->size += gst_memory_get_sizes(mem, NULL, NULL);
+}
+
+void
+mp4mx_chain_move(MemoryChain* dst, MemoryChain* src)
+{
+  // The first chain moved in decides the timing
+  if (!dst->active) {
+    if (!dst->mems)
+      dst->mems =
+        g_ptr_array_new_with_free_func((GDestroyNotify)gst_memory_unref);
+    dst->active = TRUE;
+    dst->size = 0;
+    dst->pts = src->pts;
+    dst->dts = src->dts;
+    dst->duration = src->duration;
+  }
+
+  for (guint i = 0; i < src->mems->len; i++)
+    g_ptr_array_add(dst->mems, g_ptr_array_index(src->mems, i));
+  dst->size += src->size;
+
+  // The memories are owned by the destination now
+  g_ptr_array_set_free_func(src->mems, NULL);
+  g_ptr_array_set_size(src->mems, 0);
+  g_ptr_array_set_free_func(src->mems, (GDestroyNotify)gst_memory_unref);
+  src->active = FALSE;
+  src->size = 0;
+}
+
+void
+mp4mx_chain_reset(MemoryChain* chain)
+{
+  if (chain->mems)
+    g_ptr_array_set_size(chain->mems, 0);
+  chain->active = FALSE;
+  chain->size = 0;
+}
+
+void
+mp4mx_chain_clear(MemoryChain* chain)
+{
+  if (chain->mems)
+    g_ptr_array_unref(chain->mems);
+  chain->mems = NULL;
+  chain->active = FALSE;
+  chain->size = 0;
+}
+
+static inline GstMemory*
+mp4mx_chain_peek(MemoryChain* chain, MemoryCursor* cursor, gsize* avail)
+{
+  if (!chain->mems || cursor->index >= chain->mems->len)
+    return NULL;
+  GstMemory* mem = g_ptr_array_index(chain->mems, cursor->index);
+  *avail = gst_memory_get_sizes(mem, NULL, NULL) - cursor->offset;
+  return mem;
+}
+
+static inline void
+mp4mx_chain_advance(MemoryCursor* cursor, gsize taken, gsize avail)
+{
+  if (taken == avail) {
+    cursor->index++;
+    cursor->offset = 0;
+  } else {
+    cursor->offset += taken;
+  }
+}
+
+static gboolean
+mp4mx_chain_copy(MemoryChain* chain,
+                 MemoryCursor* cursor,
+                 gsize size,
+                 GstBuffer* dst)
+{
+  GstMemory* block = gst_allocator_alloc(NULL, size, NULL);
+  GstMapInfo out;
+  if (!gst_memory_map(block, &out, GST_MAP_WRITE)) {
+    gst_memory_unref(block);
+    return FALSE;
+  }
+
+  gsize written = 0;
+  while (written < size) {
+    gsize avail;
+    GstMemory* mem = mp4mx_chain_peek(chain, cursor, &avail);
+    GstMapInfo in;
+    if (!mem || !gst_memory_map(mem, &in, GST_MAP_READ))
+      break;
+
+    gsize take = MIN(avail, size - written);
+    memcpy(out.data + written, in.data + cursor->offset, take);
+    gst_memory_unmap(mem, &in);
+
+    mp4mx_chain_advance(cursor, take, avail);
+    written += take;
+  }
+
+  gst_memory_unmap(block, &out);
+  if (written < size) {
+    gst_memory_unref(block);
+    return FALSE;
+  }
+
+  gst_buffer_append_memory(dst, block);
+  return TRUE;
+}
+
+/*
+ * Reads the next size bytes of the chain at the cursor and appends them to dst
+ * as shared slices. A NULL dst only advances the cursor. If the slice would
+ * not fit the memory limit of dst, the remainder is copied into a single block
+ * so that GStreamer never merges the whole buffer behind our back.
+ */
+gboolean
+mp4mx_chain_read(MemoryChain* chain,
+                 MemoryCursor* cursor,
+                 gsize size,
+                 GstBuffer* dst)
+{
+  guint max_mems = gst_buffer_get_max_memory();
+
+  while (size) {
+    gsize avail;
+    GstMemory* mem = mp4mx_chain_peek(chain, cursor, &avail);
+    if (!mem)
+      return FALSE;
+
+    gsize take = MIN(avail, size);
+    if (dst) {
+      // Only one slot left while the slice continues
+      if (take < size && gst_buffer_n_memory(dst) + 1 >= max_mems)
+        return mp4mx_chain_copy(chain, cursor, size, dst);
+
+      gst_buffer_append_memory(dst,
+                               gst_memory_share(mem, cursor->offset, take));
+    }
+
+    mp4mx_chain_advance(cursor, take, avail);
+    size -= take;
+  }
+
+  return TRUE;
+}
+
+GstBuffer*
+mp4mx_chain_to_buffer(GPAC_PckMemPool* pckmem, MemoryChain* chain)
+{
+  GstBuffer* buffer = gpac_pckmem_pool_new_buffer(pckmem);
+  MemoryCursor cursor = { 0, 0 };
+  mp4mx_chain_read(chain, &cursor, chain->size, buffer);
+
+  GST_BUFFER_PTS(buffer) = chain->pts;
+  GST_BUFFER_DTS(buffer) = chain->dts;
+  GST_BUFFER_DURATION(buffer) = chain->duration;
+  return buffer;
+}
+
+// #MARK: Post-Processor
 void
 mp4mx_ctx_init(void** process_ctx)
 {
@@ -131,11 +359,18 @@ mp4mx_ctx_init(void** process_ctx)
   ctx->current_type = INIT;
   ctx->segment_count = 0;
   ctx->box_queue = g_queue_new();
+  ctx->box_pool = g_queue_new();
+  ctx->mdat_header_size = 8;
+  ctx->mp4mx_ts = GST_SECOND;
+  gpac_time_converter_init(&ctx->mp4mx_to_gst, GST_SECOND, GST_SECOND);
 
   // Allocate tracks and next samples
   ctx->tracks =
     g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+  ctx->trafs = g_array_new(FALSE, TRUE, sizeof(TrafInfo));
+  ctx->traf_next = g_array_new(FALSE, TRUE, sizeof(guint));
   ctx->next_samples = g_array_new(FALSE, TRUE, sizeof(SampleInfo));
+  ctx->ticks = g_array_new(FALSE, FALSE, sizeof(guint64));
 
   // Initialize the buffer contents
   for (guint i = 0; i < LAST; i++) {
@@ -154,24 +389,30 @@ mp4mx_ctx_free(void* process_ctx)
     gst_buffer_unref((GstBuffer*)g_queue_pop_head(ctx->output_queue));
   g_queue_free(ctx->output_queue);
 
-  // Free the box queue
-  while (!g_queue_is_empty(ctx->box_queue)) {
-    BoxInfo* buf = g_queue_pop_head(ctx->box_queue);
-    if (buf->buffer)
-      gst_buffer_unref(buf->buffer);
+  // Free the box queue and the recycled boxes
+  GList* link;
+  while ((link = g_queue_pop_head_link(ctx->box_queue)))
+    g_queue_push_tail_link(ctx->box_pool, link);
+  while ((link = g_queue_pop_head_link(ctx->box_pool))) {
+    BoxInfo* box = link->data;
+    mp4mx_chain_clear(&box->chain);
+    g_free(box);
   }
   g_queue_free(ctx->box_queue);
+  g_queue_free(ctx->box_pool);
 
   // Free the buffer contents
   for (guint i = 0; i < LAST; i++) {
-    if (ctx->contents[i]->buffer)
-      gst_buffer_unref(ctx->contents[i]->buffer);
+    mp4mx_chain_clear(&ctx->contents[i]->chain);
     g_free(ctx->contents[i]);
   }
 
   // Free the tracks and next samples
   g_hash_table_destroy(ctx->tracks);
+  g_array_free(ctx->trafs, TRUE);
+  g_array_free(ctx->traf_next, TRUE);
   g_array_free(ctx->next_samples, TRUE);
+  g_array_free(ctx->ticks, TRUE);
 
   // Free the context
   g_free(ctx);
@@ -190,6 +431,8 @@ mp4mx_configure_pid(GF_Filter* filter, GF_FilterPid* pid)
     gf_filter_pid_get_property(pid, GF_PROP_PID_TIMESCALE);
   if (p)
     mp4mx_ctx->mp4mx_ts = p->value.uint;
+  gpac_time_converter_init(
+    &mp4mx_ctx->mp4mx_to_gst, mp4mx_ctx->mp4mx_ts, GST_SECOND);
 
   return GF_OK;
 }
@@ -201,251 +444,427 @@ mp4mx_process_event(GF_Filter* filter, const GF_FilterEvent* evt)
 }
 
 GstMemory*
-mp4mx_create_memory(const u8* data, guint32 size, GF_FilterPacket* pck)
+mp4mx_create_memory(GstMemory* root, guint32 offset, guint32 size)
+{
+  return gst_memory_share(root, offset, size);
+}
+
+// #MARK: Box Records
+BoxInfo*
+mp4mx_box_acquire(Mp4mxCtx* mp4mx_ctx, GF_FilterPacket* pck)
 {
-  gf_filter_pck_ref(&pck);
-  return gst_memory_new_wrapped(GST_MEMORY_FLAG_READONLY,
-                                (gpointer)data,
-                                size,
-                                0,
-                                size,
-                                pck,
-                                (GDestroyNotify)gf_filter_pck_unref);
+  GList* link = g_queue_pop_head_link(mp4mx_ctx->box_pool);
+  BoxInfo* box = link ? link->data : g_new0(BoxInfo, 1);
+  box->link.data = box;
+  box->box_type = 0;
+  box->box_size = 0;
+  box->header_size = 0;
+  box->parsed = FALSE;
+  mp4mx_chain_start(&box->chain, pck);
+  return box;
+}
+
+void
+mp4mx_box_release(Mp4mxCtx* mp4mx_ctx, GList* link)
+{
+  BoxInfo* box = link->data;
+  mp4mx_chain_reset(&box->chain);
+  g_queue_push_tail_link(mp4mx_ctx->box_pool, link);
 }
 
 gboolean
 mp4mx_is_box_complete(BoxInfo* box)
 {
-  return box && box->buffer &&
-         gst_buffer_get_size(box->buffer) == box->box_size;
+  return box && box->box_size && box->chain.size == box->box_size;
 }
 
-GF_Err
-mp4mx_parse_moov(GF_Filter* filter, GF_FilterPid* pid, GstBuffer* buffer)
+/*
+ * Collects the box header from data, which may be split over several packets.
+ * Returns TRUE once the header is complete, used is set to the number of bytes
+ * consumed from data for the header so far.
+ */
+gboolean
+mp4mx_box_parse_header(BoxInfo* box,
+                       const u8* data,
+                       guint32 avail,
+                       guint32* used)
 {
-  GPAC_MemIoContext* ctx = (GPAC_MemIoContext*)gf_filter_get_rt_udta(filter);
-  GPAC_MemOutPIDContext* pctx =
-    (GPAC_MemOutPIDContext*)gf_filter_pid_get_udta(pid);
-  Mp4mxCtx* mp4mx_ctx = (Mp4mxCtx*)pctx->private_ctx;
+  *used = 0;
+  while (TRUE) {
+    // A 32-bit size of 1 means a 64-bit largesize follows the type
+    guint32 needed = 8;
+    if (box->header_size >= 4 && GST_READ_UINT32_BE(box->header) == 1)
+      needed = 16;
+    if (box->header_size >= needed)
+      break;
 
-  // Map the buffer
-  g_auto(GstBufferMapInfo) map = GST_MAP_INFO_INIT;
-  if (G_UNLIKELY(!gst_buffer_map(buffer, &map, GST_MAP_READ))) {
-    GST_ELEMENT_ERROR(ctx->sess->element,
-                      STREAM,
-                      FAILED,
-                      (NULL),
-                      ("Failed to map moov buffer"));
-    return GF_CORRUPTED_DATA;
+    guint32 take = MIN(needed - box->header_size, avail - *used);
+    if (!take)
+      return FALSE;
+    memcpy(box->header + box->header_size, data + *used, take);
+    box->header_size += take;
+    *used += take;
   }
 
-  // Parse the box
-  GF_BitStream* bs = gf_bs_new(map.data, map.size, GF_BITSTREAM_READ);
-  GF_Box* moov = NULL;
-  GF_Err err = gf_isom_box_parse(&moov, bs);
-  if (err != GF_OK) {
-    GST_ELEMENT_ERROR(
-      ctx->sess->element, STREAM, FAILED, (NULL), ("Failed to parse moov box"));
-    return GF_CORRUPTED_DATA;
-  }
+  box->box_type = GST_READ_UINT32_BE(box->header + 4);
+  if (box->header_size == 16)
+    box->box_size = GST_READ_UINT64_BE(box->header + 8);
+  else
+    box->box_size = GST_READ_UINT32_BE(box->header);
+  return TRUE;
+}
+
+// #MARK: Box Reader
+void
+mp4mx_reader_init(BoxReader* reader, MemoryChain* chain)
+{
+  memset(reader, 0, sizeof(BoxReader));
+  reader->chain = chain;
+}
+
+void
+mp4mx_reader_clear(BoxReader* reader)
+{
+  if (reader->mapped)
+    gst_memory_unmap(reader->mapped, &reader->map);
+  reader->mapped = NULL;
+}
+
+/*
+ * Reads size bytes across the memory chain into out, or skips them if out is
+ * NULL. Memories are mapped one at a time and only when their bytes are read.
+ */
+gboolean
+mp4mx_reader_read(BoxReader* reader, guint8* out, guint64 size)
+{
+  while (size && !reader->error) {
+    gsize avail;
+    GstMemory* mem = mp4mx_chain_peek(reader->chain, &reader->cursor, &avail);
+    if (!mem) {
+      reader->error = TRUE;
+      break;
+    }
 
-  // Check if we have duration in the mvhd box
-  GF_MovieHeaderBox* mvhd = (GF_MovieHeaderBox*)gf_isom_box_find_child(
-    moov->child_boxes, GF_ISOM_BOX_TYPE_MVHD);
-  if (mvhd) {
-    mp4mx_ctx->duration =
-      gf_timestamp_rescale(mvhd->duration, mvhd->timeScale, GST_SECOND);
+    gsize take = (gsize)MIN((guint64)avail, size);
+    if (out) {
+      if (mem != reader->mapped) {
+        mp4mx_reader_clear(reader);
+        if (!gst_memory_map(mem, &reader->map, GST_MAP_READ)) {
+          reader->error = TRUE;
+          break;
+        }
+        reader->mapped = mem;
+      }
+      memcpy(out, reader->map.data + reader->cursor.offset, take);
+      out += take;
+    }
+
+    mp4mx_chain_advance(&reader->cursor, take, avail);
+    reader->pos += take;
+    size -= take;
   }
 
-  // Go through all tracks
-  guint32 count = gf_list_count(moov->child_boxes);
-  for (guint32 i = 0; i < count; i++) {
-    GF_Box* box = (GF_Box*)gf_list_get(moov->child_boxes, i);
-    if (box->type != GF_ISOM_BOX_TYPE_TRAK)
-      continue;
+  return !reader->error;
+}
 
-    // Create new tracks
-    TrackInfo* track = g_new0(TrackInfo, 1);
+guint32
+mp4mx_reader_u32(BoxReader* reader)
+{
+  guint8 bytes[4];
+  if (!mp4mx_reader_read(reader, bytes, sizeof(bytes)))
+    return 0;
+  return GST_READ_UINT32_BE(bytes);
+}
+
+guint64
+mp4mx_reader_u64(BoxReader* reader)
+{
+  guint8 bytes[8];
+  if (!mp4mx_reader_read(reader, bytes, sizeof(bytes)))
+    return 0;
+  return GST_READ_UINT64_BE(bytes);
+}
 
-    // Get the track id
-    GF_TrackHeaderBox* tkhd = (GF_TrackHeaderBox*)gf_isom_box_find_child(
-      box->child_boxes, GF_ISOM_BOX_TYPE_TKHD);
-    track->track_id = tkhd->trackID;
+gboolean
+mp4mx_reader_skip_to(BoxReader* reader, guint64 pos)
+{
+  if (pos < reader->pos) {
+    reader->error = TRUE;
+    return FALSE;
+  }
+  return mp4mx_reader_read(reader, NULL, pos - reader->pos);
+}
 
-    // Get the timescale
-    GF_Box* mdia =
-      gf_isom_box_find_child(box->child_boxes, GF_ISOM_BOX_TYPE_MDIA);
-    GF_MediaHeaderBox* mdhd = (GF_MediaHeaderBox*)gf_isom_box_find_child(
-      mdia->child_boxes, GF_ISOM_BOX_TYPE_MDHD);
-    track->timescale = mdhd->timeScale;
+/*
+ * Reads the header of the next box that ends before end. Returns FALSE when
+ * there are no more boxes or the header is invalid, the latter also flags the
+ * reader.
+ */
+gboolean
+mp4mx_reader_box(BoxReader* reader,
+                 guint64 end,
+                 guint32* type,
+                 guint64* box_end)
+{
+  guint64 start = reader->pos;
+  if (reader->error || start + 8 > end)
+    return FALSE;
 
-    GST_DEBUG_OBJECT(ctx->sess->element,
-                     "Found track %d with timescale %d",
-                     track->track_id,
-                     track->timescale);
-
-    // Find the mvex for this track
-    for (guint32 j = 0; j < gf_list_count(moov->child_boxes); j++) {
-      GF_Box* mvex = (GF_Box*)gf_list_get(moov->child_boxes, j);
-      if (mvex->type != GF_ISOM_BOX_TYPE_MVEX)
-        continue;
+  guint64 size = mp4mx_reader_u32(reader);
+  *type = mp4mx_reader_u32(reader);
+  if (size == 1)
+    size = mp4mx_reader_u64(reader);
+  else if (size == 0)
+    size = end - start;
 
-      // Find the track fragment box
-      for (guint32 k = 0; k < gf_list_count(mvex->child_boxes); k++) {
-        GF_TrackExtendsBox* trex =
-          (GF_TrackExtendsBox*)gf_list_get(mvex->child_boxes, k);
-        if (trex->type != GF_ISOM_BOX_TYPE_TREX)
-          continue;
+  if (reader->error || size < reader->pos - start || size > end - start) {
+    reader->error = TRUE;
+    return FALSE;
+  }
 
-        // Check if this is the right track
-        if (trex->trackID != track->track_id)
-          continue;
+  *box_end = start + size;
+  return TRUE;
+}
 
-        // Set the defaults
-        track->defaults_present = TRUE;
-        track->default_sample_duration = trex->def_sample_duration;
-        track->default_sample_size = trex->def_sample_size;
-        track->default_sample_flags = trex->def_sample_flags;
+// #MARK: Box Parsers
+TrackInfo*
+mp4mx_get_track(Mp4mxCtx* mp4mx_ctx, guint32 track_id)
+{
+  TrackInfo* track =
+    g_hash_table_lookup(mp4mx_ctx->tracks, GUINT_TO_POINTER(track_id));
+  if (!track) {
+    track = g_new0(TrackInfo, 1);
+    track->track_id = track_id;
+    gpac_time_converter_init(&track->to_gst, 0, GST_SECOND);
+    g_hash_table_insert(mp4mx_ctx->tracks, GUINT_TO_POINTER(track_id), track);
+  }
+  return track;
+}
 
-        GST_DEBUG_OBJECT(ctx->sess->element,
-                         "Found defaults for track %d: duration: %d, size: %d, "
-                         "flags: %d",
-                         track->track_id,
-                         track->default_sample_duration,
-                         track->default_sample_size,
-                         track->default_sample_flags);
+void
+mp4mx_parse_trak(GPAC_MemIoContext* ctx,
+                 Mp4mxCtx* mp4mx_ctx,
+                 BoxReader* reader,
+                 guint64 trak_end)
+{
+  guint32 type;
+  guint64 end;
+  guint32 track_id = 0;
+  guint32 timescale = 0;
+
+  while (mp4mx_reader_box(reader, trak_end, &type, &end)) {
+    if (type == GF_ISOM_BOX_TYPE_TKHD) {
+      guint32 version = mp4mx_reader_u32(reader) >> 24;
+      mp4mx_reader_read(reader, NULL, version == 1 ? 16 : 8);
+      track_id = mp4mx_reader_u32(reader);
+    } else if (type == GF_ISOM_BOX_TYPE_MDIA) {
+      guint32 mdia_type;
+      guint64 mdia_end;
+      while (mp4mx_reader_box(reader, end, &mdia_type, &mdia_end)) {
+        if (mdia_type == GF_ISOM_BOX_TYPE_MDHD) {
+          guint32 version = mp4mx_reader_u32(reader) >> 24;
+          mp4mx_reader_read(reader, NULL, version == 1 ? 16 : 8);
+          timescale = mp4mx_reader_u32(reader);
+        }
+        mp4mx_reader_skip_to(reader, mdia_end);
       }
     }
-
-    // Add the track to the hash table
-    g_hash_table_insert(
-      mp4mx_ctx->tracks, GUINT_TO_POINTER(track->track_id), track);
+    mp4mx_reader_skip_to(reader, end);
   }
 
-  // Free the box
-  gf_isom_box_del(moov);
-  gf_bs_del(bs);
+  if (reader->error || !track_id)
+    return;
 
-  return GF_OK;
+  TrackInfo* track = mp4mx_get_track(mp4mx_ctx, track_id);
+  track->timescale = timescale;
+  gpac_time_converter_init(&track->to_gst, timescale, GST_SECOND);
+
+  GST_DEBUG_OBJECT(ctx->sess->element,
+                   "Found track %d with timescale %d",
+                   track->track_id,
+                   track->timescale);
+}
+
+void
+mp4mx_parse_trex(GPAC_MemIoContext* ctx,
+                 Mp4mxCtx* mp4mx_ctx,
+                 BoxReader* reader)
+{
+  mp4mx_reader_u32(reader); // version and flags
+  guint32 track_id = mp4mx_reader_u32(reader);
+  mp4mx_reader_u32(reader); // default_sample_description_index
+  guint32 duration = mp4mx_reader_u32(reader);
+  guint32 size = mp4mx_reader_u32(reader);
+  guint32 flags = mp4mx_reader_u32(reader);
+  if (reader->error)
+    return;
+
+  // Set the defaults
+  TrackInfo* track = mp4mx_get_track(mp4mx_ctx, track_id);
+  track->defaults_present = TRUE;
+  track->default_sample_duration = duration;
+  track->default_sample_size = size;
+  track->default_sample_flags = flags;
+
+  GST_DEBUG_OBJECT(ctx->sess->element,
+                   "Found defaults for track %d: duration: %d, size: %d, "
+                   "flags: %d",
+                   track->track_id,
+                   track->default_sample_duration,
+                   track->default_sample_size,
+                   track->default_sample_flags);
 }
 
 GF_Err
-mp4mx_parse_moof(GF_Filter* filter, GF_FilterPid* pid, GstBuffer* buffer)
+mp4mx_parse_moov(GF_Filter* filter, GF_FilterPid* pid, MemoryChain* chain)
 {
   GPAC_MemIoContext* ctx = (GPAC_MemIoContext*)gf_filter_get_rt_udta(filter);
   GPAC_MemOutPIDContext* pctx =
     (GPAC_MemOutPIDContext*)gf_filter_pid_get_udta(pid);
   Mp4mxCtx* mp4mx_ctx = (Mp4mxCtx*)pctx->private_ctx;
 
-  // Map the buffer
-  g_auto(GstBufferMapInfo) map = GST_MAP_INFO_INIT;
-  if (G_UNLIKELY(!gst_buffer_map(buffer, &map, GST_MAP_READ))) {
-    GST_ELEMENT_ERROR(ctx->sess->element,
-                      STREAM,
-                      FAILED,
-                      (NULL),
-                      ("Failed to map moof buffer"));
-    return GF_CORRUPTED_DATA;
-  }
+  BoxReader reader;
+  mp4mx_reader_init(&reader, chain);
+
+  guint32 type;
+  guint64 moov_end, end;
+  if (!mp4mx_reader_box(&reader, chain->size, &type, &moov_end))
+    goto fail;
+
+  while (mp4mx_reader_box(&reader, moov_end, &type, &end)) {
+    switch (type) {
+      case GF_ISOM_BOX_TYPE_MVHD: {
+        // Check if we have duration in the mvhd box
+        guint32 version = mp4mx_reader_u32(&reader) >> 24;
+        mp4mx_reader_read(&reader, NULL, version == 1 ? 16 : 8);
+        guint32 timescale = mp4mx_reader_u32(&reader);
+        guint64 duration = version == 1 ? mp4mx_reader_u64(&reader)
+                                        : mp4mx_reader_u32(&reader);
+        if (timescale)
+          mp4mx_ctx->duration =
+            gst_util_uint64_scale_round(duration, GST_SECOND, timescale);
+        break;
+      }
 
-  // Parse the box
-  GF_BitStream* bs = gf_bs_new(map.data, map.size, GF_BITSTREAM_READ);
-  GF_Box* moof = NULL;
-  GF_Err err = gf_isom_box_parse(&moof, bs);
-  if (err != GF_OK) {
-    GST_ELEMENT_ERROR(
-      ctx->sess->element, STREAM, FAILED, (NULL), ("Failed to parse moof box"));
-    return GF_CORRUPTED_DATA;
-  }
+      case GF_ISOM_BOX_TYPE_TRAK:
+        mp4mx_parse_trak(ctx, mp4mx_ctx, &reader, end);
+        break;
 
-  // Check if there are multiple tracks
-  guint32 count = 0;
-  for (guint32 i = 0; i < gf_list_count(moof->child_boxes); i++) {
-    GF_Box* box = (GF_Box*)gf_list_get(moof->child_boxes, i);
-    if (box->type == GF_ISOM_BOX_TYPE_TRAF)
-      count++;
-  }
-  if (count > 1) {
-    GST_FIXME_OBJECT(ctx->sess->element,
-                     "Multiple tracks in moof not supported yet");
-    return GF_NOT_SUPPORTED;
-  }
+      case GF_ISOM_BOX_TYPE_MVEX: {
+        // Find the track extends boxes
+        guint32 mvex_type;
+        guint64 mvex_end;
+        while (mp4mx_reader_box(&reader, end, &mvex_type, &mvex_end)) {
+          if (mvex_type == GF_ISOM_BOX_TYPE_TREX)
+            mp4mx_parse_trex(ctx, mp4mx_ctx, &reader);
+          mp4mx_reader_skip_to(&reader, mvex_end);
+        }
+        break;
+      }
 
-  // Find the required boxes
-  GF_Box* traf =
-    gf_isom_box_find_child(moof->child_boxes, GF_ISOM_BOX_TYPE_TRAF);
-  if (!traf) {
-    GST_DEBUG_OBJECT(ctx->sess->element, "No traf box found");
-    g_array_set_size(mp4mx_ctx->next_samples, 0);
-    goto empty_moof;
+      default:
+        break;
+    }
+    mp4mx_reader_skip_to(&reader, end);
   }
 
-  GF_TrackFragmentHeaderBox* tfhd =
-    (GF_TrackFragmentHeaderBox*)gf_isom_box_find_child(traf->child_boxes,
-                                                       GF_ISOM_BOX_TYPE_TFHD);
-  GF_TFBaseMediaDecodeTimeBox* tfdt =
-    (GF_TFBaseMediaDecodeTimeBox*)gf_isom_box_find_child(traf->child_boxes,
-                                                         GF_ISOM_BOX_TYPE_TFDT);
-  GF_TrackFragmentRunBox* trun =
-    (GF_TrackFragmentRunBox*)gf_isom_box_find_child(traf->child_boxes,
-                                                    GF_ISOM_BOX_TYPE_TRUN);
+  if (reader.error)
+    goto fail;
 
-  // Get the track info
-  TrackInfo* track =
-    g_hash_table_lookup(mp4mx_ctx->tracks, GUINT_TO_POINTER(tfhd->trackID));
-  if (!track) {
-    GST_ERROR_OBJECT(ctx->sess->element, "Track %d not found", tfhd->trackID);
-    return GF_BAD_PARAM;
-  }
+  mp4mx_reader_clear(&reader);
+  return GF_OK;
 
-  // Declare the defaults
+fail:
+  mp4mx_reader_clear(&reader);
+  GST_ELEMENT_ERROR(
+    ctx->sess->element, STREAM, FAILED, (NULL), ("Failed to parse moov box"));
+  return GF_CORRUPTED_DATA;
+}
+
+GF_Err
+mp4mx_parse_trun(GPAC_MemIoContext* ctx,
+                 Mp4mxCtx* mp4mx_ctx,
+                 BoxReader* reader,
+                 guint64 trun_end,
+                 TrackInfo* track,
+                 guint32 tfhd_flags,
+                 guint64* decode_time,
+                 guint64 base_offset,
+                 guint64* data_offset)
+{
+  // Defaults from trex, overridden by tfhd
   guint32 default_sample_duration = track->default_sample_duration;
   guint32 default_sample_size = track->default_sample_size;
   guint32 default_sample_flags = track->default_sample_flags;
 
-  // Look at the track fragment header box
-  gboolean default_sample_duration_present = (tfhd->flags & 0x8) == 0x8;
-  gboolean default_sample_size_present = (tfhd->flags & 0x10) == 0x10;
-  gboolean default_sample_flags_present = (tfhd->flags & 0x20) == 0x20;
-
-  if (default_sample_duration_present)
-    default_sample_duration = tfhd->def_sample_duration;
-  if (default_sample_size_present)
-    default_sample_size = tfhd->def_sample_size;
-  if (default_sample_flags_present)
-    default_sample_flags = tfhd->def_sample_flags;
+  // Look at the track fragment header flags
+  gboolean default_sample_duration_present = (tfhd_flags & 0x8) == 0x8;
+  gboolean default_sample_size_present = (tfhd_flags & 0x10) == 0x10;
+  gboolean default_sample_flags_present = (tfhd_flags & 0x20) == 0x20;
+
+  guint32 vf = mp4mx_reader_u32(reader);
+  guint32 version = vf >> 24;
+  guint32 flags = vf & 0xFFFFFF;
+  guint32 sample_count = mp4mx_reader_u32(reader);
+
+  gboolean data_offset_present = (flags & 0x1) == 0x1;
+  gboolean first_sample_flags_present = (flags & 0x4) == 0x4;
+  gboolean sample_duration_present = (flags & 0x100) == 0x100;
+  gboolean sample_size_present = (flags & 0x200) == 0x200;
+  gboolean sample_flags_present = (flags & 0x400) == 0x400;
+  gboolean sample_cts_present = (flags & 0x800) == 0x800;
+
+  // Samples follow the previous run unless the offset is given
+  if (data_offset_present) {
+    gint32 offset = (gint32)mp4mx_reader_u32(reader);
+    *data_offset = base_offset == MP4MX_OFFSET_NONE
+                     ? MP4MX_OFFSET_NONE
+                     : (guint64)((gint64)base_offset + offset);
+  }
+  guint32 first_sample_flags = 0;
+  if (first_sample_flags_present)
+    first_sample_flags = mp4mx_reader_u32(reader);
+
+  // Make sure the sample count fits the box before growing the array
+  guint64 entry_bytes = 4 * (sample_duration_present + sample_size_present +
+                             sample_flags_present + sample_cts_present);
+  if (reader->error || reader->pos + entry_bytes * sample_count > trun_end)
+    return GF_CORRUPTED_DATA;
 
   // Resize the next samples array
-  g_array_set_size(mp4mx_ctx->next_samples, trun->sample_count);
+  guint32 first = mp4mx_ctx->next_samples->len;
+  g_array_set_size(mp4mx_ctx->next_samples, first + sample_count);
+  g_array_set_size(mp4mx_ctx->ticks, 3 * sample_count);
 
   // Look at all samples
-  for (guint32 i = 0; i < trun->sample_count; i++) {
-    GF_TrunEntry* entry = &trun->samples[i];
-    SampleInfo* sample = &g_array_index(mp4mx_ctx->next_samples, SampleInfo, i);
+  for (guint32 i = 0; i < sample_count; i++) {
+    SampleInfo* sample =
+      &g_array_index(mp4mx_ctx->next_samples, SampleInfo, first + i);
 
-    // Check if this is a sync sample
-    gboolean first_sample_flags_present = (trun->flags & 0x4) == 0x4;
-    gboolean sample_flags_present = (trun->flags & 0x400) == 0x400;
+    guint32 entry_duration =
+      sample_duration_present ? mp4mx_reader_u32(reader) : 0;
+    guint32 entry_size = sample_size_present ? mp4mx_reader_u32(reader) : 0;
+    guint32 entry_flags = sample_flags_present ? mp4mx_reader_u32(reader) : 0;
+    guint32 entry_cts = sample_cts_present ? mp4mx_reader_u32(reader) : 0;
 
-    u32 flags = 0;
+    // Check if this is a sync sample
+    u32 sample_flags = 0;
     if (i == 0 && first_sample_flags_present) {
-      flags = trun->first_sample_flags;
+      sample_flags = first_sample_flags;
     } else if (sample_flags_present) {
-      flags = entry->flags;
+      sample_flags = entry_flags;
     } else if (default_sample_flags_present || track->defaults_present) {
-      flags = default_sample_flags;
+      sample_flags = default_sample_flags;
     } else {
       GST_ERROR_OBJECT(ctx->sess->element, "No sample flags found");
       return GF_CORRUPTED_DATA;
     }
 
-    sample->is_sync = GF_ISOM_GET_FRAG_SYNC(flags);
+    sample->is_sync = GF_ISOM_GET_FRAG_SYNC(sample_flags);
 
     // Retrieve the sample size and offset
-    gboolean sample_size_present = (trun->flags & 0x200) == 0x200;
-
     if (sample_size_present) {
-      sample->size = entry->size;
+      sample->size = entry_size;
     } else if (default_sample_size_present || track->defaults_present) {
       sample->size = default_sample_size;
     } else {
@@ -453,12 +872,14 @@ mp4mx_parse_moof(GF_Filter* filter, GF_FilterPid* pid, GstBuffer* buffer)
       return GF_CORRUPTED_DATA;
     }
 
-    // Retrieve the sample duration
-    gboolean sample_duration_present = (trun->flags & 0x100) == 0x100;
+    sample->offset = *data_offset;
+    if (*data_offset != MP4MX_OFFSET_NONE)
+      *data_offset += sample->size;
 
+    // Retrieve the sample duration
     guint64 duration = 0;
     if (sample_duration_present) {
-      duration = entry->Duration;
+      duration = entry_duration;
     } else if (default_sample_duration_present || track->defaults_present) {
       duration = default_sample_duration;
     } else {
@@ -466,25 +887,38 @@ mp4mx_parse_moof(GF_Filter* filter, GF_FilterPid* pid, GstBuffer* buffer)
       return GF_CORRUPTED_DATA;
     }
 
-    sample->duration =
-      gf_timestamp_rescale(duration, track->timescale, GST_SECOND);
-
     // Retrieve the sample DTS
-    guint64 dts = tfdt->baseMediaDecodeTime + i;
-    sample->dts = gf_timestamp_rescale(dts, track->timescale, GST_SECOND);
-    sample->dts += ctx->global_offset;
+    guint64 dts = *decode_time;
+    *decode_time += duration;
+
+    // Retrieve the sample PTS, the offset is signed in version 1
+    gint64 cts_offset =
+      version == 1 ? (gint64)(gint32)entry_cts : (gint64)entry_cts;
+    guint64 pts = (guint64)MAX((gint64)dts + cts_offset, 0);
+
+    // Timestamps are converted for the whole run at once
+    guint64* ticks = &g_array_index(mp4mx_ctx->ticks, guint64, 3 * i);
+    ticks[0] = duration;
+    ticks[1] = dts;
+    ticks[2] = pts;
+  }
 
-    // Retrieve the sample PTS
-    guint64 pts = dts + entry->CTS_Offset;
-    sample->pts = gf_timestamp_rescale(pts, track->timescale, GST_SECOND);
-    sample->pts += ctx->global_offset;
+  gpac_time_converter_apply_batch(
+    &track->to_gst, (guint64*)mp4mx_ctx->ticks->data, mp4mx_ctx->ticks->len);
+  for (guint32 i = 0; i < sample_count; i++) {
+    SampleInfo* sample =
+      &g_array_index(mp4mx_ctx->next_samples, SampleInfo, first + i);
+    guint64* ticks = &g_array_index(mp4mx_ctx->ticks, guint64, 3 * i);
+    sample->duration = ticks[0];
+    sample->dts = ticks[1] + ctx->global_offset;
+    sample->pts = ticks[2] + ctx->global_offset;
 
     GST_TRACE_OBJECT(ctx->sess->element,
                      "Sample %d [%s]: size: %" G_GSSIZE_FORMAT ", "
                      "duration: %" GST_TIME_FORMAT ", "
                      "DTS: %" GST_TIME_FORMAT ", "
                      "PTS: %" GST_TIME_FORMAT,
-                     i,
+                     first + i,
                      sample->is_sync ? "S" : "NS",
                      sample->size,
                      GST_TIME_ARGS(sample->duration),
@@ -492,12 +926,179 @@ mp4mx_parse_moof(GF_Filter* filter, GF_FilterPid* pid, GstBuffer* buffer)
                      GST_TIME_ARGS(sample->pts));
   }
 
-empty_moof:
-  // Free the box
-  gf_isom_box_del(moof);
-  gf_bs_del(bs);
+  return reader->error ? GF_CORRUPTED_DATA : GF_OK;
+}
+
+GF_Err
+mp4mx_parse_traf(GPAC_MemIoContext* ctx,
+                 Mp4mxCtx* mp4mx_ctx,
+                 BoxReader* reader,
+                 guint64 traf_end,
+                 guint64* data_end)
+{
+  guint32 type;
+  guint64 end;
+  TrackInfo track = { 0 };
+  gboolean has_tfhd = FALSE;
+  guint32 tfhd_flags = 0;
+  guint64 decode_time = 0;
+  guint64 base_offset = 0;
+  guint64 data_offset = MP4MX_OFFSET_NONE;
+
+  // Each traf gets its own range in the sample table
+  TrafInfo traf = { 0 };
+  traf.first = mp4mx_ctx->next_samples->len;
+
+  while (mp4mx_reader_box(reader, traf_end, &type, &end)) {
+    switch (type) {
+      case GF_ISOM_BOX_TYPE_TFHD: {
+        tfhd_flags = mp4mx_reader_u32(reader) & 0xFFFFFF;
+        guint32 track_id = mp4mx_reader_u32(reader);
+
+        // Get the track info, the fragment defaults apply to a copy
+        TrackInfo* info =
+          g_hash_table_lookup(mp4mx_ctx->tracks, GUINT_TO_POINTER(track_id));
+        if (!info) {
+          GST_ERROR_OBJECT(ctx->sess->element, "Track %d not found", track_id);
+          return GF_BAD_PARAM;
+        }
+        track = *info;
+        traf.track_id = track_id;
+        has_tfhd = TRUE;
+
+        // Optional fields come in the order of their flags
+        // An explicit base offset is relative to the file, which we don't
+        // see as a whole. With default-base-is-moof the base is the moof
+        // start, otherwise it is the end of the data of the previous traf.
+        if (tfhd_flags & 0x1) {
+          mp4mx_reader_u64(reader); // base_data_offset
+          base_offset = MP4MX_OFFSET_NONE;
+        } else if (tfhd_flags & 0x20000) {
+          base_offset = 0;
+        } else {
+          base_offset = *data_end;
+        }
+        // The first run starts at the base unless it gives its own offset
+        data_offset = base_offset;
+        if (tfhd_flags & 0x2)
+          mp4mx_reader_u32(reader); // sample_description_index
+        if (tfhd_flags & 0x8)
+          track.default_sample_duration = mp4mx_reader_u32(reader);
+        if (tfhd_flags & 0x10)
+          track.default_sample_size = mp4mx_reader_u32(reader);
+        if (tfhd_flags & 0x20)
+          track.default_sample_flags = mp4mx_reader_u32(reader);
+        break;
+      }
 
+      case GF_ISOM_BOX_TYPE_TFDT: {
+        guint32 version = mp4mx_reader_u32(reader) >> 24;
+        decode_time = version == 1 ? mp4mx_reader_u64(reader)
+                                   : mp4mx_reader_u32(reader);
+        break;
+      }
+
+      case GF_ISOM_BOX_TYPE_TRUN: {
+        if (!has_tfhd) {
+          GST_ERROR_OBJECT(ctx->sess->element, "trun found before tfhd");
+          return GF_CORRUPTED_DATA;
+        }
+        GF_Err err = mp4mx_parse_trun(ctx,
+                                      mp4mx_ctx,
+                                      reader,
+                                      end,
+                                      &track,
+                                      tfhd_flags,
+                                      &decode_time,
+                                      base_offset,
+                                      &data_offset);
+        if (err != GF_OK)
+          return err;
+        break;
+      }
+
+      default:
+        break;
+    }
+    mp4mx_reader_skip_to(reader, end);
+  }
+
+  if (reader->error)
+    return GF_CORRUPTED_DATA;
+
+  // The data of the next traf may follow this one
+  if (has_tfhd)
+    *data_end = data_offset;
+
+  // Register the sample range of this track
+  traf.count = mp4mx_ctx->next_samples->len - traf.first;
+  for (guint i = 0; i < traf.count; i++) {
+    SampleInfo* sample =
+      &g_array_index(mp4mx_ctx->next_samples, SampleInfo, traf.first + i);
+    traf.has_sync |= sample->is_sync;
+  }
+  if (traf.count)
+    g_array_append_val(mp4mx_ctx->trafs, traf);
+
+  GST_DEBUG_OBJECT(ctx->sess->element,
+                   "Found %u samples for track %u in traf",
+                   traf.count,
+                   traf.track_id);
+  return GF_OK;
+}
+
+GF_Err
+mp4mx_parse_moof(GF_Filter* filter, GF_FilterPid* pid, MemoryChain* chain)
+{
+  GPAC_MemIoContext* ctx = (GPAC_MemIoContext*)gf_filter_get_rt_udta(filter);
+  GPAC_MemOutPIDContext* pctx =
+    (GPAC_MemOutPIDContext*)gf_filter_pid_get_udta(pid);
+  Mp4mxCtx* mp4mx_ctx = (Mp4mxCtx*)pctx->private_ctx;
+  GF_Err err = GF_OK;
+
+  BoxReader reader;
+  mp4mx_reader_init(&reader, chain);
+
+  // Samples of this fragment replace the previous ones
+  g_array_set_size(mp4mx_ctx->trafs, 0);
+  g_array_set_size(mp4mx_ctx->next_samples, 0);
+
+  guint32 type;
+  guint64 moof_end, end;
+  guint32 traf_count = 0;
+  guint64 data_end = 0;
+  if (!mp4mx_reader_box(&reader, chain->size, &type, &moof_end)) {
+    err = GF_CORRUPTED_DATA;
+    goto fail;
+  }
+  mp4mx_ctx->moof_size = moof_end;
+
+  while (mp4mx_reader_box(&reader, moof_end, &type, &end)) {
+    if (type == GF_ISOM_BOX_TYPE_TRAF) {
+      traf_count++;
+      err = mp4mx_parse_traf(ctx, mp4mx_ctx, &reader, end, &data_end);
+      if (err != GF_OK)
+        goto fail;
+    }
+    mp4mx_reader_skip_to(&reader, end);
+  }
+
+  if (reader.error) {
+    err = GF_CORRUPTED_DATA;
+    goto fail;
+  }
+
+  if (!traf_count)
+    GST_DEBUG_OBJECT(ctx->sess->element, "No traf box found");
+
+  mp4mx_reader_clear(&reader);
   return GF_OK;
+
+fail:
+  mp4mx_reader_clear(&reader);
+  GST_ELEMENT_ERROR(
+    ctx->sess->element, STREAM, FAILED, (NULL), ("Failed to parse moof box"));
+  return err;
 }
 
 gboolean
@@ -507,6 +1108,7 @@ mp4mx_parse_boxes(GF_Filter* filter, GF_FilterPid* pid, GF_FilterPacket* pck)
   GPAC_MemOutPIDContext* pctx =
     (GPAC_MemOutPIDContext*)gf_filter_pid_get_udta(pid);
   Mp4mxCtx* mp4mx_ctx = (Mp4mxCtx*)pctx->private_ctx;
+  GPAC_PckMemPool* pckmem = gpac_memio_get_pckmem(filter);
 
   // Get the data
   u32 size;
@@ -514,80 +1116,95 @@ mp4mx_parse_boxes(GF_Filter* filter, GF_FilterPid* pid, GF_FilterPacket* pck)
   GST_DEBUG_OBJECT(
     ctx->sess->element, "Processing data of size %" G_GUINT32_FORMAT, size);
 
+  // Boxes are slices of one root memory, so that adjacent boxes of the packet
+  // are spans and map together without a copy
+  GstMemory* root = gpac_pckmem_pool_wrap(pckmem, pctx->source, pck, 0, size);
+
   guint32 offset = 0;
   while (offset < size) {
     BoxInfo* box = g_queue_peek_tail(mp4mx_ctx->box_queue);
     if (!box || mp4mx_is_box_complete(box)) {
-      box = g_new0(BoxInfo, 1);
-      g_queue_push_tail(mp4mx_ctx->box_queue, box);
+      box = mp4mx_box_acquire(mp4mx_ctx, pck);
+      g_queue_push_tail_link(mp4mx_ctx->box_queue, &box->link);
     }
 
-    // If we have leftover data, append it to the current buffer
-    if (box->buffer && gst_buffer_get_size(box->buffer) != box->box_size) {
-      guint32 leftover =
-        MIN(box->box_size - gst_buffer_get_size(box->buffer), size - offset);
-      if (gst_buffer_get_size(box->buffer) > 0)
+    // Parse the box header, it may straddle packets
+    if (!box->box_size) {
+      guint32 used;
+      if (!mp4mx_box_parse_header(box, data + offset, size - offset, &used)) {
         GST_DEBUG_OBJECT(ctx->sess->element,
-                         "Incomplete box %s, appending %" G_GUINT32_FORMAT
-                         " bytes",
-                         gf_4cc_to_str(box->box_type),
-                         leftover);
-      GstMemory* mem = mp4mx_create_memory(data + offset, leftover, pck);
+                         "Box header split over packets, have %u bytes",
+                         box->header_size);
+        mp4mx_chain_append(&box->chain,
+                           mp4mx_create_memory(root, offset, used));
+        offset += used;
+        continue;
+      }
 
-      // Append the memory to the buffer
-      gst_buffer_append_memory(box->buffer, mem);
+      if (box->box_size < box->header_size) {
+        GST_ELEMENT_ERROR(ctx->sess->element,
+                          STREAM,
+                          FAILED,
+                          (NULL),
+                          ("Invalid size %" G_GUINT64_FORMAT " for box %s",
+                           box->box_size,
+                           gf_4cc_to_str(box->box_type)));
+        gst_memory_unref(root);
+        return FALSE;
+      }
 
-      // Update the offset
-      offset += leftover;
       GST_DEBUG_OBJECT(ctx->sess->element,
-                       "Wrote %" G_GSIZE_FORMAT " bytes of %" G_GUINT32_FORMAT
-                       " for box %s",
-                       gst_buffer_get_size(box->buffer),
-                       box->box_size,
-                       gf_4cc_to_str(box->box_type));
-      continue;
+                       "Saw box %s with size %" G_GUINT64_FORMAT,
+                       gf_4cc_to_str(box->box_type),
+                       box->box_size);
     }
 
-    // Parse the box header
-    box->box_size =
-      GUINT32_FROM_LE((data[offset] << 24) | (data[offset + 1] << 16) |
-                      (data[offset + 2] << 8) | data[offset + 3]);
-    box->box_type =
-      GUINT32_FROM_LE((data[offset + 4] << 24) | (data[offset + 5] << 16) |
-                      (data[offset + 6] << 8) | data[offset + 7]);
-    GST_DEBUG_OBJECT(ctx->sess->element,
-                     "Saw box %s with size %" G_GUINT32_FORMAT,
-                     gf_4cc_to_str(box->box_type),
-                     box->box_size);
+    // Append the rest of the box available in this packet
+    guint32 leftover =
+      (guint32)MIN(box->box_size - box->chain.size, (guint64)(size - offset));
+    if (box->chain.size > 0)
+      GST_DEBUG_OBJECT(ctx->sess->element,
+                       "Incomplete box %s, appending %" G_GUINT32_FORMAT
+                       " bytes",
+                       gf_4cc_to_str(box->box_type),
+                       leftover);
+    GstMemory* mem = mp4mx_create_memory(root, offset, leftover);
 
-    // Create a new buffer
-    box->buffer = gst_buffer_new();
+    // Append the memory to the chain
+    mp4mx_chain_append(&box->chain, mem);
 
-    // Preserve the timing information
-    GST_BUFFER_PTS(box->buffer) = gf_filter_pck_get_cts(pck);
-    GST_BUFFER_DTS(box->buffer) = gf_filter_pck_get_dts(pck);
-    GST_BUFFER_DURATION(box->buffer) = gf_filter_pck_get_duration(pck);
+    // Update the offset
+    offset += leftover;
+    GST_DEBUG_OBJECT(ctx->sess->element,
+                     "Wrote %" G_GSIZE_FORMAT " bytes of %" G_GUINT64_FORMAT
+                     " for box %s",
+                     box->chain.size,
+                     box->box_size,
+                     gf_4cc_to_str(box->box_type));
   }
 
+  // The slices hold the root from now on
+  gst_memory_unref(root);
+
   // Check if process can continue
   BoxInfo* box = g_queue_peek_head(mp4mx_ctx->box_queue);
   if (!mp4mx_is_box_complete(box))
     return FALSE;
 
   // Check if we need any further parsing
-  for (guint i = 0; i < g_queue_get_length(mp4mx_ctx->box_queue); i++) {
-    BoxInfo* box = g_queue_peek_nth(mp4mx_ctx->box_queue, i);
+  for (GList* l = mp4mx_ctx->box_queue->head; l; l = l->next) {
+    BoxInfo* box = l->data;
     if (!mp4mx_is_box_complete(box) || box->parsed)
       continue;
 
     switch (box->box_type) {
       case GF_ISOM_BOX_TYPE_MOOV:
-        gpac_return_val_if_fail(mp4mx_parse_moov(filter, pid, box->buffer),
+        gpac_return_val_if_fail(mp4mx_parse_moov(filter, pid, &box->chain),
                                 FALSE);
         break;
 
       case GF_ISOM_BOX_TYPE_MOOF:
-        gpac_return_val_if_fail(mp4mx_parse_moof(filter, pid, box->buffer),
+        gpac_return_val_if_fail(mp4mx_parse_moof(filter, pid, &box->chain),
                                 FALSE);
         break;
 
@@ -609,14 +1226,18 @@ mp4mx_create_buffer_list(GF_Filter* filter, GF_FilterPid* pid)
   GPAC_MemOutPIDContext* pctx =
     (GPAC_MemOutPIDContext*)gf_filter_pid_get_udta(pid);
   Mp4mxCtx* mp4mx_ctx = (Mp4mxCtx*)pctx->private_ctx;
+  GPAC_PckMemPool* pckmem = gpac_memio_get_pckmem(filter);
 
   // Check if the init and header buffers are present
-  gboolean init_present = GET_TYPE(INIT)->is_complete && GET_TYPE(INIT)->buffer;
+  gboolean init_present =
+    GET_TYPE(INIT)->is_complete && GET_TYPE(INIT)->chain.active;
   gboolean header_present =
-    GET_TYPE(HEADER)->is_complete && GET_TYPE(HEADER)->buffer;
+    GET_TYPE(HEADER)->is_complete && GET_TYPE(HEADER)->chain.active;
 
   // Declare variables
-  GstMemory* mdat_hdr = NULL;
+  MemoryChain* data = &GET_TYPE(DATA)->chain;
+  MemoryCursor mdat_hdr = { 0, 0 };
+  gboolean has_mdat_hdr = FALSE;
   gboolean segment_boundary = FALSE;
 
   // Create a new buffer list
@@ -624,7 +1245,7 @@ mp4mx_create_buffer_list(GF_Filter* filter, GF_FilterPid* pid)
   GST_DEBUG_OBJECT(ctx->sess->element, "Fragment completed");
 
   //
-  // Split the DATA buffer into samples, if we have the sample information
+  // Split the DATA chain into samples, if we have the sample information
   //
 
   // Copy the data as is if we don't have sample information
@@ -634,86 +1255,85 @@ mp4mx_create_buffer_list(GF_Filter* filter, GF_FilterPid* pid)
       ctx->sess->element,
       "No sample information found, appending data buffer as is");
 
-    // Set the flags
-    GST_BUFFER_FLAG_SET(GET_TYPE(DATA)->buffer, GST_BUFFER_FLAG_MARKER);
-    GST_BUFFER_FLAG_SET(GET_TYPE(DATA)->buffer, GST_BUFFER_FLAG_DELTA_UNIT);
-
-    // size of the data buffer
-    guint64 size = gst_buffer_get_size(GET_TYPE(DATA)->buffer);
-
     // We have to rely on mp4mx timing information
+    data->pts =
+      gpac_time_converter_apply(&mp4mx_ctx->mp4mx_to_gst, data->pts) +
+      ctx->global_offset;
+    data->dts =
+      gpac_time_converter_apply(&mp4mx_ctx->mp4mx_to_gst, data->dts) +
+      ctx->global_offset;
 
-    // PTS
-    guint64 pts = gf_timestamp_rescale(
-      GST_BUFFER_PTS(GET_TYPE(DATA)->buffer), mp4mx_ctx->mp4mx_ts, GST_SECOND);
-    pts += ctx->global_offset;
-    GST_BUFFER_PTS(GET_TYPE(DATA)->buffer) = pts;
-
-    // DTS
-    guint64 dts = gf_timestamp_rescale(
-      GST_BUFFER_DTS(GET_TYPE(DATA)->buffer), mp4mx_ctx->mp4mx_ts, GST_SECOND);
-    dts += ctx->global_offset;
-    GST_BUFFER_DTS(GET_TYPE(DATA)->buffer) = dts;
-
-    // Duration
     // For duration, we have to use mvhd since we don't parse the moov for
     // sample informations
-    GST_BUFFER_DURATION(GET_TYPE(DATA)->buffer) = mp4mx_ctx->duration;
+    data->duration = mp4mx_ctx->duration;
 
-    gst_buffer_list_add(buffer_list, GET_TYPE(DATA)->buffer);
+    GstBuffer* data_buffer = mp4mx_chain_to_buffer(pckmem, data);
+
+    // Set the flags
+    GST_BUFFER_FLAG_SET(data_buffer, GST_BUFFER_FLAG_MARKER);
+    GST_BUFFER_FLAG_SET(data_buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+
+    gst_buffer_list_add(buffer_list, data_buffer);
     goto headers;
   }
 
-  // Move the mdat header out of the data buffer
-  mdat_hdr =
-    gst_memory_share(gst_buffer_peek_memory(GET_TYPE(DATA)->buffer, 0), 0, 8);
-  gst_buffer_resize(GET_TYPE(DATA)->buffer, 8, -1);
+  // Leave the mdat header for the header buffer, samples start after it
+  MemoryCursor cursor = mdat_hdr;
+  has_mdat_hdr =
+    mp4mx_chain_read(data, &cursor, mp4mx_ctx->mdat_header_size, NULL);
+
+  // A fragment starts a segment once every track starts with a sync sample
+  segment_boundary = mp4mx_ctx->trafs->len > 0;
+  for (guint t = 0; t < mp4mx_ctx->trafs->len; t++)
+    segment_boundary &= g_array_index(mp4mx_ctx->trafs, TrafInfo, t).has_sync;
 
-  // Go through all samples
-  gssize data_offset = 0;
+  // Position in the mdat payload and the next sample of every traf
+  guint64 pos = 0;
+  guint64 payload_start = mp4mx_ctx->moof_size + mp4mx_ctx->mdat_header_size;
+  g_array_set_size(mp4mx_ctx->traf_next, mp4mx_ctx->trafs->len);
+  guint* next = (guint*)mp4mx_ctx->traf_next->data;
+  memset(next, 0, sizeof(guint) * mp4mx_ctx->trafs->len);
+
+  // Go through all samples in mdat order, walking the data chain exactly once
   for (guint s = 0; s < mp4mx_ctx->next_samples->len; s++) {
-    SampleInfo* sample = &g_array_index(mp4mx_ctx->next_samples, SampleInfo, s);
-
-    // Create a new buffer
-    GstBuffer* sample_buffer = gst_buffer_new();
-
-    // Slice the buffer
-    gssize avail_sample_size = sample->size;
-    gssize offset = 0;
-    guint n_blocks = gst_buffer_n_memory(GET_TYPE(DATA)->buffer);
-    for (guint b = 0; b < n_blocks && avail_sample_size; b++) {
-      GstMemory* mem = gst_buffer_peek_memory(GET_TYPE(DATA)->buffer, b);
-      gssize size = (gssize)gst_memory_get_sizes(mem, NULL, NULL);
-
-      // Skip until we reach the data offset
-      if (offset + size <= data_offset)
-        goto skip;
-
-      // Check the offset within the block
-      gssize block_offset = 0;
-      if (offset < data_offset) {
-        block_offset = data_offset - offset;
-        offset += block_offset;
-        size -= block_offset;
+    // Pick the traf whose next sample comes first in the mdat
+    TrafInfo* traf = NULL;
+    SampleInfo* sample = NULL;
+    for (guint t = 0; t < mp4mx_ctx->trafs->len; t++) {
+      TrafInfo* candidate = &g_array_index(mp4mx_ctx->trafs, TrafInfo, t);
+      if (next[t] == candidate->count)
+        continue;
+      SampleInfo* first = &g_array_index(
+        mp4mx_ctx->next_samples, SampleInfo, candidate->first + next[t]);
+      if (!sample || first->offset < sample->offset) {
+        traf = candidate;
+        sample = first;
       }
-
-      // Check if the block is enough
-      if (size <= avail_sample_size) {
-        gst_buffer_append_memory(sample_buffer,
-                                 gst_memory_share(mem, block_offset, size));
-        avail_sample_size -= size;
-      } else {
-        gst_buffer_append_memory(
-          sample_buffer,
-          gst_memory_share(mem, block_offset, avail_sample_size));
-        avail_sample_size = 0;
+    }
+    next[traf - (TrafInfo*)mp4mx_ctx->trafs->data]++;
+
+    // Skip the padding between track runs, if any
+    if (sample->offset != MP4MX_OFFSET_NONE) {
+      guint64 target = sample->offset - MIN(sample->offset, payload_start);
+      if (target > pos) {
+        mp4mx_chain_read(data, &cursor, target - pos, NULL);
+        pos = target;
+      } else if (target < pos) {
+        GST_WARNING_OBJECT(ctx->sess->element,
+                           "Sample %d of track %u overlaps the previous one",
+                           s,
+                           traf->track_id);
       }
-
-    skip:
-      // Update the local offset
-      offset += size;
     }
 
+    // Slice the sample out of the data chain
+    GstBuffer* sample_buffer = gpac_pckmem_pool_new_buffer(pckmem);
+    if (!mp4mx_chain_read(data, &cursor, sample->size, sample_buffer))
+      GST_WARNING_OBJECT(ctx->sess->element,
+                         "Sample %d exceeds the mdat payload, truncating",
+                         s);
+    pos += sample->size;
+
     // Set the marker flag if it's the last sample
     if (s == mp4mx_ctx->next_samples->len - 1)
       GST_BUFFER_FLAG_SET(sample_buffer, GST_BUFFER_FLAG_MARKER);
@@ -721,10 +1341,8 @@ mp4mx_create_buffer_list(GF_Filter* filter, GF_FilterPid* pid)
     // Set the delta unit flag. These buffers are always delta because they
     // follow a moof
     GST_BUFFER_FLAG_SET(sample_buffer, GST_BUFFER_FLAG_DELTA_UNIT);
-    if (sample->is_sync)
-      segment_boundary = TRUE;
 
-    // Set the PTS, DTS, and duration
+    // Set the PTS, DTS, and duration, in the timescale of the sample's track
     GST_BUFFER_PTS(sample_buffer) = sample->pts;
     GST_BUFFER_DTS(sample_buffer) = sample->dts;
     GST_BUFFER_DURATION(sample_buffer) = sample->duration;
@@ -734,32 +1352,30 @@ mp4mx_create_buffer_list(GF_Filter* filter, GF_FilterPid* pid)
 
     GST_TRACE_OBJECT(
       ctx->sess->element,
-      "Added sample %d to the buffer list: size: %" G_GSSIZE_FORMAT ", "
+      "Added sample %d of track %u to the buffer list: "
+      "size: %" G_GSSIZE_FORMAT ", "
       "duration: %" GST_TIME_FORMAT ", "
       "DTS: %" GST_TIME_FORMAT ", "
       "PTS: %" GST_TIME_FORMAT,
       s,
+      traf->track_id,
       sample->size,
       GST_TIME_ARGS(sample->duration),
       GST_TIME_ARGS(sample->dts),
       GST_TIME_ARGS(sample->pts));
-
-    // Update the data offset
-    data_offset += sample->size;
   }
 
-  // Unref the data buffer
-  gst_buffer_unref(GET_TYPE(DATA)->buffer);
-
 headers:
   // Add the init buffer if it's present
   if (init_present) {
     GST_DEBUG_OBJECT(ctx->sess->element, "Adding init buffer to the beginning");
+    GstBuffer* init_buffer =
+      mp4mx_chain_to_buffer(pckmem, &GET_TYPE(INIT)->chain);
 
     // Set the flags
-    GST_BUFFER_FLAG_SET(GET_TYPE(INIT)->buffer, GST_BUFFER_FLAG_HEADER);
+    GST_BUFFER_FLAG_SET(init_buffer, GST_BUFFER_FLAG_HEADER);
     if (mp4mx_ctx->segment_count == 0) {
-      GST_BUFFER_FLAG_SET(GET_TYPE(INIT)->buffer, GST_BUFFER_FLAG_DISCONT);
+      GST_BUFFER_FLAG_SET(init_buffer, GST_BUFFER_FLAG_DISCONT);
       ctx->is_continuous = TRUE;
     }
 
@@ -782,29 +1398,30 @@ headers:
       }
     } else {
       // Set the PTS and DTS to the minimum of the data
-      pts = GST_BUFFER_PTS(GET_TYPE(DATA)->buffer);
-      dts = GST_BUFFER_DTS(GET_TYPE(DATA)->buffer);
+      pts = data->pts;
+      dts = data->dts;
     }
 
-    GST_BUFFER_PTS(GET_TYPE(INIT)->buffer) = pts;
-    GST_BUFFER_DTS(GET_TYPE(INIT)->buffer) = dts;
-    GST_BUFFER_DURATION(GET_TYPE(INIT)->buffer) = GST_CLOCK_TIME_NONE;
+    GST_BUFFER_PTS(init_buffer) = pts;
+    GST_BUFFER_DTS(init_buffer) = dts;
+    GST_BUFFER_DURATION(init_buffer) = GST_CLOCK_TIME_NONE;
 
-    gst_buffer_list_insert(buffer_list, 0, GET_TYPE(INIT)->buffer);
+    gst_buffer_list_insert(buffer_list, 0, init_buffer);
   }
 
   // Add the header buffer if it's present
   if (header_present) {
     GST_DEBUG_OBJECT(ctx->sess->element, "Adding header buffer after init");
+    GstBuffer* header_buffer =
+      mp4mx_chain_to_buffer(pckmem, &GET_TYPE(HEADER)->chain);
 
     // Set the flags
-    GST_BUFFER_FLAG_SET(GET_TYPE(HEADER)->buffer, GST_BUFFER_FLAG_HEADER);
+    GST_BUFFER_FLAG_SET(header_buffer, GST_BUFFER_FLAG_HEADER);
 
     // Set the delta unit based on the first sample
     if (!segment_boundary)
-      GST_BUFFER_FLAG_SET(GET_TYPE(HEADER)->buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+      GST_BUFFER_FLAG_SET(header_buffer, GST_BUFFER_FLAG_DELTA_UNIT);
 
-    // Set the timing information
     // Set the timing information
     guint64 pts = G_MAXUINT64;
     guint64 dts = G_MAXUINT64;
@@ -821,27 +1438,27 @@ headers:
       }
     } else {
       // Set the PTS and DTS to the minimum of the data
-      pts = GST_BUFFER_PTS(GET_TYPE(DATA)->buffer);
-      dts = GST_BUFFER_DTS(GET_TYPE(DATA)->buffer);
-      duration = GST_BUFFER_DURATION(GET_TYPE(DATA)->buffer);
+      pts = data->pts;
+      dts = data->dts;
+      duration = data->duration;
     }
 
-    GST_BUFFER_PTS(GET_TYPE(HEADER)->buffer) = pts;
-    GST_BUFFER_DTS(GET_TYPE(HEADER)->buffer) = dts;
-    GST_BUFFER_DURATION(GET_TYPE(HEADER)->buffer) = duration;
+    GST_BUFFER_PTS(header_buffer) = pts;
+    GST_BUFFER_DTS(header_buffer) = dts;
+    GST_BUFFER_DURATION(header_buffer) = duration;
 
     // Append the mdat header
-    if (mdat_hdr)
-      gst_buffer_append_memory(GET_TYPE(HEADER)->buffer, mdat_hdr);
+    if (has_mdat_hdr)
+      mp4mx_chain_read(
+        data, &mdat_hdr, mp4mx_ctx->mdat_header_size, header_buffer);
 
     // Insert the header buffer
-    gst_buffer_list_insert(
-      buffer_list, init_present ? 1 : 0, GET_TYPE(HEADER)->buffer);
+    gst_buffer_list_insert(buffer_list, init_present ? 1 : 0, header_buffer);
   }
 
-  // Reset the buffer contents
+  // Reset the buffer contents, the output buffers hold their own references
   for (guint i = 0; i < LAST; i++) {
-    GET_TYPE(i)->buffer = NULL;
+    mp4mx_chain_reset(&GET_TYPE(i)->chain);
     GET_TYPE(i)->is_complete = FALSE;
   }
 
@@ -915,28 +1532,29 @@ mp4mx_post_process(GF_Filter* filter, GF_FilterPid* pid, GF_FilterPacket* pck)
     // Set the current type
     mp4mx_ctx->current_type = type;
 
-    // Create the master buffer
-    GstBuffer** master_buffer = &GET_TYPE(type)->buffer;
-    if (!(*master_buffer))
-      *master_buffer = box->buffer;
-    else
-      *master_buffer = gst_buffer_append(*master_buffer, box->buffer);
+    // Remember where the mdat payload starts
+    if (type == DATA)
+      mp4mx_ctx->mdat_header_size = box->header_size;
+
+    // Move the box memories to the master chain, without merging them
+    MemoryChain* master = &GET_TYPE(type)->chain;
+    mp4mx_chain_move(master, &box->chain);
 
     GST_DEBUG_OBJECT(ctx->sess->element,
-                     "New buffer [type: %d, size: %" G_GUINT32_FORMAT
-                     "]: %p (PTS: %" G_GUINT64_FORMAT
+                     "New chain [type: %d, size: %" G_GUINT64_FORMAT
+                     "]: %u memories (PTS: %" G_GUINT64_FORMAT
                      ", DTS: %" G_GUINT64_FORMAT
                      ", duration: %" G_GUINT64_FORMAT ")",
                      type,
                      box->box_size,
-                     *master_buffer,
-                     GST_BUFFER_PTS(*master_buffer),
-                     GST_BUFFER_DTS(*master_buffer),
-                     GST_BUFFER_DURATION(*master_buffer));
+                     master->mems->len,
+                     master->pts,
+                     master->dts,
+                     master->duration);
 
   skip:
-    // Pop the box
-    g_free(g_queue_pop_head(mp4mx_ctx->box_queue));
+    // Pop the box and recycle it
+    mp4mx_box_release(mp4mx_ctx, g_queue_pop_head_link(mp4mx_ctx->box_queue));
   }
 
   // Check if the fragment is completed
@@ -24,6 +24,7 @@
  */
 
 #include "lib/properties.h"
+#include "lib/filters.h"
 #include "gpacmessages.h"
 #include <gpac/filters.h>
 
@@ -122,6 +123,235 @@ gpac_install_local_properties(GObjectClass* gobject_class,
                               G_PARAM_READWRITE));
         break;
 
+      case GPAC_PROP_THREADS:
+        g_object_class_install_property(
+          gobject_class,
+          prop,
+          g_param_spec_int(
+            "threads",
+            "Threads",
+            "Number of worker threads for the gpac filter session. 0 runs the "
+            "session on the streaming thread, -1 uses one thread per core",
+            -1,
+            G_MAXINT16,
+            0,
+            G_PARAM_READWRITE));
+        break;
+
+      case GPAC_PROP_CPU_AFFINITY:
+        g_object_class_install_property(
+          gobject_class,
+          prop,
+          g_param_spec_string(
+            "cpu-affinity",
+            "CPU Affinity",
+            "Comma separated list of CPU cores or ranges (e.g. \"0,2-3\") to "
+            "pin the gpac worker threads to. Only used when threads is not 0",
+            NULL,
+            G_PARAM_READWRITE));
+        break;
+
+      case GPAC_PROP_RUN_MAX_STEPS:
+        g_object_class_install_property(
+          gobject_class,
+          prop,
+          g_param_spec_uint("run-max-steps",
+                            "Run Max Steps",
+                            "Maximum number of gpac scheduler steps per "
+                            "aggregate call, 0 for unlimited",
+                            0,
+                            G_MAXUINT,
+                            GPAC_DEFAULT_RUN_MAX_STEPS,
+                            G_PARAM_READWRITE));
+        break;
+
+      case GPAC_PROP_RUN_MAX_TIME:
+        g_object_class_install_property(
+          gobject_class,
+          prop,
+          g_param_spec_uint64("run-max-time",
+                              "Run Max Time",
+                              "Maximum wall time in microseconds spent in the "
+                              "gpac scheduler per aggregate call, 0 for "
+                              "unlimited",
+                              0,
+                              G_MAXUINT64,
+                              0,
+                              G_PARAM_READWRITE));
+        break;
+
+      case GPAC_PROP_RUN_MAX_PACKETS:
+        g_object_class_install_property(
+          gobject_class,
+          prop,
+          g_param_spec_uint("run-max-packets",
+                            "Run Max Packets",
+                            "Stop the gpac scheduler once this many packets "
+                            "reached the output in an aggregate call, 0 for "
+                            "unlimited",
+                            0,
+                            G_MAXUINT,
+                            0,
+                            G_PARAM_READWRITE));
+        break;
+
+      case GPAC_PROP_RUN_UNTIL_DRAINED:
+        g_object_class_install_property(
+          gobject_class,
+          prop,
+          g_param_spec_boolean(
+            "run-until-drained",
+            "Run Until Drained",
+            "Keep running the gpac scheduler until all queued input packets "
+            "are handed to the session, instead of stopping after "
+            "run-max-steps. Time and packet budgets still apply",
+            FALSE,
+            G_PARAM_READWRITE));
+        break;
+
+      case GPAC_PROP_WARM_RESTART:
+        g_object_class_install_property(
+          gobject_class,
+          prop,
+          g_param_spec_boolean(
+            "warm-restart",
+            "Warm Restart",
+            "Build the gpac filter session of the next start in the "
+            "background, so that restarting the element with the same "
+            "configuration does not wait for the session to be created. "
+            "Prepared sessions are kept until they are used",
+            FALSE,
+            G_PARAM_READWRITE));
+        break;
+
+      case GPAC_PROP_PUSH_MAX_BUFFERS:
+        g_object_class_install_property(
+          gobject_class,
+          prop,
+          g_param_spec_uint("push-max-buffers",
+                            "Push Max Buffers",
+                            "Maximum number of output buffers gathered in a "
+                            "buffer list before it is pushed downstream, 1 "
+                            "(the default) pushes every buffer on its own",
+                            1,
+                            G_MAXUINT,
+                            GPAC_DEFAULT_PUSH_MAX_BUFFERS,
+                            G_PARAM_READWRITE));
+        break;
+
+      case GPAC_PROP_PUSH_MAX_LATENCY:
+        g_object_class_install_property(
+          gobject_class,
+          prop,
+          g_param_spec_uint64("push-max-latency",
+                              "Push Max Latency",
+                              "Maximum timestamp span in microseconds of the "
+                              "output buffers gathered in a buffer list, 0 for "
+                              "unlimited",
+                              0,
+                              G_MAXUINT64,
+                              0,
+                              G_PARAM_READWRITE));
+        break;
+
+      case GPAC_PROP_RUN_STATS:
+        g_object_class_install_property(
+          gobject_class,
+          prop,
+          g_param_spec_boxed("run-stats",
+                             "Run Stats",
+                             "Counters of the gpac scheduler runs",
+                             GST_TYPE_STRUCTURE,
+                             G_PARAM_READABLE));
+        break;
+
+      case GPAC_PROP_SEGMENT_STORE:
+        g_object_class_install_property(
+          gobject_class,
+          prop,
+          g_param_spec_boolean(
+            "segment-store",
+            "Segment Store",
+            "Keep the manifests and segments in memory instead of writing "
+            "them to disk. Files are looked up with the get-stored signal. "
+            "Streams returned by the get-* signals still take precedence",
+            FALSE,
+            G_PARAM_READWRITE));
+        break;
+
+      case GPAC_PROP_DVR_WINDOW:
+        g_object_class_install_property(
+          gobject_class,
+          prop,
+          g_param_spec_uint64("dvr-window",
+                              "DVR Window",
+                              "Media time in nanoseconds, back from the end "
+                              "of the newest segment, that the segment store "
+                              "keeps, 0 to keep segments until the dasher "
+                              "deletes them",
+                              0,
+                              G_MAXUINT64,
+                              0,
+                              G_PARAM_READWRITE));
+        break;
+
+      case GPAC_PROP_STORE_MAX_SIZE:
+        g_object_class_install_property(
+          gobject_class,
+          prop,
+          g_param_spec_uint64("store-max-size",
+                              "Store Max Size",
+                              "Maximum number of bytes held by the segment "
+                              "store, oldest segments are evicted first. 0 "
+                              "for unlimited",
+                              0,
+                              G_MAXUINT64,
+                              0,
+                              G_PARAM_READWRITE));
+        break;
+
+      case GPAC_PROP_MAX_QUEUE_BYTES:
+        g_object_class_install_property(
+          gobject_class,
+          prop,
+          g_param_spec_uint64("max-queue-bytes",
+                              "Max Queue Bytes",
+                              "Stop taking input buffers while gpac holds this "
+                              "many bytes of them by reference. 0 for "
+                              "unlimited",
+                              0,
+                              G_MAXUINT64,
+                              0,
+                              G_PARAM_READWRITE));
+        break;
+
+      case GPAC_PROP_MAX_QUEUE_TIME:
+        g_object_class_install_property(
+          gobject_class,
+          prop,
+          g_param_spec_uint64("max-queue-time",
+                              "Max Queue Time",
+                              "Stop taking input buffers while the input is "
+                              "this many nanoseconds ahead of the output. 0 "
+                              "for unlimited",
+                              0,
+                              G_MAXUINT64,
+                              0,
+                              G_PARAM_READWRITE));
+        break;
+
+      case GPAC_PROP_QUEUE_LEVEL:
+        g_object_class_install_property(
+          gobject_class,
+          prop,
+          g_param_spec_boxed("queue-level",
+                             "Queue Level",
+                             "Input held by the gpac session: bytes and "
+                             "buffers referenced, and time not output yet",
+                             GST_TYPE_STRUCTURE,
+                             G_PARAM_READABLE));
+        break;
+
       case GPAC_PROP_SEGDUR:
         g_object_class_install_property(
           gobject_class,
@@ -154,72 +384,49 @@ gpac_install_filter_properties(GObjectClass* gobject_class,
                                GList* blacklist,
                                const gchar* filter_name)
 {
-  GF_FilterSession* session = gf_fs_new_defaults(0U);
-  guint num_filters = gf_fs_filters_registers_count(session);
-
-  // Get the list seperator
-  GF_Err e;
-  GF_Filter* dummy = gf_fs_new_filter(session, "dummy", 0, &e);
-  char sep_list = (char)gf_filter_get_sep(dummy, GF_FS_SEP_LIST);
-
-  const GF_FilterRegister* filter;
-  for (guint i = 0; i < num_filters; i++) {
-    filter = gf_fs_get_filter_register(session, i);
-    if (!g_strcmp0(filter->name, filter_name))
-      break;
-    filter = NULL;
-  }
-  gf_fs_del(session);
+  const GPAC_FilterInfo* filter = gpac_filters_lookup(filter_name);
   g_assert(filter);
+  char sep_list = gpac_filters_get_list_sep();
+
+  // Hidden and invalid options still take an index
+  for (guint option_idx = 0; option_idx < filter->n_args; option_idx++) {
+    const GPAC_FilterArg* arg = &filter->args[option_idx];
 
-  guint option_idx = 0;
-  while (filter->args && filter->args[option_idx].arg_name) {
     // Skip hidden options
-    if (filter->args[option_idx].flags & GF_ARG_HINT_HIDE)
-      goto skip;
+    if (arg->flags & GF_ARG_HINT_HIDE)
+      continue;
 
     // Check if the option name is valid
-    if (!g_param_spec_is_valid_name(filter->args[option_idx].arg_name))
-      goto skip;
+    if (!g_param_spec_is_valid_name(arg->name))
+      continue;
 
     // Check if the option is already registered
-    if (g_object_class_find_property(gobject_class,
-                                     filter->args[option_idx].arg_name))
-      goto skip;
+    if (g_object_class_find_property(gobject_class, arg->name))
+      continue;
 
     // Check if the option is blacklisted
-    GList* item;
-    for (item = blacklist; item; item = item->next)
-      if (!g_strcmp0(filter->args[option_idx].arg_name, item->data))
-        goto skip;
-
-#define SPEC_INSTALL(type, ...)                            \
-  g_object_class_install_property(                         \
-    gobject_class,                                         \
-    GPAC_PROP_FILTER_OFFSET + option_idx,                  \
-    g_param_spec_##type(filter->args[option_idx].arg_name, \
-                        filter->args[option_idx].arg_name, \
-                        filter->args[option_idx].arg_desc, \
-                        __VA_ARGS__,                       \
-                        G_PARAM_WRITABLE));
+    if (g_list_find_custom(blacklist, arg->name, (GCompareFunc)g_strcmp0))
+      continue;
+
+#define SPEC_INSTALL(type, ...)                                              \
+  g_object_class_install_property(                                           \
+    gobject_class,                                                           \
+    GPAC_PROP_FILTER_OFFSET + option_idx,                                    \
+    g_param_spec_##type(                                                     \
+      arg->name, arg->name, arg->desc, __VA_ARGS__, G_PARAM_WRITABLE));
 
     // Special case for enum values
-    if (filter->args[option_idx].min_max_enum &&
-        strstr(filter->args[option_idx].min_max_enum, "|")) {
+    if (arg->min_max_enum && strstr(arg->min_max_enum, "|")) {
       SPEC_INSTALL(string, NULL);
-      goto skip;
+      continue;
     }
 
     // Parse the default value
-    const GF_PropertyValue p =
-      gf_props_parse_value(filter->args[option_idx].arg_type,
-                           filter->args[option_idx].arg_name,
-                           filter->args[option_idx].arg_default_val,
-                           filter->args[option_idx].min_max_enum,
-                           sep_list);
+    const GF_PropertyValue p = gf_props_parse_value(
+      arg->type, arg->name, arg->default_val, arg->min_max_enum, sep_list);
 
     // Register the option
-    switch (filter->args[option_idx].arg_type) {
+    switch (arg->type) {
       case GF_PROP_SINT:
         SPEC_INSTALL(int, G_MININT, G_MAXINT, p.value.sint);
         break;
@@ -260,9 +467,6 @@ gpac_install_filter_properties(GObjectClass* gobject_class,
     }
 
 #undef SPEC_INSTALL
-
-  skip:
-    option_idx++;
   }
 }
 
@@ -323,6 +527,34 @@ gpac_set_property(GPAC_PropertyContext* ctx,
         g_free(ctx->destination);
         ctx->destination = g_value_dup_string(value);
         break;
+      case GPAC_PROP_THREADS:
+        ctx->threads = g_value_get_int(value);
+        break;
+      case GPAC_PROP_RUN_MAX_STEPS:
+        ctx->run_max_steps = g_value_get_uint(value);
+        break;
+      case GPAC_PROP_RUN_MAX_TIME:
+        ctx->run_max_time = g_value_get_uint64(value);
+        break;
+      case GPAC_PROP_RUN_MAX_PACKETS:
+        ctx->run_max_packets = g_value_get_uint(value);
+        break;
+      case GPAC_PROP_RUN_UNTIL_DRAINED:
+        ctx->run_until_drained = g_value_get_boolean(value);
+        break;
+      case GPAC_PROP_WARM_RESTART:
+        ctx->warm_restart = g_value_get_boolean(value);
+        break;
+      case GPAC_PROP_PUSH_MAX_BUFFERS:
+        ctx->push_max_buffers = g_value_get_uint(value);
+        break;
+      case GPAC_PROP_PUSH_MAX_LATENCY:
+        ctx->push_max_latency = g_value_get_uint64(value);
+        break;
+      case GPAC_PROP_CPU_AFFINITY:
+        g_free(ctx->cpu_affinity);
+        ctx->cpu_affinity = g_value_dup_string(value);
+        break;
       default:
         return FALSE;
     }
@@ -398,6 +630,33 @@ gpac_get_property(GPAC_PropertyContext* ctx,
       case GPAC_PROP_DESTINATION:
         g_value_set_string(value, ctx->destination);
         break;
+      case GPAC_PROP_THREADS:
+        g_value_set_int(value, ctx->threads);
+        break;
+      case GPAC_PROP_RUN_MAX_STEPS:
+        g_value_set_uint(value, ctx->run_max_steps);
+        break;
+      case GPAC_PROP_RUN_MAX_TIME:
+        g_value_set_uint64(value, ctx->run_max_time);
+        break;
+      case GPAC_PROP_RUN_MAX_PACKETS:
+        g_value_set_uint(value, ctx->run_max_packets);
+        break;
+      case GPAC_PROP_RUN_UNTIL_DRAINED:
+        g_value_set_boolean(value, ctx->run_until_drained);
+        break;
+      case GPAC_PROP_WARM_RESTART:
+        g_value_set_boolean(value, ctx->warm_restart);
+        break;
+      case GPAC_PROP_PUSH_MAX_BUFFERS:
+        g_value_set_uint(value, ctx->push_max_buffers);
+        break;
+      case GPAC_PROP_PUSH_MAX_LATENCY:
+        g_value_set_uint64(value, ctx->push_max_latency);
+        break;
+      case GPAC_PROP_CPU_AFFINITY:
+        g_value_set_string(value, ctx->cpu_affinity);
+        break;
       default:
         return FALSE;
     }
@@ -0,0 +1,99 @@
+/*
+ *			GPAC - Multimedia Framework C SDK
+ *
+ *			Authors: Deniz Ugur, Romain Bouqueau, Sohaib Larbi
+ *			Copyright (c) Motion Spell
+ *				All rights reserved
+ *
+ *  This file is part of the GPAC/GStreamer wrapper
+ *
+ *  This GPAC/GStreamer wrapper is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Affero General Public License
+ *  as published by the Free Software Foundation; either version 3, or (at
+ *  your option) any later version.
+ *
+ *  This GPAC/GStreamer wrapper is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public
+ *  License along with this library; see the file LICENSE.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include "lib/ring.h"
+
+GPAC_Ring*
+gpac_ring_new(guint capacity)
+{
+  GPAC_Ring* ring = g_new0(GPAC_Ring, 1);
+  ring->capacity = 1;
+  while (ring->capacity < capacity)
+    ring->capacity <<= 1;
+  ring->mask = ring->capacity - 1;
+  ring->slots = g_new0(gpointer, ring->capacity);
+  return ring;
+}
+
+void
+gpac_ring_free(GPAC_Ring* ring, GDestroyNotify free_func)
+{
+  if (!ring)
+    return;
+
+  gpointer item;
+  while ((item = gpac_ring_pop(ring))) {
+    if (free_func)
+      free_func(item);
+  }
+  g_free(ring->slots);
+  g_free(ring);
+}
+
+gboolean
+gpac_ring_push(GPAC_Ring* ring, gpointer item)
+{
+  g_return_val_if_fail(item, FALSE);
+
+  // Only the producer writes the tail, the head is published by the consumer
+  guint tail = ring->tail;
+  guint head = g_atomic_int_get(&ring->head);
+  if (tail - head >= ring->capacity)
+    return FALSE;
+
+  // Store the item before publishing the new tail
+  ring->slots[tail & ring->mask] = item;
+  g_atomic_int_set(&ring->tail, tail + 1);
+  return TRUE;
+}
+
+gpointer
+gpac_ring_pop(GPAC_Ring* ring)
+{
+  // Only the consumer writes the head, the tail is published by the producer
+  guint head = ring->head;
+  guint tail = g_atomic_int_get(&ring->tail);
+  if (head == tail)
+    return NULL;
+
+  // Read the item before releasing the slot to the producer
+  gpointer item = ring->slots[head & ring->mask];
+  g_atomic_int_set(&ring->head, head + 1);
+  return item;
+}
+
+guint
+gpac_ring_get_length(GPAC_Ring* ring)
+{
+  guint head = g_atomic_int_get(&ring->head);
+  guint tail = g_atomic_int_get(&ring->tail);
+  return tail - head;
+}
+
+guint
+gpac_ring_get_capacity(GPAC_Ring* ring)
+{
+  return ring->capacity;
+}
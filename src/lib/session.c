@@ -23,7 +23,14 @@
  *
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 #include "lib/session.h"
+#include "lib/main.h"
 #include "lib/memio.h"
 #include <gpac/list.h>
 
@@ -92,17 +99,131 @@ process_link_directive(char* link,
   return GF_OK;
 }
 
+#ifdef __linux__
+static gboolean
+gpac_session_parse_affinity(const gchar* affinity, cpu_set_t* set)
+{
+  CPU_ZERO(set);
+  g_auto(GStrv) cores = g_strsplit(affinity, ",", -1);
+  for (guint i = 0; cores[i]; i++) {
+    gchar* end = NULL;
+    guint64 first = g_ascii_strtoull(cores[i], &end, 10);
+    guint64 last = first;
+    if (end == cores[i])
+      return FALSE;
+    if (*end == '-')
+      last = g_ascii_strtoull(end + 1, &end, 10);
+    if (*end != '\0' || last < first || last >= CPU_SETSIZE)
+      return FALSE;
+    for (guint64 core = first; core <= last; core++)
+      CPU_SET(core, set);
+  }
+  return CPU_COUNT(set) > 0;
+}
+#endif
+
+// Pins the calling thread to the configured cores. Threads created while
+// pinned inherit the mask, which is how the gpac worker threads get it.
+// Returns TRUE if the previous mask was saved and must be restored.
+static gboolean
+gpac_session_affinity_begin(GPAC_SessionContext* ctx, gpointer saved)
+{
+  if (!ctx->cpu_affinity || ctx->threads == 0 || ctx->threads_started)
+    return FALSE;
+
+#ifdef __linux__
+  cpu_set_t set;
+  if (!gpac_session_parse_affinity(ctx->cpu_affinity, &set)) {
+    GST_ELEMENT_WARNING(ctx->element,
+                        LIBRARY,
+                        SETTINGS,
+                        (NULL),
+                        ("Invalid cpu-affinity \"%s\", ignoring",
+                         ctx->cpu_affinity));
+    return FALSE;
+  }
+
+  pthread_t self = pthread_self();
+  if (pthread_getaffinity_np(self, sizeof(cpu_set_t), saved) != 0 ||
+      pthread_setaffinity_np(self, sizeof(cpu_set_t), &set) != 0) {
+    GST_ELEMENT_WARNING(ctx->element,
+                        LIBRARY,
+                        SETTINGS,
+                        (NULL),
+                        ("Failed to set the cpu affinity"));
+    return FALSE;
+  }
+  return TRUE;
+#else
+  GST_ELEMENT_WARNING(ctx->element,
+                      LIBRARY,
+                      SETTINGS,
+                      (NULL),
+                      ("cpu-affinity is not supported on this platform"));
+  return FALSE;
+#endif
+}
+
+static void
+gpac_session_affinity_end(GPAC_SessionContext* ctx, gpointer saved)
+{
+#ifdef __linux__
+  pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), saved);
+#endif
+}
+
 gboolean
 gpac_session_init(GPAC_SessionContext* ctx,
                   GstElement* element,
                   GstGpacParams* params)
 {
-  ctx->session = gf_fs_new_defaults(GF_FS_FLAG_NON_BLOCKING);
   ctx->element = element;
   ctx->params = params;
+  ctx->threads_started = FALSE;
+  memset(&ctx->stats, 0, sizeof(ctx->stats));
+
+  if (ctx->threads == 0) {
+    ctx->session = gf_fs_new_defaults(GF_FS_FLAG_NON_BLOCKING);
+    return ctx->session != NULL;
+  }
+
+  // The worker threads are only spawned by the first run, pinned there
+  ctx->session = gf_fs_new(
+    ctx->threads, GF_FS_SCHEDULER_LOCK_FREE, GF_FS_FLAG_NON_BLOCKING, NULL);
+
+  GST_DEBUG_OBJECT(element,
+                   "Created gpac filter session with %d worker threads",
+                   ctx->threads);
   return ctx->session != NULL;
 }
 
+GF_Err
+gpac_session_prepare(GPAC_SessionContext* ctx,
+                     GstElement* element,
+                     GstGpacParams* params,
+                     gchar* graph,
+                     gboolean with_memout)
+{
+  if (!gpac_session_init(ctx, element, params)) {
+    GST_ELEMENT_ERROR(
+      element, LIBRARY, INIT, (NULL), ("Failed to initialize GPAC session"));
+    return GF_SERVICE_ERROR;
+  }
+
+  // The memory input must exist before the graph can reference it
+  GF_Err e = gpac_memio_new(ctx, GPAC_MEMIO_DIR_IN);
+  if (e != GF_OK)
+    return e;
+
+  e = gpac_session_open(ctx, graph);
+  if (e != GF_OK)
+    return e;
+
+  if (with_memout)
+    e = gpac_memio_new(ctx, GPAC_MEMIO_DIR_OUT);
+  return e;
+}
+
 gboolean
 gpac_session_close(GPAC_SessionContext* ctx, gboolean print_stats)
 {
@@ -120,7 +241,7 @@ gpac_session_close(GPAC_SessionContext* ctx, gboolean print_stats)
       gf_log_set_tools_levels("app@info", 1);
       gf_fs_print_connections(ctx->session);
       gf_fs_print_stats(ctx->session);
-      gf_log_set_tools_levels("app@warning", 1);
+      gpac_log_sync_levels(TRUE);
     }
 
     gpac_memio_free(ctx);
@@ -129,10 +250,80 @@ gpac_session_close(GPAC_SessionContext* ctx, gboolean print_stats)
     gf_fs_del(ctx->session);
     ctx->session = NULL;
     ctx->memin = NULL;
+    ctx->memout = NULL;
   }
   return TRUE;
 }
 
+static gboolean
+gpac_session_has_budget(GPAC_SessionContext* ctx,
+                        guint steps,
+                        gint64 start,
+                        guint64 packets,
+                        gboolean* exceeded)
+{
+  GPAC_SessionBudget* budget = &ctx->budget;
+
+  // Time and packet budgets bound every run
+  if (budget->max_time &&
+      (guint64)(g_get_monotonic_time() - start) >= budget->max_time)
+    goto exceeded;
+  if (budget->max_packets &&
+      ctx->stats.packets - packets >= budget->max_packets)
+    goto exceeded;
+
+  // Keep going while memin has packets to hand over
+  if (budget->until_drained && gpac_memio_get_pending(ctx) > 0)
+    return TRUE;
+
+  return budget->max_steps == 0 || steps <= budget->max_steps;
+
+exceeded:
+  *exceeded = TRUE;
+  return FALSE;
+}
+
+static void
+gpac_session_update_stats(GPAC_SessionContext* ctx,
+                          guint steps,
+                          gint64 start,
+                          gboolean exceeded)
+{
+  GPAC_SessionStats* stats = &ctx->stats;
+  guint64 elapsed = (guint64)(g_get_monotonic_time() - start);
+
+  stats->runs++;
+  stats->steps += steps;
+  stats->time += elapsed;
+  stats->max_run_time = MAX(stats->max_run_time, elapsed);
+  if (exceeded)
+    stats->budget_exceeded++;
+
+  GST_LOG_OBJECT(ctx->element,
+                 "Session run took %" G_GUINT64_FORMAT "us over %u steps%s",
+                 elapsed,
+                 steps,
+                 exceeded ? ", budget exceeded" : "");
+}
+
+guint64
+gpac_session_get_tasks(GPAC_SessionContext* ctx)
+{
+  if (!ctx->session)
+    return 0;
+
+  // Sum the tasks executed by all filters so far
+  guint64 tasks = 0;
+  GF_FilterStats fstats;
+  gf_fs_lock_filters(ctx->session, GF_TRUE);
+  for (u32 i = 0; i < gf_fs_get_filters_count(ctx->session); i++) {
+    if (gf_fs_get_filter_stats(ctx->session, i, &fstats) == GF_OK)
+      tasks += fstats.nb_tasks_done;
+  }
+  gf_fs_lock_filters(ctx->session, GF_FALSE);
+  return tasks;
+}
+
 GF_Err
 gpac_session_run(GPAC_SessionContext* ctx, gboolean flush)
 {
@@ -140,12 +331,34 @@ gpac_session_run(GPAC_SessionContext* ctx, gboolean flush)
     return GF_BAD_PARAM;
   gf_filter_post_process_task(ctx->memin);
 
+  // Worker threads are spawned by the first run, the only place they can be
+  // pinned from
+#ifdef __linux__
+  cpu_set_t saved;
+#else
+  guint64 saved;
+#endif
+  gboolean pinned = gpac_session_affinity_begin(ctx, &saved);
+
   GF_Err e = GF_OK;
-  guint32 steps = 100;
+  guint steps = 0;
+  gint64 start = g_get_monotonic_time();
+  guint64 packets = ctx->stats.packets;
+  gboolean exceeded = FALSE;
   do {
     e = gf_fs_run(ctx->session);
+    steps++;
+    if (pinned) {
+      gpac_session_affinity_end(ctx, &saved);
+      pinned = FALSE;
+    }
   } while (!gf_fs_is_last_task(ctx->session) &&
-           (flush || (e == GF_OK && steps--)));
+           (flush ||
+            (e == GF_OK &&
+             gpac_session_has_budget(ctx, steps, start, packets, &exceeded))));
+  if (ctx->threads != 0)
+    ctx->threads_started = TRUE;
+  gpac_session_update_stats(ctx, steps, start, exceeded);
 
   // Check errors
   e = gf_fs_get_last_connect_error(ctx->session);
@@ -320,3 +533,266 @@ gpac_session_has_output(GPAC_SessionContext* ctx)
   }
   return FALSE;
 }
+
+// #MARK: Latency
+// Duration option of a filter, GST_CLOCK_TIME_NONE if unset or disabled
+static GstClockTime
+gpac_session_get_duration_arg(GF_Filter* filter, const gchar* name)
+{
+  GF_PropertyValue p;
+  if (!gf_filter_get_arg(filter, name, &p))
+    return GST_CLOCK_TIME_NONE;
+
+  switch (p.type) {
+    case GF_PROP_FRACTION:
+      if (p.value.frac.num > 0 && p.value.frac.den > 0)
+        return gst_util_uint64_scale(
+          GST_SECOND, p.value.frac.num, p.value.frac.den);
+      break;
+    case GF_PROP_FRACTION64:
+      if (p.value.lfrac.num > 0 && p.value.lfrac.den > 0)
+        return gst_util_uint64_scale(
+          GST_SECOND, p.value.lfrac.num, p.value.lfrac.den);
+      break;
+    case GF_PROP_DOUBLE:
+      if (p.value.number > 0)
+        return (GstClockTime)(p.value.number * GST_SECOND);
+      break;
+    default:
+      break;
+  }
+  return GST_CLOCK_TIME_NONE;
+}
+
+GstClockTime
+gpac_session_get_latency(GPAC_SessionContext* ctx)
+{
+  if (!ctx->session)
+    return 0;
+
+  // Filters of the same chain work on aligned durations, the longest wins
+  GstClockTime latency = 0;
+  u32 count = gf_fs_get_filters_count(ctx->session);
+  for (u32 i = 0; i < count; i++) {
+    GF_Filter* filter = gf_fs_get_filter(ctx->session, i);
+    const gchar* name = gf_filter_get_name(filter);
+    GstClockTime delay = GST_CLOCK_TIME_NONE;
+
+    if (!g_strcmp0(name, "dasher")) {
+      // Output chunk by chunk if set, segment by segment otherwise
+      delay = gpac_session_get_duration_arg(filter, "cdur");
+      if (!GST_CLOCK_TIME_IS_VALID(delay))
+        delay = gpac_session_get_duration_arg(filter, "segdur");
+      // The dasher falls back to one second segments
+      if (!GST_CLOCK_TIME_IS_VALID(delay))
+        delay = GST_SECOND;
+    } else if (!g_strcmp0(name, "mp4mx")) {
+      // Fragments are only written once complete
+      delay = gpac_session_get_duration_arg(filter, "cdur");
+      if (!GST_CLOCK_TIME_IS_VALID(delay))
+        delay = gpac_session_get_duration_arg(filter, "segdur");
+    }
+
+    if (GST_CLOCK_TIME_IS_VALID(delay))
+      latency = MAX(latency, delay);
+  }
+
+  return latency;
+}
+
+// #MARK: Pool
+// Prepared sessions kept per key, including the ones still being built
+#define GPAC_SESSION_POOL_MAX_PER_KEY 2
+
+typedef struct
+{
+  GQueue ready;
+  guint pending;
+  guint users; // Elements that may still acquire a session for the key
+} GPAC_SessionPoolSlot;
+
+typedef struct
+{
+  gchar* key;
+  GPAC_SessionContext* ctx;
+  GstGpacParams params; // Copied, the element may be gone by the time it runs
+  gchar* graph;
+  gchar* destination;
+  gchar* cpu_affinity;
+  gboolean with_memout;
+} GPAC_SessionPoolJob;
+
+static GMutex pool_lock;
+static GCond pool_cond;
+static GHashTable* pool_slots = NULL;
+static GThreadPool* pool_builders = NULL;
+
+static void
+gpac_session_pool_discard(GPAC_SessionContext* ctx)
+{
+  gpac_session_close(ctx, FALSE);
+  g_free(ctx);
+  gf_sys_close();
+}
+
+static void
+gpac_session_pool_build(gpointer data, gpointer user_data)
+{
+  GPAC_SessionPoolJob* job = data;
+  GPAC_SessionContext* ctx = job->ctx;
+
+  // Stands in for the element while building. It has no bus, so failures are
+  // only logged and never reach the pipeline of a running element.
+  GstElement* element = gst_object_ref_sink(gst_bin_new("gpacsessionpool"));
+  ctx->destination = job->destination;
+  ctx->cpu_affinity = job->cpu_affinity;
+  GF_Err e = gpac_session_prepare(
+    ctx, element, &job->params, job->graph, job->with_memout);
+
+  // Only the session and its filters are handed over
+  ctx->element = NULL;
+  ctx->params = NULL;
+  ctx->destination = NULL;
+  ctx->cpu_affinity = NULL;
+  gst_object_unref(element);
+  if (e != GF_OK) {
+    GST_WARNING("Failed to prepare a pooled session: %s",
+                gf_error_to_string(e));
+    g_clear_pointer(&ctx, gpac_session_pool_discard);
+  }
+
+  g_mutex_lock(&pool_lock);
+  GPAC_SessionPoolSlot* slot = g_hash_table_lookup(pool_slots, job->key);
+  slot->pending--;
+  if (ctx && slot->users) {
+    g_queue_push_tail(&slot->ready, ctx);
+    ctx = NULL;
+  }
+  if (!slot->users && !slot->pending)
+    g_hash_table_remove(pool_slots, job->key);
+  g_cond_broadcast(&pool_cond);
+  g_mutex_unlock(&pool_lock);
+
+  // Nobody can acquire it anymore
+  if (ctx)
+    gpac_session_pool_discard(ctx);
+
+  g_free(job->key);
+  g_free(job->graph);
+  g_free(job->destination);
+  g_free(job->cpu_affinity);
+  g_free(job);
+}
+
+void
+gpac_session_pool_prepare(GPAC_SessionContext* ctx,
+                          const gchar* key,
+                          const gchar* graph,
+                          gboolean with_memout)
+{
+  g_mutex_lock(&pool_lock);
+  if (!pool_slots) {
+    pool_slots = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    pool_builders =
+      g_thread_pool_new(gpac_session_pool_build, NULL, 1, FALSE, NULL);
+  }
+
+  GPAC_SessionPoolSlot* slot = g_hash_table_lookup(pool_slots, key);
+  if (!slot) {
+    slot = g_new0(GPAC_SessionPoolSlot, 1);
+    g_queue_init(&slot->ready);
+    g_hash_table_insert(pool_slots, g_strdup(key), slot);
+  }
+  slot->users++;
+  if (slot->ready.length + slot->pending >= GPAC_SESSION_POOL_MAX_PER_KEY) {
+    g_mutex_unlock(&pool_lock);
+    return;
+  }
+  slot->pending++;
+  g_mutex_unlock(&pool_lock);
+
+  GPAC_SessionPoolJob* job = g_new0(GPAC_SessionPoolJob, 1);
+  job->key = g_strdup(key);
+  job->graph = g_strdup(graph);
+  job->destination = g_strdup(ctx->destination);
+  job->cpu_affinity = g_strdup(ctx->cpu_affinity);
+  job->with_memout = with_memout;
+  if (ctx->params)
+    job->params = *ctx->params;
+
+  job->ctx = g_new0(GPAC_SessionContext, 1);
+  job->ctx->threads = ctx->threads;
+
+  // The prepared session keeps gpac initialized until it is acquired
+  gf_sys_init(GF_MemTrackerNone, NULL);
+  g_thread_pool_push(pool_builders, job, NULL);
+}
+
+void
+gpac_session_pool_release(const gchar* key)
+{
+  g_mutex_lock(&pool_lock);
+  GPAC_SessionPoolSlot* slot =
+    pool_slots ? g_hash_table_lookup(pool_slots, key) : NULL;
+  if (!slot || --slot->users > 0) {
+    g_mutex_unlock(&pool_lock);
+    return;
+  }
+
+  // Sessions still being built are dropped by their builder
+  GQueue ready = slot->ready;
+  g_queue_init(&slot->ready);
+  if (!slot->pending)
+    g_hash_table_remove(pool_slots, key);
+  g_mutex_unlock(&pool_lock);
+
+  GPAC_SessionContext* prepared;
+  while ((prepared = g_queue_pop_head(&ready)))
+    gpac_session_pool_discard(prepared);
+}
+
+gboolean
+gpac_session_pool_acquire(GPAC_SessionContext* ctx,
+                          GstElement* element,
+                          GstGpacParams* params,
+                          const gchar* key)
+{
+  g_mutex_lock(&pool_lock);
+  GPAC_SessionPoolSlot* slot =
+    pool_slots ? g_hash_table_lookup(pool_slots, key) : NULL;
+
+  // A session being built is closer to ready than a new one. The slot goes
+  // away if its last user releases it meanwhile.
+  while (slot && g_queue_is_empty(&slot->ready) && slot->pending) {
+    g_cond_wait(&pool_cond, &pool_lock);
+    slot = g_hash_table_lookup(pool_slots, key);
+  }
+  GPAC_SessionContext* prepared = slot ? g_queue_pop_head(&slot->ready) : NULL;
+  g_mutex_unlock(&pool_lock);
+  if (!prepared)
+    return FALSE;
+
+  ctx->element = element;
+  ctx->params = params;
+  ctx->session = prepared->session;
+  ctx->memin = prepared->memin;
+  ctx->memout = prepared->memout;
+  ctx->threads_started = FALSE;
+  ctx->had_data_flow = FALSE;
+  memset(&ctx->stats, 0, sizeof(ctx->stats));
+  g_free(prepared);
+
+  // The memory io filters now report to this context
+  GF_Filter* memio[] = { ctx->memin, ctx->memout };
+  for (guint i = 0; i < G_N_ELEMENTS(memio); i++) {
+    GPAC_MemIoContext* rt_udta =
+      memio[i] ? gf_filter_get_rt_udta(memio[i]) : NULL;
+    if (rt_udta)
+      rt_udta->sess = ctx;
+  }
+
+  // The caller holds its own reference on gpac
+  gf_sys_close();
+  GST_DEBUG_OBJECT(element, "Acquired a prepared gpac filter session");
+  return TRUE;
+}
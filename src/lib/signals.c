@@ -25,6 +25,7 @@
 
 #include "lib/signals.h"
 #include "elements/common.h"
+#include "lib/store.h"
 
 typedef struct
 {
@@ -49,9 +50,34 @@ typedef struct
 static signal_info signal_presets[] = {
   GPAC_SIGNAL_PRESET_RANGE("dasher_all",
                            GPAC_SIGNAL_DASHER_MANIFEST,
-                           GPAC_SIGNAL_DASHER_DELETE_SEGMENT),
+                           GPAC_SIGNAL_DASHER_GET_STORED_PART),
 };
 
+static GstBuffer*
+gpac_signal_get_stored(GstElement* element,
+                       const gchar* name,
+                       gpointer user_data)
+{
+  GPAC_SegmentStore* store =
+    g_object_get_qdata(G_OBJECT(element), GPAC_STORE_QDATA);
+  if (!store || !name)
+    return NULL;
+  return gpac_store_lookup(store, name);
+}
+
+static GstBuffer*
+gpac_signal_get_stored_part(GstElement* element,
+                            const gchar* name,
+                            guint index,
+                            gpointer user_data)
+{
+  GPAC_SegmentStore* store =
+    g_object_get_qdata(G_OBJECT(element), GPAC_STORE_QDATA);
+  if (!store || !name)
+    return NULL;
+  return gpac_store_lookup_part(store, name, index);
+}
+
 void
 register_signal(GObjectClass* klass, GPAC_SignalId id)
 {
@@ -95,6 +121,65 @@ register_signal(GObjectClass* klass, GPAC_SignalId id)
         G_TYPE_STRING);
       break;
 
+    case GPAC_SIGNAL_DASHER_SEGMENT_CHUNK:
+      registered_signals[id] = g_signal_new(
+        gpac_signal_names[id - 1], // Adjusted index for 0-based array
+        G_TYPE_FROM_CLASS(klass),
+        G_SIGNAL_RUN_LAST,
+        0,
+        NULL,
+        NULL,
+        NULL,
+        G_TYPE_NONE,
+        2,
+        G_TYPE_STRING,    // The name of the file
+        GST_TYPE_BUFFER); // The data, wrapping the gpac packet
+      break;
+
+    case GPAC_SIGNAL_DASHER_SEGMENT_READY:
+      registered_signals[id] = g_signal_new(
+        gpac_signal_names[id - 1], // Adjusted index for 0-based array
+        G_TYPE_FROM_CLASS(klass),
+        G_SIGNAL_RUN_LAST,
+        0,
+        NULL,
+        NULL,
+        NULL,
+        G_TYPE_NONE,
+        2,
+        G_TYPE_STRING,       // The name of the file
+        GST_TYPE_STRUCTURE); // The description of the file
+      break;
+
+    case GPAC_SIGNAL_DASHER_GET_STORED:
+      registered_signals[id] = g_signal_new_class_handler(
+        gpac_signal_names[id - 1], // Adjusted index for 0-based array
+        G_TYPE_FROM_CLASS(klass),
+        G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+        G_CALLBACK(gpac_signal_get_stored),
+        NULL,
+        NULL,
+        NULL,
+        GST_TYPE_BUFFER, // The stored file, or NULL if not in the store
+        1,
+        G_TYPE_STRING);
+      break;
+
+    case GPAC_SIGNAL_DASHER_GET_STORED_PART:
+      registered_signals[id] = g_signal_new_class_handler(
+        gpac_signal_names[id - 1], // Adjusted index for 0-based array
+        G_TYPE_FROM_CLASS(klass),
+        G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+        G_CALLBACK(gpac_signal_get_stored_part),
+        NULL,
+        NULL,
+        NULL,
+        GST_TYPE_BUFFER, // The byte range of the part, or NULL if not complete
+        2,
+        G_TYPE_STRING,   // The name of the segment
+        G_TYPE_UINT);    // The index of the part
+      break;
+
     default:
       break;
   };
@@ -139,6 +224,30 @@ gpac_install_all_signals(GObjectClass* gobject_class)
   }
 }
 
+static GstObject*
+gpac_signal_find(GstElement* element, GPAC_SignalId id, guint* signal_id)
+{
+  // The signal may be registered on the element or on one of its parents
+  GstObject* object = gst_object_ref(GST_OBJECT(element));
+  while (object) {
+    GstGpacParams* params = GST_GPAC_GET_PARAMS(G_OBJECT_GET_CLASS(object));
+    if (params && params->registered_signals[id]) {
+      *signal_id = params->registered_signals[id];
+      return object;
+    }
+
+    GstObject* parent = gst_object_get_parent(object);
+    gst_object_unref(object);
+    object = parent;
+  }
+
+  GST_DEBUG_OBJECT(element,
+                   "Signal %s not registered for element %s",
+                   gpac_signal_names[id - 1],
+                   GST_OBJECT_NAME(element));
+  return NULL;
+}
+
 gboolean
 gpac_signal_try_emit(GstElement* element,
                      GPAC_SignalId id,
@@ -148,34 +257,55 @@ gpac_signal_try_emit(GstElement* element,
   g_assert(element != NULL);
   g_assert(id < GPAC_SIGNAL_LAST);
 
-  GstObject* parent = GST_OBJECT(element);
-  do {
-    GObjectClass* klass = G_OBJECT_GET_CLASS(parent);
-    GstGpacParams* params = GST_GPAC_GET_PARAMS(klass);
-    guint* registered_signals = params->registered_signals;
-
-    // We may not have registered this signal
-    if (!registered_signals[id])
-      continue;
-
-    guint signal_id = registered_signals[id];
-    if (signal_id) {
-      if (output_stream) {
-        *output_stream = NULL;
-        g_signal_emit(parent, signal_id, 0, location, output_stream);
-        return (*output_stream != NULL);
-      }
+  guint signal_id;
+  GstObject* target = gpac_signal_find(element, id, &signal_id);
+  if (!target)
+    return FALSE;
 
-      gboolean deleted = FALSE;
-      g_signal_emit(parent, signal_id, 0, location, &deleted);
-      return deleted;
-    }
-  } while ((parent = gst_element_get_parent(parent)));
+  gboolean ret = FALSE;
+  if (output_stream) {
+    *output_stream = NULL;
+    g_signal_emit(target, signal_id, 0, location, output_stream);
+    ret = (*output_stream != NULL);
+  } else {
+    g_signal_emit(target, signal_id, 0, location, &ret);
+  }
 
-  GST_DEBUG_OBJECT(element,
-                   "Signal %s not registered for element %s",
-                   gpac_signal_names[id - 1],
-                   GST_OBJECT_NAME(element));
+  gst_object_unref(target);
+  return ret;
+}
+
+gboolean
+gpac_signal_is_connected(GstElement* element, GPAC_SignalId id)
+{
+  g_assert(element != NULL);
+  g_assert(id < GPAC_SIGNAL_LAST);
+
+  guint signal_id;
+  GstObject* target = gpac_signal_find(element, id, &signal_id);
+  if (!target)
+    return FALSE;
+
+  gboolean connected = g_signal_has_handler_pending(target, signal_id, 0, FALSE);
+  gst_object_unref(target);
+  return connected;
+}
+
+gboolean
+gpac_signal_try_notify(GstElement* element,
+                       GPAC_SignalId id,
+                       const gchar* location,
+                       gpointer data)
+{
+  g_assert(element != NULL);
+  g_assert(id < GPAC_SIGNAL_LAST);
+
+  guint signal_id;
+  GstObject* target = gpac_signal_find(element, id, &signal_id);
+  if (!target)
+    return FALSE;
 
-  return FALSE;
+  g_signal_emit(target, signal_id, 0, location, data);
+  gst_object_unref(target);
+  return TRUE;
 }
@@ -0,0 +1,392 @@
+/*
+ *			GPAC - Multimedia Framework C SDK
+ *
+ *			Authors: Deniz Ugur, Romain Bouqueau, Sohaib Larbi
+ *			Copyright (c) Motion Spell
+ *				All rights reserved
+ *
+ *  This file is part of the GPAC/GStreamer wrapper
+ *
+ *  This GPAC/GStreamer wrapper is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Affero General Public License
+ *  as published by the Free Software Foundation; either version 3, or (at
+ *  your option) any later version.
+ *
+ *  This GPAC/GStreamer wrapper is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public
+ *  License along with this library; see the file LICENSE.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+#include "lib/store.h"
+
+typedef struct
+{
+  guint index;
+  gsize offset;
+} GPAC_StorePart;
+
+struct _GPAC_StoreEntry
+{
+  GPAC_SegmentStore* store;
+  GList link; // Embedded link in the eviction queue
+  gchar* name;
+  GPAC_StoreEntryType type;
+  gboolean committed;
+  GPtrArray* chunks;
+  gsize size;
+  GArray* parts; // Byte-range parts, in offset order
+  GstClockTime start; // Presentation time range of the media, if known
+  GstClockTime end;
+};
+
+struct _GPAC_SegmentStore
+{
+  gint ref_count;
+
+  // Protects the tables and the chunks and parts of the open entries
+  GMutex lock;
+  GHashTable* entries;
+  GHashTable* open_entries;
+  GQueue windowed; // Segments and parts, oldest first
+  guint64 size;
+  GstClockTime live_edge; // End of the newest timed entry
+
+  GstClockTime window;
+  guint64 max_size;
+};
+
+// #MARK: Entries
+static void
+gpac_store_entry_free(GPAC_StoreEntry* entry)
+{
+  g_ptr_array_unref(entry->chunks);
+  g_array_unref(entry->parts);
+  g_free(entry->name);
+  g_free(entry);
+}
+
+GPAC_StoreEntry*
+gpac_store_open(GPAC_SegmentStore* store,
+                const gchar* name,
+                GPAC_StoreEntryType type)
+{
+  GPAC_StoreEntry* entry = g_new0(GPAC_StoreEntry, 1);
+  entry->store = store;
+  entry->link.data = entry;
+  entry->name = g_strdup(name);
+  entry->type = type;
+  entry->chunks = g_ptr_array_new_with_free_func((GDestroyNotify)g_bytes_unref);
+  entry->parts = g_array_new(FALSE, FALSE, sizeof(GPAC_StorePart));
+  entry->start = GST_CLOCK_TIME_NONE;
+  entry->end = GST_CLOCK_TIME_NONE;
+
+  // Parts of an open segment are served before the segment is committed
+  if (type == GPAC_STORE_ENTRY_SEGMENT) {
+    g_mutex_lock(&store->lock);
+    g_hash_table_replace(store->open_entries, entry->name, entry);
+    g_mutex_unlock(&store->lock);
+  }
+  return entry;
+}
+
+static void
+gpac_store_close_entry(GPAC_SegmentStore* store, GPAC_StoreEntry* entry)
+{
+  if (g_hash_table_lookup(store->open_entries, entry->name) == entry)
+    g_hash_table_remove(store->open_entries, entry->name);
+}
+
+void
+gpac_store_entry_discard(GPAC_StoreEntry* entry)
+{
+  if (!entry)
+    return;
+
+  g_mutex_lock(&entry->store->lock);
+  gpac_store_close_entry(entry->store, entry);
+  g_mutex_unlock(&entry->store->lock);
+  gpac_store_entry_free(entry);
+}
+
+void
+gpac_store_entry_append(GPAC_StoreEntry* entry, GBytes* data)
+{
+  g_mutex_lock(&entry->store->lock);
+  g_ptr_array_add(entry->chunks, g_bytes_ref(data));
+  entry->size += g_bytes_get_size(data);
+  g_mutex_unlock(&entry->store->lock);
+}
+
+void
+gpac_store_entry_mark_part(GPAC_StoreEntry* entry, guint index)
+{
+  GPAC_StorePart part = { .index = index, .offset = entry->size };
+
+  g_mutex_lock(&entry->store->lock);
+  g_array_append_val(entry->parts, part);
+  g_mutex_unlock(&entry->store->lock);
+}
+
+void
+gpac_store_entry_set_time(GPAC_StoreEntry* entry,
+                          GstClockTime start,
+                          GstClockTime end)
+{
+  entry->start = start;
+  entry->end = end;
+}
+
+const gchar*
+gpac_store_entry_get_name(GPAC_StoreEntry* entry)
+{
+  return entry->name;
+}
+
+// Number of chunks a byte range of the entry spans
+static guint
+gpac_store_entry_count_chunks(GPAC_StoreEntry* entry, gsize offset, gsize size)
+{
+  guint count = 0;
+  gsize chunk_start = 0;
+  for (guint i = 0; i < entry->chunks->len && size; i++) {
+    gsize chunk_end =
+      chunk_start + g_bytes_get_size(g_ptr_array_index(entry->chunks, i));
+    if (offset < chunk_end) {
+      gsize take = MIN(chunk_end - offset, size);
+      offset += take;
+      size -= take;
+      count++;
+    }
+    chunk_start = chunk_end;
+  }
+  return count;
+}
+
+static void
+gpac_store_entry_merge(GPAC_StoreEntry* entry)
+{
+  guint8* data = g_malloc(entry->size);
+  gsize offset = 0;
+  for (guint i = 0; i < entry->chunks->len; i++) {
+    gsize size;
+    gconstpointer chunk =
+      g_bytes_get_data(g_ptr_array_index(entry->chunks, i), &size);
+    memcpy(data + offset, chunk, size);
+    offset += size;
+  }
+  g_ptr_array_set_size(entry->chunks, 0);
+  g_ptr_array_add(entry->chunks, g_bytes_new_take(data, entry->size));
+}
+
+static GstBuffer*
+gpac_store_entry_slice(GPAC_StoreEntry* entry, gsize offset, gsize size)
+{
+  // A buffer holds a limited number of memories and merges the rest on every
+  // append. Chunks stay shared until a lookup needs more than that, then the
+  // committed entry is merged once for all the lookups that follow.
+  if (entry->committed &&
+      gpac_store_entry_count_chunks(entry, offset, size) >
+        gst_buffer_get_max_memory())
+    gpac_store_entry_merge(entry);
+
+  // Wrap the chunks, the buffer keeps them alive after eviction
+  GstBuffer* buffer = gst_buffer_new();
+  gsize chunk_start = 0;
+  for (guint i = 0; i < entry->chunks->len && size; i++) {
+    GBytes* chunk = g_ptr_array_index(entry->chunks, i);
+    gsize chunk_size;
+    gconstpointer data = g_bytes_get_data(chunk, &chunk_size);
+    gsize chunk_end = chunk_start + chunk_size;
+
+    if (offset < chunk_end) {
+      gsize skip = offset - chunk_start;
+      gsize take = MIN(chunk_size - skip, size);
+      gst_buffer_append_memory(
+        buffer,
+        gst_memory_new_wrapped(GST_MEMORY_FLAG_READONLY,
+                               (gpointer)data,
+                               chunk_size,
+                               skip,
+                               take,
+                               g_bytes_ref(chunk),
+                               (GDestroyNotify)g_bytes_unref));
+      offset += take;
+      size -= take;
+    }
+    chunk_start = chunk_end;
+  }
+  return buffer;
+}
+
+// #MARK: Store
+GPAC_SegmentStore*
+gpac_store_new(void)
+{
+  GPAC_SegmentStore* store = g_new0(GPAC_SegmentStore, 1);
+  store->ref_count = 1;
+  g_mutex_init(&store->lock);
+  store->entries = g_hash_table_new_full(
+    g_str_hash, g_str_equal, NULL, (GDestroyNotify)gpac_store_entry_free);
+  store->open_entries = g_hash_table_new(g_str_hash, g_str_equal);
+  g_queue_init(&store->windowed);
+  store->live_edge = GST_CLOCK_TIME_NONE;
+  return store;
+}
+
+GPAC_SegmentStore*
+gpac_store_ref(GPAC_SegmentStore* store)
+{
+  g_atomic_int_inc(&store->ref_count);
+  return store;
+}
+
+void
+gpac_store_unref(GPAC_SegmentStore* store)
+{
+  if (!store || !g_atomic_int_dec_and_test(&store->ref_count))
+    return;
+
+  g_hash_table_unref(store->open_entries);
+  g_hash_table_unref(store->entries);
+  g_mutex_clear(&store->lock);
+  g_free(store);
+}
+
+void
+gpac_store_set_limits(GPAC_SegmentStore* store,
+                      GstClockTime window,
+                      guint64 max_size)
+{
+  g_mutex_lock(&store->lock);
+  store->window = window;
+  store->max_size = max_size;
+  g_mutex_unlock(&store->lock);
+}
+
+void
+gpac_store_clear(GPAC_SegmentStore* store)
+{
+  g_mutex_lock(&store->lock);
+  g_queue_init(&store->windowed);
+  g_hash_table_remove_all(store->entries);
+  store->size = 0;
+  store->live_edge = GST_CLOCK_TIME_NONE;
+  g_mutex_unlock(&store->lock);
+}
+
+static void
+gpac_store_remove_entry(GPAC_SegmentStore* store, GPAC_StoreEntry* entry)
+{
+  if (GPAC_STORE_ENTRY_IS_WINDOWED(entry->type))
+    g_queue_unlink(&store->windowed, &entry->link);
+  store->size -= entry->size;
+
+  // The table owns the entry, the name must not be used afterwards
+  g_hash_table_remove(store->entries, entry->name);
+}
+
+static void
+gpac_store_evict(GPAC_SegmentStore* store)
+{
+  // Never evict the newest segment, even if it is larger than the store
+  while (g_queue_get_length(&store->windowed) > 1) {
+    GPAC_StoreEntry* oldest = g_queue_peek_head(&store->windowed);
+
+    // The window is measured in media time back from the live edge
+    gboolean expired = store->window &&
+                       GST_CLOCK_TIME_IS_VALID(store->live_edge) &&
+                       GST_CLOCK_TIME_IS_VALID(oldest->end) &&
+                       store->live_edge > oldest->end + store->window;
+    gboolean oversized = store->max_size && store->size > store->max_size;
+    if (!expired && !oversized)
+      break;
+    gpac_store_remove_entry(store, oldest);
+  }
+}
+
+void
+gpac_store_commit(GPAC_SegmentStore* store, GPAC_StoreEntry* entry)
+{
+  g_mutex_lock(&store->lock);
+  gpac_store_close_entry(store, entry);
+  entry->committed = TRUE;
+
+  GPAC_StoreEntry* previous = g_hash_table_lookup(store->entries, entry->name);
+  if (previous)
+    gpac_store_remove_entry(store, previous);
+
+  g_hash_table_insert(store->entries, entry->name, entry);
+  if (GPAC_STORE_ENTRY_IS_WINDOWED(entry->type)) {
+    g_queue_push_tail_link(&store->windowed, &entry->link);
+    if (GST_CLOCK_TIME_IS_VALID(entry->end) &&
+        (!GST_CLOCK_TIME_IS_VALID(store->live_edge) ||
+         entry->end > store->live_edge))
+      store->live_edge = entry->end;
+  }
+  store->size += entry->size;
+
+  gpac_store_evict(store);
+  g_mutex_unlock(&store->lock);
+}
+
+gboolean
+gpac_store_remove(GPAC_SegmentStore* store, const gchar* name)
+{
+  g_mutex_lock(&store->lock);
+  GPAC_StoreEntry* entry = g_hash_table_lookup(store->entries, name);
+  if (entry)
+    gpac_store_remove_entry(store, entry);
+  g_mutex_unlock(&store->lock);
+  return entry != NULL;
+}
+
+GstBuffer*
+gpac_store_lookup(GPAC_SegmentStore* store, const gchar* name)
+{
+  GstBuffer* buffer = NULL;
+
+  g_mutex_lock(&store->lock);
+  GPAC_StoreEntry* entry = g_hash_table_lookup(store->entries, name);
+  if (entry)
+    buffer = gpac_store_entry_slice(entry, 0, entry->size);
+  g_mutex_unlock(&store->lock);
+  return buffer;
+}
+
+GstBuffer*
+gpac_store_lookup_part(GPAC_SegmentStore* store,
+                       const gchar* name,
+                       guint index)
+{
+  GstBuffer* buffer = NULL;
+
+  g_mutex_lock(&store->lock);
+
+  // A segment being written takes precedence over its previous version
+  GPAC_StoreEntry* entry = g_hash_table_lookup(store->open_entries, name);
+  if (!entry)
+    entry = g_hash_table_lookup(store->entries, name);
+
+  for (guint i = 0; entry && i < entry->parts->len; i++) {
+    GPAC_StorePart* part = &g_array_index(entry->parts, GPAC_StorePart, i);
+    if (part->index != index)
+      continue;
+
+    // A part is complete once the next one started or the segment is done
+    gsize end = entry->size;
+    if (i + 1 < entry->parts->len)
+      end = g_array_index(entry->parts, GPAC_StorePart, i + 1).offset;
+    else if (!entry->committed)
+      break;
+
+    buffer = gpac_store_entry_slice(entry, part->offset, end - part->offset);
+    break;
+  }
+  g_mutex_unlock(&store->lock);
+  return buffer;
+}
@@ -48,3 +48,56 @@ gpac_time_rescale_with_fps(GstClockTime time,
 
   return rescaled_time;
 }
+
+static guint64
+gpac_time_gcd(guint64 a, guint64 b)
+{
+  while (b) {
+    guint64 t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+void
+gpac_time_converter_init(GPAC_TimeConverter* conv,
+                         guint64 from_timescale,
+                         guint64 to_timescale)
+{
+  g_return_if_fail(conv != NULL);
+
+  // A zero timescale can't be converted, make every call return 0
+  if (!from_timescale || !to_timescale) {
+    conv->num = 0;
+    conv->den = 1;
+    conv->bias = 0;
+    conv->limit = G_MAXUINT64;
+    return;
+  }
+
+  // Reduce the ratio so that the fast path covers as much as possible
+  guint64 gcd = gpac_time_gcd(from_timescale, to_timescale);
+  conv->num = to_timescale / gcd;
+  conv->den = from_timescale / gcd;
+  conv->bias = conv->den / 2;
+
+  // Largest time for which time * num + bias doesn't overflow
+  conv->limit = (G_MAXUINT64 - conv->bias) / conv->num;
+}
+
+void
+gpac_time_converter_apply_batch(const GPAC_TimeConverter* conv,
+                                guint64* times,
+                                gsize count)
+{
+  g_return_if_fail(conv != NULL);
+  g_return_if_fail(times != NULL || count == 0);
+
+  // Identity conversion, nothing to do
+  if (conv->num == 1 && conv->den == 1)
+    return;
+
+  for (gsize i = 0; i < count; i++)
+    times[i] = gpac_time_converter_apply(conv, times[i]);
+}
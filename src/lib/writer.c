@@ -0,0 +1,384 @@
+/*
+ *			GPAC - Multimedia Framework C SDK
+ *
+ *			Authors: Deniz Ugur, Romain Bouqueau, Sohaib Larbi
+ *			Copyright (c) Motion Spell
+ *				All rights reserved
+ *
+ *  This file is part of the GPAC/GStreamer wrapper
+ *
+ *  This GPAC/GStreamer wrapper is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU Affero General Public License
+ *  as published by the Free Software Foundation; either version 3, or (at
+ *  your option) any later version.
+ *
+ *  This GPAC/GStreamer wrapper is distributed in the hope that it will be
+ *  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public
+ *  License along with this library; see the file LICENSE.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+#include "lib/writer.h"
+
+typedef enum
+{
+  GPAC_WRITER_OP_OPEN,
+  GPAC_WRITER_OP_WRITE,
+  GPAC_WRITER_OP_CLOSE,
+  GPAC_WRITER_OP_DELETE,
+} GPAC_WriterOpType;
+
+typedef struct
+{
+  GList link; // Embedded queue link
+  GPAC_WriterOpType type;
+  GPAC_WriterFile* file;
+  GBytes* data;
+  gchar* path;
+
+  // Close only
+  GPAC_WriterClosedFn closed;
+  gpointer user_data;
+  GDestroyNotify notify;
+} GPAC_WriterOp;
+
+struct _GPAC_WriterFile
+{
+  gchar* name;
+  GFile* file; // Set when the pool opened the file itself
+  GOutputStream* out;
+  gboolean failed;
+};
+
+struct _GPAC_WriterLane
+{
+  GPAC_WriterPool* pool;
+
+  GMutex lock;
+  GCond cond;
+  GQueue ops;
+  gsize queued_bytes;
+  gboolean scheduled; // Queued to or running on a pool thread
+
+  GError* error;
+  GError* warning;
+};
+
+struct _GPAC_WriterPool
+{
+  gint ref_count;
+  GThreadPool* threads;
+};
+
+// #MARK: Operations
+static void
+gpac_writer_op_free(GPAC_WriterOp* op)
+{
+  if (op->data)
+    g_bytes_unref(op->data);
+  if (op->notify)
+    op->notify(op->user_data);
+  g_free(op->path);
+  g_free(op);
+}
+
+static void
+gpac_writer_file_free(GPAC_WriterFile* file)
+{
+  g_clear_object(&file->out);
+  g_clear_object(&file->file);
+  g_free(file->name);
+  g_free(file);
+}
+
+static void
+gpac_writer_run_open(GPAC_WriterFile* file, GError** error)
+{
+  if (file->out)
+    return;
+
+  file->file = g_file_new_for_path(file->name);
+  file->out = G_OUTPUT_STREAM(
+    g_file_replace(file->file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, error));
+  if (!file->out)
+    file->failed = TRUE;
+}
+
+static void
+gpac_writer_run_writes(GPAC_WriterOp** ops, guint n_ops, GError** error)
+{
+  GPAC_WriterFile* file = ops[0]->file;
+  if (file->failed || !file->out)
+    return;
+
+  GOutputVector vectors[GPAC_WRITER_MAX_VECTORS];
+  for (guint i = 0; i < n_ops; i++) {
+    gsize size;
+    vectors[i].buffer = g_bytes_get_data(ops[i]->data, &size);
+    vectors[i].size = size;
+  }
+
+  if (!g_output_stream_writev_all(
+        file->out, vectors, n_ops, NULL, NULL, error))
+    file->failed = TRUE;
+}
+
+static void
+gpac_writer_run_close(GPAC_WriterOp* op, GError** error)
+{
+  GPAC_WriterFile* file = op->file;
+  gboolean ok = !file->failed && file->out != NULL;
+  if (file->out &&
+      !g_output_stream_close(file->out, NULL, file->failed ? NULL : error))
+    ok = FALSE;
+  gpac_writer_file_free(file);
+
+  if (op->closed)
+    op->closed(ok, op->user_data);
+}
+
+static void
+gpac_writer_run_delete(const gchar* path, GError** error)
+{
+  GFile* file = g_file_new_for_path(path);
+  g_file_delete(file, NULL, error);
+  g_object_unref(file);
+}
+
+// #MARK: Pool
+static void
+gpac_writer_lane_run(gpointer data, gpointer user_data)
+{
+  GPAC_WriterLane* lane = data;
+  GPAC_WriterOp* batch[GPAC_WRITER_MAX_VECTORS];
+
+  g_mutex_lock(&lane->lock);
+  while (!g_queue_is_empty(&lane->ops)) {
+    // Take the next operation, and the writes to the same file that follow it
+    guint n_ops = 0;
+    gsize bytes = 0;
+    do {
+      GPAC_WriterOp* op = g_queue_pop_head_link(&lane->ops)->data;
+      if (op->data)
+        bytes += g_bytes_get_size(op->data);
+      batch[n_ops++] = op;
+
+      GPAC_WriterOp* next = g_queue_peek_head(&lane->ops);
+      if (op->type != GPAC_WRITER_OP_WRITE || !next ||
+          next->type != GPAC_WRITER_OP_WRITE || next->file != op->file)
+        break;
+    } while (n_ops < GPAC_WRITER_MAX_VECTORS);
+    g_mutex_unlock(&lane->lock);
+
+    // Run the operation without holding the lock
+    GError* error = NULL;
+    GPAC_WriterOp* op = batch[0];
+    switch (op->type) {
+      case GPAC_WRITER_OP_OPEN:
+        gpac_writer_run_open(op->file, &error);
+        break;
+      case GPAC_WRITER_OP_WRITE:
+        gpac_writer_run_writes(batch, n_ops, &error);
+        break;
+      case GPAC_WRITER_OP_CLOSE:
+        gpac_writer_run_close(op, &error);
+        break;
+      case GPAC_WRITER_OP_DELETE:
+        gpac_writer_run_delete(op->path, &error);
+        break;
+    }
+
+    for (guint i = 0; i < n_ops; i++)
+      gpac_writer_op_free(batch[i]);
+
+    g_mutex_lock(&lane->lock);
+    lane->queued_bytes -= bytes;
+
+    // Keep the first error until the owner checks the lane
+    if (error) {
+      GError** slot =
+        op->type == GPAC_WRITER_OP_DELETE ? &lane->warning : &lane->error;
+      if (!*slot)
+        *slot = error;
+      else
+        g_error_free(error);
+    }
+    g_cond_broadcast(&lane->cond);
+  }
+
+  lane->scheduled = FALSE;
+  g_cond_broadcast(&lane->cond);
+  g_mutex_unlock(&lane->lock);
+}
+
+GPAC_WriterPool*
+gpac_writer_pool_new(guint n_threads)
+{
+  GPAC_WriterPool* pool = g_new0(GPAC_WriterPool, 1);
+  pool->ref_count = 1;
+  pool->threads = g_thread_pool_new(
+    gpac_writer_lane_run, pool, MAX(n_threads, 1), FALSE, NULL);
+  return pool;
+}
+
+GPAC_WriterPool*
+gpac_writer_pool_ref(GPAC_WriterPool* pool)
+{
+  g_atomic_int_inc(&pool->ref_count);
+  return pool;
+}
+
+void
+gpac_writer_pool_unref(GPAC_WriterPool* pool)
+{
+  if (!pool || !g_atomic_int_dec_and_test(&pool->ref_count))
+    return;
+
+  // Let the queued lanes finish before stopping the threads
+  g_thread_pool_free(pool->threads, FALSE, TRUE);
+  g_free(pool);
+}
+
+// #MARK: Lane
+GPAC_WriterLane*
+gpac_writer_lane_new(GPAC_WriterPool* pool)
+{
+  GPAC_WriterLane* lane = g_new0(GPAC_WriterLane, 1);
+  lane->pool = gpac_writer_pool_ref(pool);
+  g_mutex_init(&lane->lock);
+  g_cond_init(&lane->cond);
+  g_queue_init(&lane->ops);
+  return lane;
+}
+
+void
+gpac_writer_lane_free(GPAC_WriterLane* lane)
+{
+  if (!lane)
+    return;
+
+  gpac_writer_lane_flush(lane);
+  gpac_writer_pool_unref(lane->pool);
+
+  g_clear_error(&lane->error);
+  g_clear_error(&lane->warning);
+  g_cond_clear(&lane->cond);
+  g_mutex_clear(&lane->lock);
+  g_free(lane);
+}
+
+void
+gpac_writer_lane_flush(GPAC_WriterLane* lane)
+{
+  g_mutex_lock(&lane->lock);
+  while (lane->scheduled)
+    g_cond_wait(&lane->cond, &lane->lock);
+  g_mutex_unlock(&lane->lock);
+}
+
+gboolean
+gpac_writer_lane_check(GPAC_WriterLane* lane,
+                       GError** error,
+                       GError** warning)
+{
+  g_mutex_lock(&lane->lock);
+  gboolean ok = lane->error == NULL;
+  if (error)
+    *error = g_steal_pointer(&lane->error);
+  else
+    g_clear_error(&lane->error);
+  if (warning)
+    *warning = g_steal_pointer(&lane->warning);
+  else
+    g_clear_error(&lane->warning);
+  g_mutex_unlock(&lane->lock);
+  return ok;
+}
+
+static void
+gpac_writer_lane_queue(GPAC_WriterLane* lane, GPAC_WriterOp* op)
+{
+  gsize bytes = op->data ? g_bytes_get_size(op->data) : 0;
+  op->link.data = op;
+
+  g_mutex_lock(&lane->lock);
+
+  // Apply backpressure while the pool is behind
+  while (bytes && lane->scheduled &&
+         lane->queued_bytes + bytes > GPAC_WRITER_LANE_MAX_BYTES)
+    g_cond_wait(&lane->cond, &lane->lock);
+
+  g_queue_push_tail_link(&lane->ops, &op->link);
+  lane->queued_bytes += bytes;
+
+  if (!lane->scheduled) {
+    lane->scheduled = TRUE;
+    g_thread_pool_push(lane->pool->threads, lane, NULL);
+  }
+  g_mutex_unlock(&lane->lock);
+}
+
+// #MARK: Files
+GPAC_WriterFile*
+gpac_writer_open(GPAC_WriterLane* lane,
+                 const gchar* name,
+                 GOutputStream* stream)
+{
+  GPAC_WriterFile* file = g_new0(GPAC_WriterFile, 1);
+  file->name = g_strdup(name);
+  file->out = stream;
+
+  // Streams given by the application are ready to use
+  if (!stream) {
+    GPAC_WriterOp* op = g_new0(GPAC_WriterOp, 1);
+    op->type = GPAC_WRITER_OP_OPEN;
+    op->file = file;
+    gpac_writer_lane_queue(lane, op);
+  }
+  return file;
+}
+
+void
+gpac_writer_write(GPAC_WriterLane* lane, GPAC_WriterFile* file, GBytes* data)
+{
+  GPAC_WriterOp* op = g_new0(GPAC_WriterOp, 1);
+  op->type = GPAC_WRITER_OP_WRITE;
+  op->file = file;
+  op->data = g_bytes_ref(data);
+  gpac_writer_lane_queue(lane, op);
+}
+
+void
+gpac_writer_close(GPAC_WriterLane* lane,
+                  GPAC_WriterFile* file,
+                  GPAC_WriterClosedFn closed,
+                  gpointer user_data,
+                  GDestroyNotify notify)
+{
+  GPAC_WriterOp* op = g_new0(GPAC_WriterOp, 1);
+  op->type = GPAC_WRITER_OP_CLOSE;
+  op->file = file;
+  op->closed = closed;
+  op->user_data = user_data;
+  op->notify = notify;
+  gpac_writer_lane_queue(lane, op);
+}
+
+void
+gpac_writer_delete(GPAC_WriterLane* lane, const gchar* path)
+{
+  GPAC_WriterOp* op = g_new0(GPAC_WriterOp, 1);
+  op->type = GPAC_WRITER_OP_DELETE;
+  op->path = g_strdup(path);
+  gpac_writer_lane_queue(lane, op);
+}
+
+const gchar*
+gpac_writer_file_get_name(GPAC_WriterFile* file)
+{
+  return file->name;
+}
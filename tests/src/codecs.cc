@@ -57,3 +57,12 @@ TEST_F(GstTestFixture, HandlesAV1)
   CheckFile(file, 1, 2);
   TEARDOWN_PIPELINE();
 }
+
+TEST_F(GstTestFixture, HandlesRawVideo)
+{
+  // videotestsrc defaults to 320x240 I420, shared with gpac as is
+  SETUP_PIPELINE("identity", "raw.yuv", 5);
+  ASSERT_TRUE(fs::exists(file));
+  EXPECT_EQ(fs::file_size(file), 320 * 240 * 3 / 2 * 5);
+  TEARDOWN_PIPELINE();
+}
@@ -1,6 +1,8 @@
 #include "helper/common.hpp"
 #include "helper/smemcapture.hpp"
 #include <filesystem>
+#include <mutex>
+#include <unordered_map>
 #include <gio/gio.h>
 #include <gpac/isomedia.h>
 #include <gpac/media_tools.h>
@@ -248,3 +250,158 @@ TEST_F(GstTestFixture, HLSMultiVariantInSink)
   // Check manifests
   CHECK_MANIFEST_FILE(0);
 }
+
+TEST_F(GstTestFixture, HLSSegmentStore)
+{
+  PipelineConfigurationMany cfg;
+  cfg.v_num_buffers = 30 * 10;
+  cfg.a_num_buffers = 48000 / 1024 * 10;
+
+  this->SetUpPipelineMany(cfg);
+  GstElement* gpachlssink = gst_element_factory_make_full(
+    "gpachlssink", "segdur", 2.0, "segment-store", TRUE, NULL);
+
+  // Add the sink to the pipeline
+  gst_bin_add(GST_BIN(pipeline), gpachlssink);
+  // Link the elements
+  for (auto& encoder : GetEncoders()) {
+    if (!gst_element_link(encoder, gpachlssink)) {
+      g_error("Failed to link elements");
+      return;
+    }
+  }
+
+  this->StartPipeline();
+  this->WaitForEOS();
+
+  // The manifest is served from memory
+  GstBuffer* manifest = NULL;
+  g_signal_emit_by_name(gpachlssink, "get-stored", "master.m3u8", &manifest);
+  ASSERT_TRUE(manifest != NULL);
+  EXPECT_GT(gst_buffer_get_size(manifest), 0);
+  gst_buffer_unref(manifest);
+
+  // Unknown files are not
+  GstBuffer* missing = NULL;
+  g_signal_emit_by_name(gpachlssink, "get-stored", "missing.m4s", &missing);
+  EXPECT_TRUE(missing == NULL);
+}
+
+TEST_F(GstTestFixture, HLSSegmentChunks)
+{
+  PipelineConfigurationMany cfg;
+  cfg.v_num_buffers = 30 * 10;
+  cfg.a_num_buffers = 48000 / 1024 * 10;
+
+  this->SetUpPipelineMany(cfg);
+  GstElement* gpachlssink =
+    gst_element_factory_make_full("gpachlssink", "segdur", 2.0, NULL);
+
+  // Bytes received per file, and the sizes reported once they are complete
+  struct Delivery
+  {
+    std::mutex lock;
+    std::unordered_map<std::string, guint64> received;
+    std::unordered_map<std::string, guint64> reported;
+  } delivery;
+
+  g_signal_connect(
+    gpachlssink,
+    "segment-chunk",
+    G_CALLBACK(
+      +[](GstElement*, const gchar* name, GstBuffer* chunk, gpointer d) {
+        auto* delivery = static_cast<Delivery*>(d);
+        std::lock_guard<std::mutex> guard(delivery->lock);
+        delivery->received[name] += gst_buffer_get_size(chunk);
+      }),
+    &delivery);
+  g_signal_connect(
+    gpachlssink,
+    "segment-ready",
+    G_CALLBACK(
+      +[](GstElement*, const gchar* name, GstStructure* info, gpointer d) {
+        auto* delivery = static_cast<Delivery*>(d);
+        guint64 size = 0;
+        gst_structure_get_uint64(info, "size", &size);
+        std::lock_guard<std::mutex> guard(delivery->lock);
+        delivery->reported[name] = size;
+      }),
+    &delivery);
+
+  // Add the sink to the pipeline
+  gst_bin_add(GST_BIN(pipeline), gpachlssink);
+  // Link the elements
+  for (auto& encoder : GetEncoders()) {
+    if (!gst_element_link(encoder, gpachlssink)) {
+      g_error("Failed to link elements");
+      return;
+    }
+  }
+
+  this->StartPipeline();
+  this->WaitForEOS();
+
+  // Segments and the manifest were delivered completely
+  ASSERT_GT(delivery.reported.size(), 1);
+  ASSERT_TRUE(delivery.reported.count("master.m3u8"));
+  for (const auto& [name, size] : delivery.reported) {
+    if (name.find(".m3u8") != std::string::npos)
+      continue; // Manifests are rewritten, chunks add up over the rewrites
+    EXPECT_EQ(delivery.received[name], size) << name;
+  }
+}
+
+TEST_F(GstTestFixture, HLSSegmentReadyOnDisk)
+{
+  PipelineConfigurationMany cfg;
+  cfg.v_num_buffers = 30 * 10;
+  cfg.a_num_buffers = 48000 / 1024 * 10;
+
+  this->SetUpPipelineMany(cfg);
+  GstElement* gpachlssink =
+    gst_element_factory_make_full("gpachlssink", "segdur", 2.0, NULL);
+
+  // Size reported for every file, and whether it was on disk at that time
+  struct Report
+  {
+    std::mutex lock;
+    std::unordered_map<std::string, guint64> reported;
+    std::unordered_map<std::string, guint64> on_disk;
+  } report;
+
+  g_signal_connect(
+    gpachlssink,
+    "segment-ready",
+    G_CALLBACK(
+      +[](GstElement*, const gchar* name, GstStructure* info, gpointer d) {
+        auto* report = static_cast<Report*>(d);
+        guint64 size = 0;
+        gst_structure_get_uint64(info, "size", &size);
+        std::error_code ec;
+        guint64 disk_size = fs::file_size(name, ec);
+        std::lock_guard<std::mutex> guard(report->lock);
+        report->reported[name] = size;
+        report->on_disk[name] = ec ? G_MAXUINT64 : disk_size;
+      }),
+    &report);
+
+  // Add the sink to the pipeline
+  gst_bin_add(GST_BIN(pipeline), gpachlssink);
+  // Link the elements
+  for (auto& encoder : GetEncoders()) {
+    if (!gst_element_link(encoder, gpachlssink)) {
+      g_error("Failed to link elements");
+      return;
+    }
+  }
+
+  this->StartPipeline();
+  this->WaitForEOS();
+
+  // Files are reported once they are closed on disk
+  ASSERT_GT(report.reported.size(), 1);
+  for (const auto& [name, size] : report.reported) {
+    EXPECT_EQ(report.on_disk[name], size) << name;
+    fs::remove(name);
+  }
+}
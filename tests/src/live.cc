@@ -22,3 +22,45 @@ TEST_F(GstTestFixture, Live)
   }
   EXPECT_EQ(buffer_count, 1);
 }
+
+TEST_F(GstTestFixture, LiveLatency)
+{
+  this->SetUpPipeline({ false, "x264enc", 30 });
+  this->SetLive(true);
+
+  GstElement* gpaccmafmux =
+    gst_element_factory_make_full("gpaccmafmux", "cdur", 1.0, NULL);
+  GstAppSink* sink = new GstAppSink(gpaccmafmux, GetEncoder(), pipeline);
+  sink->SetSync(true);
+
+  this->StartPipeline();
+
+  // Wait for the first fragment, the graph is resolved by then
+  GstBufferList* buffer = sink->PopBuffer();
+  ASSERT_TRUE(buffer != NULL);
+
+  // A whole fragment is held before it is output
+  GstQuery* query = gst_query_new_latency();
+  ASSERT_TRUE(gst_element_query(gpaccmafmux, query));
+  gboolean live;
+  GstClockTime min_latency, max_latency;
+  gst_query_parse_latency(query, &live, &min_latency, &max_latency);
+  gst_query_unref(query);
+  EXPECT_TRUE(live);
+  EXPECT_GE(min_latency, GST_SECOND);
+
+  // Only the configured delay counts, later queries report the same value
+  GstBufferList* next = sink->PopBuffer();
+  if (next)
+    gst_buffer_list_unref(next);
+  query = gst_query_new_latency();
+  ASSERT_TRUE(gst_element_query(gpaccmafmux, query));
+  GstClockTime min_again;
+  gst_query_parse_latency(query, NULL, &min_again, NULL);
+  gst_query_unref(query);
+  EXPECT_EQ(min_again, min_latency);
+
+  // Drain the rest
+  while (sink->PopBuffer())
+    ;
+}
@@ -2,6 +2,8 @@
 #include <filesystem>
 #include <gpac/isomedia.h>
 #include <gpac/media_tools.h>
+#include <set>
+#include <string>
 
 namespace fs = std::filesystem;
 
@@ -94,3 +96,463 @@ TEST_F(GstTestFixture, MultipleInputs)
   gf_sys_close();
   fs::remove(file);
 }
+
+static GstPadProbeReturn
+sample_slices_probe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data)
+{
+  auto* slices = (std::multiset<std::string>*)user_data;
+  GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+  if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_HEADER))
+    return GST_PAD_PROBE_OK;
+
+  // Every data buffer holds exactly one sample
+  GstMapInfo map;
+  if (gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+    slices->emplace((const char*)map.data, map.size);
+    gst_buffer_unmap(buffer, &map);
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+TEST_F(GstTestFixture, MultipleTracksFragment)
+{
+  this->SetUpPipeline({ false, "x264enc", 30 });
+  this->SetUpPipeline(
+    { false, "avenc_aac", 1, 1, "audiotestsrc", "audio/x-raw, rate=44100" });
+
+  // Set samples per buffer for the audio source
+  GstElement* audio_source = this->GetSource(1);
+  g_object_set(audio_source, "samplesperbuffer", 44100, NULL);
+
+  // Every fragment carries a traf for each track
+  GstElement* gpaccmafmux =
+    gst_element_factory_make_full("gpaccmafmux", "cdur", 0.5, NULL);
+
+  // Set the destination options
+  std::string file = fs::temp_directory_path().string() + "/" + "trafs.mp4";
+  GstElement* sink =
+    gst_element_factory_make_full("filesink", "location", file.c_str(), NULL);
+
+  // Add the elements to the pipeline
+  gst_bin_add_many(GST_BIN(pipeline), gpaccmafmux, sink, NULL);
+
+  // Link the elements
+  if (!gst_element_link(this->GetLastElement(0), gpaccmafmux) ||
+      !gst_element_link(this->GetLastElement(1), gpaccmafmux) ||
+      !gst_element_link(gpaccmafmux, sink)) {
+    g_error("Failed to link elements");
+    return;
+  }
+
+  // Collect the samples as they were sliced out of the mdat
+  std::multiset<std::string> slices;
+  GstPad* output = gst_element_get_static_pad(gpaccmafmux, "src");
+  gst_pad_add_probe(
+    output, GST_PAD_PROBE_TYPE_BUFFER, sample_slices_probe, &slices, NULL);
+  gst_object_unref(output);
+
+  this->StartPipeline();
+  this->WaitForEOS();
+
+  // Read the file
+  ASSERT_TRUE(fs::exists(file));
+  gf_sys_init(GF_MemTrackerNone, NULL);
+  GF_ISOFile* isom = gf_isom_open(file.c_str(), GF_ISOM_OPEN_READ, NULL);
+  ASSERT_TRUE(isom != NULL);
+  ASSERT_EQ(gf_isom_get_track_count(isom), 2);
+  EXPECT_EQ(slices.size(),
+            gf_isom_get_sample_count(isom, 1) +
+              gf_isom_get_sample_count(isom, 2));
+
+  // Each sample of both tracks was pushed on its own
+  for (u32 track = 1; track <= 2; track++) {
+    for (u32 i = 1; i <= gf_isom_get_sample_count(isom, track); i++) {
+      u32 desc_index;
+      GF_ISOSample* sample = gf_isom_get_sample(isom, track, i, &desc_index);
+      ASSERT_TRUE(sample != NULL);
+      auto it = slices.find(std::string(sample->data, sample->dataLength));
+      EXPECT_TRUE(it != slices.end())
+        << "Sample " << i << " of track " << track << " was not sliced out";
+      if (it != slices.end())
+        slices.erase(it);
+      gf_isom_sample_del(&sample);
+    }
+  }
+
+  // Close the file
+  gf_isom_close(isom);
+  gf_sys_close();
+  fs::remove(file);
+}
+
+TEST_F(GstTestFixture, ChainedElements)
+{
+  this->SetUpPipeline({ false, "x264enc", 30 });
+  GstElement* gpacmp4mx = gst_element_factory_make("gpacmp4mx", NULL);
+
+  // The second session demuxes the output of the first one and muxes it again
+  GstElement* gpactf =
+    gst_element_factory_make_full("gpactf", "graph", "mp4mx", NULL);
+
+  // Set the destination options
+  std::string file = fs::temp_directory_path().string() + "/" + "chained.mp4";
+  GstElement* sink =
+    gst_element_factory_make_full("filesink", "location", file.c_str(), NULL);
+
+  // Add the elements to the pipeline
+  gst_bin_add_many(GST_BIN(pipeline), gpacmp4mx, gpactf, sink, NULL);
+
+  // Link the elements
+  if (!gst_element_link(this->GetLastElement(), gpacmp4mx) ||
+      !gst_element_link(gpacmp4mx, gpactf) ||
+      !gst_element_link(gpactf, sink)) {
+    g_error("Failed to link elements");
+    return;
+  }
+
+  this->StartPipeline();
+  this->WaitForEOS();
+
+  // Nothing is left queued once both sessions are done
+  GstStructure* level = NULL;
+  g_object_get(gpactf, "queue-level", &level, NULL);
+  ASSERT_TRUE(level != NULL);
+  guint64 bytes = 0;
+  EXPECT_TRUE(gst_structure_get_uint64(level, "bytes", &bytes));
+  EXPECT_EQ(bytes, 0);
+  gst_structure_free(level);
+
+  // Read the file
+  ASSERT_TRUE(fs::exists(file));
+  gf_sys_init(GF_MemTrackerNone, NULL);
+  GF_ISOFile* isom = gf_isom_open(file.c_str(), GF_ISOM_OPEN_READ, NULL);
+  ASSERT_TRUE(isom != NULL);
+
+  // Every sample made it through both sessions
+  EXPECT_EQ(gf_isom_get_track_count(isom), 1);
+  EXPECT_EQ(gf_isom_get_sample_count(isom, 1), 30);
+
+  // Close the file
+  gf_isom_close(isom);
+  gf_sys_close();
+  fs::remove(file);
+}
+
+static guint64
+GetRunStat(GstElement* element, const gchar* field)
+{
+  GstStructure* stats = NULL;
+  g_object_get(element, "run-stats", &stats, NULL);
+  if (!stats)
+    return 0;
+  guint64 value = 0;
+  EXPECT_TRUE(gst_structure_get_uint64(stats, field, &value)) << field;
+  gst_structure_free(stats);
+  return value;
+}
+
+TEST_F(GstTestFixture, RunStats)
+{
+  this->SetUpPipeline({ false, "x264enc", 30 });
+  GstElement* gpaccmafmux = gst_element_factory_make("gpaccmafmux", NULL);
+  GstElement* sink = gst_element_factory_make("fakesink", NULL);
+
+  // Add the elements to the pipeline
+  gst_bin_add_many(GST_BIN(pipeline), gpaccmafmux, sink, NULL);
+
+  // Link the elements
+  if (!gst_element_link(this->GetLastElement(), gpaccmafmux) ||
+      !gst_element_link(gpaccmafmux, sink)) {
+    g_error("Failed to link elements");
+    return;
+  }
+
+  this->StartPipeline();
+  this->WaitForEOS();
+
+  // Every counter moved, the default budget is step based only
+  EXPECT_GT(GetRunStat(gpaccmafmux, "runs"), 0);
+  EXPECT_GT(GetRunStat(gpaccmafmux, "steps"), 0);
+  EXPECT_GT(GetRunStat(gpaccmafmux, "tasks"), 0);
+  EXPECT_GT(GetRunStat(gpaccmafmux, "packets"), 0);
+  EXPECT_GT(GetRunStat(gpaccmafmux, "time"), 0);
+  EXPECT_LE(GetRunStat(gpaccmafmux, "max-run-time"),
+            GetRunStat(gpaccmafmux, "time"));
+  EXPECT_EQ(GetRunStat(gpaccmafmux, "budget-exceeded"), 0);
+
+  // Tasks are counted when read, they can't go backwards
+  guint64 tasks = GetRunStat(gpaccmafmux, "tasks");
+  EXPECT_GE(GetRunStat(gpaccmafmux, "tasks"), tasks);
+}
+
+TEST_F(GstTestFixture, RunBudget)
+{
+  this->SetUpPipeline({ false, "x264enc", 90 });
+  GstElement* gpaccmafmux = gst_element_factory_make("gpaccmafmux", NULL);
+
+  // Three seconds of fragments, every run stops after one output packet
+  g_object_set(gpaccmafmux,
+               "run-max-steps",
+               0U,
+               "run-max-packets",
+               1U,
+               "run-until-drained",
+               TRUE,
+               NULL);
+
+  // Set the destination options
+  std::string file = fs::temp_directory_path().string() + "/" + "budget.mp4";
+  GstElement* sink =
+    gst_element_factory_make_full("filesink", "location", file.c_str(), NULL);
+
+  // Add the elements to the pipeline
+  gst_bin_add_many(GST_BIN(pipeline), gpaccmafmux, sink, NULL);
+
+  // Link the elements
+  if (!gst_element_link(this->GetLastElement(), gpaccmafmux) ||
+      !gst_element_link(gpaccmafmux, sink)) {
+    g_error("Failed to link elements");
+    return;
+  }
+
+  this->StartPipeline();
+  this->WaitForEOS();
+
+  // The packet budget cut runs short
+  EXPECT_GT(GetRunStat(gpaccmafmux, "budget-exceeded"), 0);
+  EXPECT_LE(GetRunStat(gpaccmafmux, "budget-exceeded"),
+            GetRunStat(gpaccmafmux, "runs"));
+
+  // Read the file
+  ASSERT_TRUE(fs::exists(file));
+  gf_sys_init(GF_MemTrackerNone, NULL);
+  GF_ISOFile* isom = gf_isom_open(file.c_str(), GF_ISOM_OPEN_READ, NULL);
+  ASSERT_TRUE(isom != NULL);
+
+  // Nothing was lost to the shorter runs
+  EXPECT_EQ(gf_isom_get_sample_count(isom, 1), 90);
+
+  // Close the file
+  gf_isom_close(isom);
+  gf_sys_close();
+  fs::remove(file);
+}
+
+struct PushedLists
+{
+  guint lists = 0;
+  guint buffers = 0; // pushed on their own
+  guint max_length = 0;
+  GstClockTime max_span = 0;
+};
+
+static GstPadProbeReturn
+pushed_lists_probe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data)
+{
+  PushedLists* pushed = (PushedLists*)user_data;
+  if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    pushed->buffers++;
+    return GST_PAD_PROBE_OK;
+  }
+
+  // Span of the timestamps from the first buffer of the list
+  GstBufferList* list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+  GstClockTime first = GST_CLOCK_TIME_NONE;
+  for (guint i = 0; i < gst_buffer_list_length(list); i++) {
+    GstClockTime ts = GST_BUFFER_DTS_OR_PTS(gst_buffer_list_get(list, i));
+    if (!GST_CLOCK_TIME_IS_VALID(ts))
+      continue;
+    if (!GST_CLOCK_TIME_IS_VALID(first))
+      first = ts;
+    else if (ts > first)
+      pushed->max_span = MAX(pushed->max_span, ts - first);
+  }
+  pushed->lists++;
+  pushed->max_length = MAX(pushed->max_length, gst_buffer_list_length(list));
+  return GST_PAD_PROBE_OK;
+}
+
+class PushBatching : public GstTestFixture
+{
+protected:
+  void Run(const char* name,
+           guint max_buffers,
+           guint64 max_latency,
+           PushedLists* pushed)
+  {
+    this->SetUpPipeline({ false, "x264enc", 90 });
+    GstElement* gpaccmafmux =
+      gst_element_factory_make_full("gpaccmafmux", "cdur", 0.1, NULL);
+    if (max_buffers)
+      g_object_set(gpaccmafmux,
+                   "push-max-buffers",
+                   max_buffers,
+                   "push-max-latency",
+                   max_latency,
+                   NULL);
+
+    // Set the destination options
+    std::string file = fs::temp_directory_path().string() + "/" + name;
+    GstElement* sink = gst_element_factory_make_full(
+      "filesink", "location", file.c_str(), NULL);
+
+    // Add the elements to the pipeline
+    gst_bin_add_many(GST_BIN(this->pipeline), gpaccmafmux, sink, NULL);
+
+    // Link the elements
+    if (!gst_element_link(this->GetLastElement(), gpaccmafmux) ||
+        !gst_element_link(gpaccmafmux, sink)) {
+      g_error("Failed to link elements");
+      return;
+    }
+
+    // Watch what leaves the muxer
+    GstPad* output = gst_element_get_static_pad(gpaccmafmux, "src");
+    gst_pad_add_probe(
+      output,
+      (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER |
+                        GST_PAD_PROBE_TYPE_BUFFER_LIST),
+      pushed_lists_probe,
+      pushed,
+      NULL);
+    gst_object_unref(output);
+
+    this->StartPipeline();
+    this->WaitForEOS();
+
+    // Read the file
+    ASSERT_TRUE(fs::exists(file));
+    gf_sys_init(GF_MemTrackerNone, NULL);
+    GF_ISOFile* isom = gf_isom_open(file.c_str(), GF_ISOM_OPEN_READ, NULL);
+    ASSERT_TRUE(isom != NULL);
+
+    // Batching never changes what is written
+    EXPECT_EQ(gf_isom_get_sample_count(isom, 1), 90);
+
+    // Close the file
+    gf_isom_close(isom);
+    gf_sys_close();
+    fs::remove(file);
+  }
+};
+
+TEST_F(PushBatching, Off)
+{
+  // Every buffer goes on its own by default
+  PushedLists pushed;
+  Run("nobatch.mp4", 0, 0, &pushed);
+  EXPECT_GT(pushed.buffers, 0u);
+  EXPECT_EQ(pushed.lists, 0u);
+}
+
+TEST_F(PushBatching, MaxBuffers)
+{
+  PushedLists pushed;
+  Run("batch.mp4", 4, 0, &pushed);
+  EXPECT_GT(pushed.lists, 0u);
+  EXPECT_LE(pushed.max_length, 4u);
+}
+
+TEST_F(PushBatching, Latency)
+{
+  // Lists are cut on time long before they are full
+  const guint64 max_latency = 200000;
+  PushedLists pushed;
+  Run("batchlatency.mp4", 1000, max_latency, &pushed);
+  EXPECT_GT(pushed.lists, 0u);
+  EXPECT_LE(pushed.max_span, max_latency * GST_USECOND);
+}
+
+struct ExposedOutputs
+{
+  GstElement* pipeline;
+  guint pads_added = 0;
+  guint no_more_pads = 0;
+  guint buffers[2] = { 0, 0 };
+};
+
+static GstPadProbeReturn
+exposed_buffer_probe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data)
+{
+  guint* buffers = (guint*)user_data;
+  (*buffers)++;
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+exposed_pad_added(GstElement* element, GstPad* pad, gpointer user_data)
+{
+  ExposedOutputs* outputs = (ExposedOutputs*)user_data;
+  outputs->pads_added++;
+
+  // Drain the new output into its own sink
+  GstElement* sink = gst_element_factory_make("fakesink", NULL);
+  gst_bin_add(GST_BIN(outputs->pipeline), sink);
+  gst_element_sync_state_with_parent(sink);
+  GstPad* sinkpad = gst_element_get_static_pad(sink, "sink");
+  EXPECT_EQ(gst_pad_link(pad, sinkpad), GST_PAD_LINK_OK);
+  gst_object_unref(sinkpad);
+
+  gst_pad_add_probe(pad,
+                    GST_PAD_PROBE_TYPE_BUFFER,
+                    exposed_buffer_probe,
+                    &outputs->buffers[1],
+                    NULL);
+}
+
+static void
+exposed_no_more_pads(GstElement* element, gpointer user_data)
+{
+  ExposedOutputs* outputs = (ExposedOutputs*)user_data;
+  outputs->no_more_pads++;
+}
+
+TEST_F(GstTestFixture, MultipleOutputs)
+{
+  this->SetUpPipeline({ false, "x264enc", 30 });
+  this->SetUpPipeline(
+    { false, "avenc_aac", 1, 1, "audiotestsrc", "audio/x-raw, rate=44100" });
+
+  // Set samples per buffer for the audio source
+  GstElement* audio_source = this->GetSource(1);
+  g_object_set(audio_source, "samplesperbuffer", 44100, NULL);
+
+  // Nothing muxes the streams back together, both reach the output
+  GstElement* gpactf =
+    gst_element_factory_make_full("gpactf", "graph", "reframer", NULL);
+  GstElement* sink = gst_element_factory_make("fakesink", NULL);
+
+  // Add the elements to the pipeline
+  gst_bin_add_many(GST_BIN(pipeline), gpactf, sink, NULL);
+
+  // Link the elements
+  if (!gst_element_link(this->GetLastElement(0), gpactf) ||
+      !gst_element_link(this->GetLastElement(1), gpactf) ||
+      !gst_element_link(gpactf, sink)) {
+    g_error("Failed to link elements");
+    return;
+  }
+
+  // Watch both outputs
+  ExposedOutputs outputs = { pipeline };
+  g_signal_connect(
+    gpactf, "pad-added", G_CALLBACK(exposed_pad_added), &outputs);
+  g_signal_connect(
+    gpactf, "no-more-pads", G_CALLBACK(exposed_no_more_pads), &outputs);
+  GstPad* srcpad = gst_element_get_static_pad(gpactf, "src");
+  gst_pad_add_probe(srcpad,
+                    GST_PAD_PROBE_TYPE_BUFFER,
+                    exposed_buffer_probe,
+                    &outputs.buffers[0],
+                    NULL);
+  gst_object_unref(srcpad);
+
+  this->StartPipeline();
+  this->WaitForEOS();
+
+  // The second stream got its own pad, announced once
+  EXPECT_EQ(outputs.pads_added, 1u);
+  EXPECT_EQ(outputs.no_more_pads, 1u);
+  EXPECT_GT(outputs.buffers[0], 0u);
+  EXPECT_GT(outputs.buffers[1], 0u);
+}
@@ -0,0 +1,170 @@
+#include "helper/common.hpp"
+#include <filesystem>
+#include <gpac/isomedia.h>
+
+namespace fs = std::filesystem;
+
+struct QueueLevelPeak
+{
+  GstElement* element;
+  guint64 bytes = 0;
+  GstClockTime time = 0;
+  gsize buffer_size = 0;
+};
+
+static GstPadProbeReturn
+queue_level_probe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data)
+{
+  QueueLevelPeak* peak = (QueueLevelPeak*)user_data;
+  GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+  if (buffer && GST_PAD_PARENT(pad) != peak->element)
+    peak->buffer_size = MAX(peak->buffer_size, gst_buffer_get_size(buffer));
+
+  // Sample the level as input arrives and as output leaves
+  GstStructure* level = NULL;
+  g_object_get(peak->element, "queue-level", &level, NULL);
+  guint64 bytes = 0, time = 0;
+  gst_structure_get_uint64(level, "bytes", &bytes);
+  gst_structure_get_uint64(level, "time", &time);
+  gst_structure_free(level);
+  peak->bytes = MAX(peak->bytes, bytes);
+  peak->time = MAX(peak->time, time);
+  return GST_PAD_PROBE_OK;
+}
+
+class QueueLimits : public GstTestFixture
+{
+protected:
+  void Run(const char* name, gint threads)
+  {
+    this->SetUpPipeline({ false, "x264enc", 90 });
+
+    // Fragments are much shorter than the time limit
+    const guint64 max_bytes = 4 * 1024 * 1024;
+    const GstClockTime max_time = 2 * GST_SECOND;
+    GstElement* gpaccmafmux = gst_element_factory_make_full("gpaccmafmux",
+                                                            "cdur",
+                                                            0.5,
+                                                            "max-queue-bytes",
+                                                            max_bytes,
+                                                            "max-queue-time",
+                                                            max_time,
+                                                            "threads",
+                                                            threads,
+                                                            NULL);
+
+    // Set the destination options
+    std::string file = fs::temp_directory_path().string() + "/" + name;
+    GstElement* sink = gst_element_factory_make_full(
+      "filesink", "location", file.c_str(), NULL);
+
+    // Add the elements to the pipeline
+    gst_bin_add_many(GST_BIN(this->pipeline), gpaccmafmux, sink, NULL);
+
+    // Link the elements
+    if (!gst_element_link(this->GetLastElement(), gpaccmafmux) ||
+        !gst_element_link(gpaccmafmux, sink)) {
+      g_error("Failed to link elements");
+      return;
+    }
+
+    // Watch the level from both sides of the muxer
+    QueueLevelPeak peak = { gpaccmafmux };
+    GstPad* input = gst_element_get_static_pad(this->GetLastElement(), "src");
+    GstPad* output = gst_element_get_static_pad(gpaccmafmux, "src");
+    gst_pad_add_probe(
+      input, GST_PAD_PROBE_TYPE_BUFFER, queue_level_probe, &peak, NULL);
+    gst_pad_add_probe(
+      output, GST_PAD_PROBE_TYPE_BUFFER, queue_level_probe, &peak, NULL);
+    gst_object_unref(input);
+    gst_object_unref(output);
+
+    this->StartPipeline();
+    this->WaitForEOS();
+
+    // The limits hold, give or take the buffer that crossed them
+    EXPECT_GT(peak.bytes, 0u);
+    EXPECT_LE(peak.bytes, max_bytes + peak.buffer_size);
+    EXPECT_LE(peak.time, max_time + GST_SECOND / 30);
+
+    // Read the file
+    ASSERT_TRUE(fs::exists(file));
+    gf_sys_init(GF_MemTrackerNone, NULL);
+    GF_ISOFile* isom = gf_isom_open(file.c_str(), GF_ISOM_OPEN_READ, NULL);
+    ASSERT_TRUE(isom != NULL);
+
+    // Every sample made it through
+    EXPECT_EQ(gf_isom_get_sample_count(isom, 1), 90);
+
+    // Close the file
+    gf_isom_close(isom);
+    gf_sys_close();
+    fs::remove(file);
+  }
+};
+
+TEST_F(QueueLimits, Inline)
+{
+  // The session runs on the streaming thread
+  Run("queue.mp4", 0);
+}
+
+TEST_F(QueueLimits, Workers)
+{
+  // Input is released from the worker threads
+  Run("queuethreads.mp4", 2);
+}
+
+TEST_F(QueueLimits, Overrun)
+{
+  this->SetUpPipeline({ false, "x264enc", 30 });
+  GstElement* gpaccmafmux = gst_element_factory_make("gpaccmafmux", NULL);
+
+  // Limits lower than a fragment must not stall the muxer
+  g_object_set(gpaccmafmux,
+               "max-queue-bytes",
+               (guint64)1,
+               "max-queue-time",
+               (guint64)GST_MSECOND,
+               NULL);
+
+  // Set the destination options
+  std::string file = fs::temp_directory_path().string() + "/" + "overrun.mp4";
+  GstElement* sink =
+    gst_element_factory_make_full("filesink", "location", file.c_str(), NULL);
+
+  // Add the elements to the pipeline
+  gst_bin_add_many(GST_BIN(pipeline), gpaccmafmux, sink, NULL);
+
+  // Link the elements
+  if (!gst_element_link(this->GetLastElement(), gpaccmafmux) ||
+      !gst_element_link(gpaccmafmux, sink)) {
+    g_error("Failed to link elements");
+    return;
+  }
+
+  this->StartPipeline();
+  this->WaitForEOS();
+
+  // The level is exposed
+  GstStructure* level = NULL;
+  g_object_get(gpaccmafmux, "queue-level", &level, NULL);
+  ASSERT_TRUE(level != NULL);
+  EXPECT_TRUE(gst_structure_has_field(level, "bytes"));
+  EXPECT_TRUE(gst_structure_has_field(level, "time"));
+  gst_structure_free(level);
+
+  // Read the file
+  ASSERT_TRUE(fs::exists(file));
+  gf_sys_init(GF_MemTrackerNone, NULL);
+  GF_ISOFile* isom = gf_isom_open(file.c_str(), GF_ISOM_OPEN_READ, NULL);
+  ASSERT_TRUE(isom != NULL);
+
+  // Every sample made it through
+  EXPECT_EQ(gf_isom_get_sample_count(isom, 1), 30);
+
+  // Close the file
+  gf_isom_close(isom);
+  gf_sys_close();
+  fs::remove(file);
+}
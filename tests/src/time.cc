@@ -0,0 +1,106 @@
+#include <chrono>
+#include <gpac/tools.h>
+#include <gst/gst.h>
+#include <gtest/gtest.h>
+#include <iostream>
+#include <vector>
+
+extern "C"
+{
+#include "lib/time.h"
+}
+
+using std::chrono::steady_clock;
+
+TEST(TimeConverter, MatchesScaleRound)
+{
+  const guint64 timescales[] = { 1000, 90000, 48000, 44100, 30000, 1 };
+  const guint64 times[] = {
+    0, 1, 33366666, GST_SECOND, 3600 * GST_SECOND, G_MAXUINT64 / 1000
+  };
+
+  for (guint64 timescale : timescales) {
+    GPAC_TimeConverter to_ts, from_ts;
+    gpac_time_converter_init(&to_ts, GST_SECOND, timescale);
+    gpac_time_converter_init(&from_ts, timescale, GST_SECOND);
+
+    for (guint64 time : times) {
+      EXPECT_EQ(gpac_time_converter_apply(&to_ts, time),
+                gst_util_uint64_scale_round(time, timescale, GST_SECOND));
+      // Scaling up overflows for the largest times, both saturate
+      EXPECT_EQ(gpac_time_converter_apply(&from_ts, time),
+                gst_util_uint64_scale_round(time, GST_SECOND, timescale));
+    }
+  }
+
+  // Results past 64 bits saturate instead of wrapping
+  GPAC_TimeConverter up;
+  gpac_time_converter_init(&up, 1, GST_SECOND);
+  EXPECT_EQ(gpac_time_converter_apply(&up, G_MAXUINT64), G_MAXUINT64);
+  EXPECT_EQ(gpac_time_converter_apply(&up, G_MAXUINT64 / 1000), G_MAXUINT64);
+
+  // A zero timescale converts everything to 0
+  GPAC_TimeConverter zero;
+  gpac_time_converter_init(&zero, 0, GST_SECOND);
+  EXPECT_EQ(gpac_time_converter_apply(&zero, GST_SECOND), 0u);
+}
+
+TEST(TimeConverter, Batch)
+{
+  GPAC_TimeConverter conv;
+  gpac_time_converter_init(&conv, 90000, GST_SECOND);
+
+  std::vector<guint64> times = { 0, 3003, 6006, 90000 };
+  gpac_time_converter_apply_batch(&conv, times.data(), times.size());
+  EXPECT_EQ(times[0], 0u);
+  EXPECT_EQ(times[1], 33366667u);
+  EXPECT_EQ(times[2], 66733333u);
+  EXPECT_EQ(times[3], GST_SECOND);
+}
+
+// Timings depend on the machine, run with --gtest_also_run_disabled_tests
+TEST(TimeConverter, DISABLED_Benchmark)
+{
+  const gsize count = 1 << 20;
+  const GF_Fraction fps = { 30000, 1001 };
+  const guint64 timescale = 30000;
+
+  std::vector<guint64> times(count);
+  for (gsize i = 0; i < count; i++)
+    times[i] = i * 33366666;
+
+  // What every packet went through before the converter
+  guint64 sum_fps = 0;
+  auto start = steady_clock::now();
+  for (gsize i = 0; i < count; i++)
+    sum_fps += gpac_time_rescale_with_fps(times[i], fps, timescale);
+  auto fps_time = steady_clock::now() - start;
+
+  // The converter, one timestamp at a time and in batch
+  GPAC_TimeConverter conv;
+  gpac_time_converter_init(&conv, GST_SECOND, timescale);
+  guint64 sum_conv = 0;
+  start = steady_clock::now();
+  for (gsize i = 0; i < count; i++)
+    sum_conv += gpac_time_converter_apply(&conv, times[i]);
+  auto conv_time = steady_clock::now() - start;
+
+  start = steady_clock::now();
+  gpac_time_converter_apply_batch(&conv, times.data(), count);
+  auto batch_time = steady_clock::now() - start;
+  guint64 sum_batch = 0;
+  for (gsize i = 0; i < count; i++)
+    sum_batch += times[i];
+
+  auto us = [](steady_clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+  };
+  std::cout << "Rescale with fps: " << us(fps_time) << "us, converter: "
+            << us(conv_time) << "us, batch: " << us(batch_time) << "us for "
+            << count << " timestamps" << std::endl;
+
+  // Keep the loops from being optimized out
+  EXPECT_GT(sum_fps, 0u);
+  EXPECT_GT(sum_conv, 0u);
+  EXPECT_EQ(sum_batch, sum_conv);
+}